@@ -242,6 +242,8 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 					transcript_annotation_record.id = new_id++;
 					transcript_annotation_record.start = -1; // is set once we have loaded all exons
 					transcript_annotation_record.end = -1; // is set once we have loaded all exons
+					transcript_annotation_record.exon_with_start_codon = NULL; // is set once the assembly has been loaded
+					transcript_annotation_record.has_start_codon = false;
 					transcript_annotation.push_back(transcript_annotation_record);
 					exon_annotation_record.transcript = transcripts[short_transcript_id] = &(*transcript_annotation.rbegin());
 				}
@@ -253,7 +255,7 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 					gene_annotation_record.copy(annotation_record);
 					gene_annotation_record.name = gene_name;
 					gene_annotation_record.id = new_id++;
-					gene_annotation_record.exonic_length = 0; // is calculated later in arriba.cpp
+					gene_annotation_record.exonic_length = 0; // is calculated later in libarriba.cpp
 					gene_annotation_record.is_dummy = false;
 					gene_annotation_record.is_protein_coding = false;
 					gene_annotation.push_back(gene_annotation_record);
@@ -384,6 +386,49 @@ bool filter_exons_near_splice_site(const gene_t gene, const direction_t directio
 	return false;
 }
 
+// precompute the start codon and the coding regions of each transcript in the order of transcription,
+// such that the reading frame at a given position can be looked up without walking along the exons
+void make_cds_maps(exon_annotation_t& exon_annotation, const assembly_t& assembly) {
+	for (exon_annotation_t::iterator exon = exon_annotation.begin(); exon != exon_annotation.end(); ++exon) {
+		if (exon->previous_exon != NULL)
+			continue; // process every transcript only once, starting at its leftmost exon
+		transcript_t transcript = exon->transcript;
+		bool forward = exon->gene->strand == FORWARD;
+
+		// find first coding exon in the direction of transcription
+		exon_t first_exon = &(*exon);
+		if (!forward)
+			while (first_exon->next_exon != NULL)
+				first_exon = first_exon->next_exon;
+		exon_t exon_with_start_codon = first_exon;
+		while (exon_with_start_codon != NULL && exon_with_start_codon->coding_region_start == -1)
+			exon_with_start_codon = (forward) ? exon_with_start_codon->next_exon : exon_with_start_codon->previous_exon;
+		transcript->exon_with_start_codon = exon_with_start_codon;
+
+		// check if there is a start codon at the start of first coding exon (if not, something is bogus)
+		transcript->has_start_codon = false;
+		transcript->coding_segments.clear();
+		if (exon_with_start_codon == NULL)
+			continue; // non-coding transcript
+		assembly_t::const_iterator contig_sequence = assembly.find(exon->contig);
+		if (contig_sequence == assembly.end())
+			continue;
+		position_t start_codon = (forward) ? exon_with_start_codon->coding_region_start : exon_with_start_codon->coding_region_end - 2;
+		if (start_codon < 0 || start_codon + 3 > (position_t) contig_sequence->second.size() ||
+		    contig_sequence->second.compare(start_codon, 3, (forward) ? "ATG" : "CAT") != 0)
+			continue;
+		transcript->has_start_codon = true;
+
+		// list the coding regions from the start codon onwards until the first non-coding exon
+		unsigned int cds_offset = 0;
+		for (exon_t coding_exon = exon_with_start_codon; coding_exon != NULL && coding_exon->coding_region_start != -1; coding_exon = (forward) ? coding_exon->next_exon : coding_exon->previous_exon) {
+			coding_segment_t coding_segment = { coding_exon, cds_offset };
+			transcript->coding_segments.push_back(coding_segment);
+			cds_offset += coding_exon->coding_region_end - coding_exon->coding_region_start + 1;
+		}
+	}
+}
+
 // check if a breakpoint is near an annotated splice site
 bool is_breakpoint_spliced(const gene_t gene, const direction_t direction, const position_t breakpoint, const exon_annotation_index_t& exon_annotation_index) {
 
@@ -22,8 +22,10 @@ using namespace std;
 // - chr1:10,000-11,999 gene1
 // - chr1:12,000-13,000 gene1+gene2
 // - chr1:13,001-20,000 gene1
+// features may be added to an existing index
 template <class T> void make_annotation_index(annotation_t<T>& annotation, annotation_index_t<T*>& annotation_index) {
-	annotation_index.resize(annotation.size()); // create a contig_annotation_index_t for each contig
+	if (annotation_index.size() < annotation.size())
+		annotation_index.resize(annotation.size()); // create a contig_annotation_index_t for each contig
 	for (typename annotation_t<T>::iterator feature = annotation.begin(); feature != annotation.end(); ++feature) {
 
 		typename contig_annotation_index_t<T*>::const_iterator overlapping_features = annotation_index[feature->contig].lower_bound(feature->end);
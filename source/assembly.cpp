@@ -1,20 +1,19 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "sam.h"
 #include "common.hpp"
 #include "annotation.hpp"
+#include "nucleotides.hpp"
 #include "read_compressed_file.hpp"
 #include "assembly.hpp"
 
 using namespace std;
 
 void dna_to_reverse_complement(const string& dna, string& reverse_complement) {
-	if (!reverse_complement.empty())
-		reverse_complement.clear();
-	reverse_complement.reserve(dna.length());
-	for (string::const_reverse_iterator i = dna.rbegin(); i != dna.rend(); ++i)
-		reverse_complement += dna_to_complement(*i);
+	::reverse_complement(dna, reverse_complement);
 }
 
 string dna_to_reverse_complement(const string& dna) {
@@ -23,7 +22,7 @@ string dna_to_reverse_complement(const string& dna) {
 	return reverse_complement;
 }
 
-void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_t& contigs, const contigs_t& interesting_contigs) {
+void read_assembly(const string& fasta_file_path, const contigs_t& interesting_contigs, contig_sequences_t& contig_sequences) {
 
 	// open FastA file
 	stringstream fasta_file;
@@ -31,7 +30,8 @@ void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_
 
 	// read line by line
 	string line;
-	contig_t current_contig = -1;
+	unordered_map<string,size_t> contig_sequence_by_name;
+	string* current_sequence = NULL;
 	while (getline(fasta_file, line)) {
 		if (!line.empty()) {
 
@@ -41,18 +41,33 @@ void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_
 				string contig_name;
 				iss >> contig_name;
 				contig_name = removeChr(contig_name);
-				pair<contigs_t::iterator,bool> new_contig = contigs.insert(pair<string,contig_t>(contig_name, contigs.size()));
-				current_contig = new_contig.first->second;
+				// all contigs are listed (even uninteresting ones), because they are numbered later on
+				pair<unordered_map<string,size_t>::iterator,bool> new_contig = contig_sequence_by_name.insert(pair<string,size_t>(contig_name, contig_sequences.size()));
+				if (new_contig.second)
+					contig_sequences.push_back(pair<string,string>(contig_name, ""));
+				current_sequence = &contig_sequences[new_contig.first->second].second;
 				if (!interesting_contigs.empty() && interesting_contigs.find(contig_name) == interesting_contigs.end())
-					current_contig = -1; // skip uninteresting contigs
+					current_sequence = NULL; // skip uninteresting contigs
 
 			// get sequence
-			} else if (current_contig != -1) { // skip line if contig is undefined or not interesting
+			} else if (current_sequence != NULL) { // skip line if contig is undefined or not interesting
 				std::transform(line.begin(), line.end(), line.begin(), (int (*)(int))std::toupper); // convert sequence to uppercase
-				assembly[current_contig] += line;
+				*current_sequence += line;
 			}
 		}
 	}
+}
+
+void number_assembly(contig_sequences_t& contig_sequences, assembly_t& assembly, contigs_t& contigs, const contigs_t& interesting_contigs) {
+
+	// assign IDs to contigs in the order in which they appear in the FastA file
+	// and move the sequences to the assembly
+	for (contig_sequences_t::iterator contig_sequence = contig_sequences.begin(); contig_sequence != contig_sequences.end(); ++contig_sequence) {
+		pair<contigs_t::iterator,bool> new_contig = contigs.insert(pair<string,contig_t>(contig_sequence->first, contigs.size()));
+		if (!contig_sequence->second.empty())
+			assembly[new_contig.first->second].swap(contig_sequence->second);
+	}
+	contig_sequences.clear();
 
 	// check if we found the sequence for all interesting contigs
 	for (contigs_t::const_iterator contig = interesting_contigs.begin(); contig != interesting_contigs.end(); ++contig)
@@ -62,3 +77,8 @@ void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_
 		}
 }
 
+void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_t& contigs, const contigs_t& interesting_contigs) {
+	contig_sequences_t contig_sequences;
+	read_assembly(fasta_file_path, interesting_contigs, contig_sequences);
+	number_assembly(contig_sequences, assembly, contigs, interesting_contigs);
+}
@@ -2,28 +2,29 @@
 #define _ASSEMBLY_H 1
 
 #include <string>
+#include <utility>
+#include <vector>
 #include "common.hpp"
+#include "nucleotides.hpp"
 
 using namespace std;
 
 inline char dna_to_complement(const char dna) {
-	if (dna == 'a') { return 't'; }
-	else if (dna == 't') { return 'a'; }
-	else if (dna == 'c') { return 'g'; }
-	else if (dna == 'g') { return 'c'; }
-	else if (dna == 'A') { return 'T'; }
-	else if (dna == 'T') { return 'A'; }
-	else if (dna == 'C') { return 'G'; }
-	else if (dna == 'G') { return 'C'; }
-	else if (dna == '[') { return ']'; }
-	else if (dna == ']') { return '['; }
-	else return dna;
+	return NUCLEOTIDE_COMPLEMENT[(unsigned char) dna];
 }
 
 void dna_to_reverse_complement(const string& dna, string& reverse_complement);
 
 string dna_to_reverse_complement(const string& dna);
 
+// sequences of contigs in the order of appearance in the FastA file, before they are assigned contig IDs
+typedef vector< pair<string/*contig name*/,string/*sequence*/> > contig_sequences_t;
+
+// reading and numbering the assembly are separate steps, such that the assembly can be read in parallel with other files
+// while contig IDs are still assigned in a deterministic order
+void read_assembly(const string& fasta_file_path, const contigs_t& interesting_contigs, contig_sequences_t& contig_sequences);
+void number_assembly(contig_sequences_t& contig_sequences, assembly_t& assembly, contigs_t& contigs, const contigs_t& interesting_contigs);
+
 void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_t& contigs, const contigs_t& interesting_contigs);
 
 #endif /* _ASSEMBLY_H */
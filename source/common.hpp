@@ -1,6 +1,7 @@
 #ifndef _COMMON_H
 #define _COMMON_H 1
 
+#include <algorithm>
 #include <list>
 #include <map>
 #include <string>
@@ -73,10 +74,20 @@ typedef annotation_t<gene_annotation_record_t> gene_annotation_t;
 typedef contig_annotation_index_t<gene_t> gene_contig_annotation_index_t;
 typedef annotation_index_t<gene_t> gene_annotation_index_t;
 
+struct exon_annotation_record_t;
+// the coding region of an exon as part of the coding sequence (CDS) of its transcript
+struct coding_segment_t {
+	exon_annotation_record_t* exon;
+	unsigned int cds_offset; // number of coding bases of the transcript before this segment
+};
 struct transcript_annotation_record_t {
 	unsigned int id;
 	position_t start;
 	position_t end;
+	// the following fields are set by make_cds_maps()
+	exon_annotation_record_t* exon_with_start_codon; // first coding exon in the direction of transcription (NULL for non-coding transcripts)
+	bool has_start_codon; // false, if the coding sequence does not begin with ATG
+	vector<coding_segment_t> coding_segments; // in the order of transcription, only for transcripts with start codon
 };
 typedef annotation_t<transcript_annotation_record_t> transcript_annotation_t;
 typedef transcript_annotation_record_t* transcript_t;
@@ -93,10 +104,57 @@ typedef annotation_t<exon_annotation_record_t> exon_annotation_t;
 typedef contig_annotation_index_t<exon_t> exon_contig_annotation_index_t;
 typedef annotation_index_t<exon_t> exon_annotation_index_t;
 
-class cigar_t: public vector<uint32_t> {
+// CIGAR strings of typical chimeric alignments have only a few operations,
+// so they are stored inline and only long CIGAR strings are allocated on the heap
+class cigar_t {
+	private:
+		static const unsigned int INLINE_OPERATIONS = 8;
+		uint32_t operation_count;
+		uint32_t capacity; // greater than INLINE_OPERATIONS, if the operations are stored on the heap
+		union {
+			uint32_t inline_operations[INLINE_OPERATIONS];
+			uint32_t* heap_operations;
+		};
+		uint32_t* operations() { return (capacity > INLINE_OPERATIONS) ? heap_operations : inline_operations; };
+		const uint32_t* operations() const { return (capacity > INLINE_OPERATIONS) ? heap_operations : inline_operations; };
+		void release() { if (capacity > INLINE_OPERATIONS) delete[] heap_operations; operation_count = 0; capacity = INLINE_OPERATIONS; };
+		void copy_from(const cigar_t& other) { resize(other.operation_count); copy(other.operations(), other.operations() + other.operation_count, operations()); };
+		void move_from(cigar_t& other) {
+			operation_count = other.operation_count;
+			capacity = other.capacity;
+			if (other.capacity > INLINE_OPERATIONS)
+				heap_operations = other.heap_operations; // take over the heap allocation
+			else
+				copy(other.inline_operations, other.inline_operations + other.operation_count, inline_operations);
+			other.operation_count = 0;
+			other.capacity = INLINE_OPERATIONS;
+		};
 	public:
-		uint32_t operation(unsigned int index) const { return this->at(index) & 15; }; // select lower 4 bits to get the operation of the CIGAR element
-		uint32_t op_length(unsigned int index) const { return this->at(index) >> 4; }; // remove lower 4 bits to get the length of the CIGAR element
+		cigar_t(): operation_count(0), capacity(INLINE_OPERATIONS) {};
+		cigar_t(const cigar_t& other): operation_count(0), capacity(INLINE_OPERATIONS) { copy_from(other); };
+		cigar_t(cigar_t&& other) noexcept { move_from(other); };
+		~cigar_t() { release(); };
+		cigar_t& operator=(const cigar_t& other) { if (this != &other) copy_from(other); return *this; };
+		cigar_t& operator=(cigar_t&& other) noexcept { if (this != &other) { release(); move_from(other); } return *this; };
+		unsigned int size() const { return operation_count; };
+		bool empty() const { return operation_count == 0; };
+		void resize(const unsigned int new_size) {
+			if (new_size > capacity) {
+				uint32_t* new_operations = new uint32_t[new_size];
+				copy(operations(), operations() + operation_count, new_operations);
+				if (capacity > INLINE_OPERATIONS)
+					delete[] heap_operations;
+				heap_operations = new_operations;
+				capacity = new_size;
+			}
+			if (new_size > operation_count)
+				fill(operations() + operation_count, operations() + new_size, 0);
+			operation_count = new_size;
+		};
+		uint32_t& operator[](const unsigned int index) { return operations()[index]; };
+		uint32_t operator[](const unsigned int index) const { return operations()[index]; };
+		uint32_t operation(unsigned int index) const { return operations()[index] & 15; }; // select lower 4 bits to get the operation of the CIGAR element
+		uint32_t op_length(unsigned int index) const { return operations()[index] >> 4; }; // remove lower 4 bits to get the length of the CIGAR element
 };
 
 struct alignment_t {
@@ -112,9 +170,32 @@ struct alignment_t {
 	cigar_t cigar;
 	string sequence;
 	gene_set_t genes;
-	alignment_t(): supplementary(false), first_in_pair(false), exonic(false), predicted_strand_ambiguous(true) {};
-	unsigned int preclipping() const { return (cigar.operation(0) == BAM_CSOFT_CLIP || cigar.operation(0) == BAM_CHARD_CLIP) ? cigar.op_length(0) : 0; };
-	unsigned int postclipping() const { return (cigar.operation(cigar.size()-1) == BAM_CSOFT_CLIP || cigar.operation(cigar.size()-1) == BAM_CHARD_CLIP) ? cigar.op_length(cigar.size()-1) : 0; };
+	// features derived from the CIGAR string, which the filters query over and over again
+	// they are computed once when the alignment is read and must be updated whenever the CIGAR string is modified
+	unsigned int preclipping_length;
+	unsigned int postclipping_length;
+	unsigned int longest_intron;
+	alignment_t(): supplementary(false), first_in_pair(false), exonic(false), predicted_strand_ambiguous(true), preclipping_length(0), postclipping_length(0), longest_intron(0) {};
+	void update_cigar_features() {
+		preclipping_length = (!cigar.empty() && (cigar.operation(0) == BAM_CSOFT_CLIP || cigar.operation(0) == BAM_CHARD_CLIP)) ? cigar.op_length(0) : 0;
+		postclipping_length = (!cigar.empty() && (cigar.operation(cigar.size()-1) == BAM_CSOFT_CLIP || cigar.operation(cigar.size()-1) == BAM_CHARD_CLIP)) ? cigar.op_length(cigar.size()-1) : 0;
+		longest_intron = 0;
+		for (unsigned int i = 1; i + 1 < cigar.size(); ++i)
+			if (cigar.operation(i) == BAM_CREF_SKIP && cigar.op_length(i) > longest_intron)
+				longest_intron = cigar.op_length(i);
+	};
+	unsigned int preclipping() const { return preclipping_length; };
+	unsigned int postclipping() const { return postclipping_length; };
+	// the sequence may have been released to save memory (see memory_budget.hpp), but the CIGAR string covers the same bases
+	unsigned int sequence_length() const {
+		if (!sequence.empty())
+			return sequence.size();
+		unsigned int length = 0;
+		for (unsigned int i = 0; i < cigar.size(); ++i)
+			if (bam_cigar_type(cigar.operation(i)) & 1) // operation consumes query
+				length += cigar.op_length(i);
+		return length;
+	};
 };
 const unsigned int MATE1 = 0;
 const unsigned int MATE2 = 1;
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "tbx.h"
+#include "common.hpp"
+#include "annotation.hpp"
+#include "read_stats.hpp"
+#include "coverage_track.hpp"
+
+using namespace std;
+
+const int COVERAGE_TRACK_FLANK = 1000; // the evidence (see export_evidence.hpp) includes the coverage +/-1000bp around the breakpoints
+
+// for each contig, a sorted list of non-overlapping regions [start, end) for which the coverage is needed
+typedef vector< vector< pair<position_t,position_t> > > regions_t;
+
+void make_regions_around_breakpoints(const fusions_t& fusions, const unsigned int contig_count, const int max_mate_gap, regions_t& regions) {
+
+	// the 'no_coverage' filter looks for fragments between the breakpoint and the farthest anchor or the maximum mate gap
+	const int flank = max(max_mate_gap, COVERAGE_TRACK_FLANK) + COVERAGE_RESOLUTION;
+	regions.resize(contig_count);
+	for (fusions_t::const_iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
+		regions[fusion->second.contig1].push_back(make_pair(
+			max(0, min(fusion->second.breakpoint1, fusion->second.anchor_start1) - flank),
+			max(fusion->second.breakpoint1, fusion->second.anchor_start1) + flank
+		));
+		regions[fusion->second.contig2].push_back(make_pair(
+			max(0, min(fusion->second.breakpoint2, fusion->second.anchor_start2) - flank),
+			max(fusion->second.breakpoint2, fusion->second.anchor_start2) + flank
+		));
+	}
+
+	// merge overlapping regions
+	for (contig_t contig = 0; (unsigned int) contig < regions.size(); ++contig) {
+		vector< pair<position_t,position_t> >& contig_regions = regions[contig];
+		sort(contig_regions.begin(), contig_regions.end());
+		unsigned int merged = 0;
+		for (unsigned int region = 1; region < contig_regions.size(); ++region) {
+			if (contig_regions[region].first <= contig_regions[merged].second)
+				contig_regions[merged].second = max(contig_regions[merged].second, contig_regions[region].second);
+			else
+				contig_regions[++merged] = contig_regions[region];
+		}
+		if (!contig_regions.empty())
+			contig_regions.resize(merged + 1);
+	}
+}
+
+// returns the first region which ends after the given position
+// the regions do not overlap, so they are sorted by their ends, too
+vector< pair<position_t,position_t> >::const_iterator find_region(const vector< pair<position_t,position_t> >& contig_regions, const position_t position) {
+	return lower_bound(contig_regions.begin(), contig_regions.end(), position, [](const pair<position_t,position_t>& region, const position_t position) { return region.second <= position; });
+}
+
+bool is_in_regions(const vector< pair<position_t,position_t> >& contig_regions, const position_t position) {
+	vector< pair<position_t,position_t> >::const_iterator region = find_region(contig_regions, position);
+	return region != contig_regions.end() && region->first <= position;
+}
+
+// converts the intervals of a coverage track to windows of the coverage
+class coverage_track_parser_t {
+	private:
+		const regions_t& regions;
+		coverage_t& coverage;
+		contig_t previous_contig; // the last interval, to detect where the depth rises or falls
+		position_t previous_end;
+		unsigned int previous_depth;
+		void mark_fragment_end(const contig_t contig, const position_t position);
+	public:
+		unsigned int loaded_windows;
+		coverage_track_parser_t(const regions_t& regions, coverage_t& coverage): regions(regions), coverage(coverage), previous_contig(-1), previous_end(0), previous_depth(0), loaded_windows(0) {};
+		void add_interval(const contig_t contig, const position_t start, const position_t end, const unsigned int depth);
+		void finish_contig(); // to be called before a non-adjacent interval is added
+};
+
+void coverage_track_parser_t::mark_fragment_end(const contig_t contig, const position_t position) {
+	if (is_in_regions(regions[contig], position))
+		coverage.mark_fragment_end(contig, position);
+}
+
+void coverage_track_parser_t::finish_contig() {
+	if (previous_contig >= 0 && previous_depth > 0)
+		mark_fragment_end(previous_contig, previous_end - 1);
+	previous_contig = -1;
+}
+
+void coverage_track_parser_t::add_interval(const contig_t contig, const position_t start, const position_t end, const unsigned int depth) {
+
+	// intervals without coverage may be omitted from the track
+	if (contig != previous_contig || start > previous_end)
+		finish_contig();
+	unsigned int depth_before = (previous_contig >= 0) ? previous_depth : 0;
+	previous_contig = contig;
+	previous_end = end;
+	previous_depth = depth;
+
+	if (depth > depth_before) {
+		if (is_in_regions(regions[contig], start))
+			coverage.mark_fragment_start(contig, start);
+	} else if (depth < depth_before) {
+		mark_fragment_end(contig, start - 1);
+	}
+
+	if (depth == 0)
+		return;
+
+	// assign the depth to all windows whose center lies in the interval and in a region of interest
+	const vector< pair<position_t,position_t> >& contig_regions = regions[contig];
+	for (vector< pair<position_t,position_t> >::const_iterator region = find_region(contig_regions, start); region != contig_regions.end() && region->first < end; ++region) {
+		position_t overlap_start = max(start, region->first);
+		position_t overlap_end = min(end, region->second);
+		for (position_t window = overlap_start / COVERAGE_RESOLUTION; window <= (overlap_end - 1) / COVERAGE_RESOLUTION; ++window) {
+			position_t center = window * COVERAGE_RESOLUTION + COVERAGE_RESOLUTION / 2;
+			if (center >= overlap_start && center < overlap_end) {
+				coverage.add_window_coverage(contig, center, depth);
+				loaded_windows++;
+			}
+		}
+	}
+}
+
+// parses a line of a bedGraph file and returns false, if it is not a data line or malformed
+bool parse_bedgraph_line(char* line, const contigs_t& contigs, string& contig_name, contig_t& contig, position_t& start, position_t& end, unsigned int& depth) {
+	if (*line == '\0' || *line == '#' || strncmp(line, "track", 5) == 0 || strncmp(line, "browser", 7) == 0)
+		return false;
+
+	// look up the contig only when it changes
+	char* field_end = strpbrk(line, "\t ");
+	if (field_end == NULL)
+		return false;
+	if (contig_name.compare(0, string::npos, line, field_end - line) != 0) {
+		contig_name.assign(line, field_end - line);
+		contigs_t::const_iterator find_contig = contigs.find(removeChr(contig_name));
+		contig = (find_contig != contigs.end()) ? find_contig->second : -1;
+	}
+
+	char* field = field_end;
+	start = strtol(field, &field_end, 10);
+	if (field_end == field)
+		return false;
+	field = field_end;
+	end = strtol(field, &field_end, 10);
+	if (field_end == field)
+		return false;
+	field = field_end;
+	double value = strtod(field, &field_end);
+	if (field_end == field || start < 0 || end <= start || value < 0)
+		return false;
+	depth = min((double) USHRT_MAX, value + 0.5);
+	return true;
+}
+
+unsigned int load_coverage_track(const string& coverage_track_file_path, const fusions_t& fusions, const contigs_t& contigs, const int max_mate_gap, coverage_t& coverage) {
+
+	regions_t regions;
+	make_regions_around_breakpoints(fusions, contigs.size(), max_mate_gap, regions);
+	coverage_track_parser_t parser(regions, coverage);
+
+	htsFile* coverage_track_file = hts_open(coverage_track_file_path.c_str(), "r");
+	if (coverage_track_file == NULL) {
+		cerr << "ERROR: failed to open coverage track '" << coverage_track_file_path << "'." << endl;
+		exit(1);
+	}
+
+	// only read the regions around the breakpoints, if the file is indexed
+	tbx_t* index = NULL;
+	if (access((coverage_track_file_path + ".tbi").c_str(), R_OK) == 0 || access((coverage_track_file_path + ".csi").c_str(), R_OK) == 0)
+		index = tbx_index_load(coverage_track_file_path.c_str());
+
+	kstring_t line = {0, 0, NULL};
+	string contig_name;
+	contig_t contig = -1;
+	position_t start, end;
+	unsigned int depth;
+	if (index != NULL) {
+
+		// map contigs to the sequence IDs of the index
+		unordered_map<contig_t,int> tid_by_contig;
+		int tid_count = 0;
+		const char** tid_names = tbx_seqnames(index, &tid_count);
+		for (int tid = 0; tid < tid_count; ++tid) {
+			contigs_t::const_iterator find_contig = contigs.find(removeChr(tid_names[tid]));
+			if (find_contig != contigs.end())
+				tid_by_contig[find_contig->second] = tid;
+		}
+		free(tid_names);
+
+		for (contig_t region_contig = 0; (unsigned int) region_contig < regions.size(); ++region_contig) {
+			auto tid = tid_by_contig.find(region_contig);
+			if (tid == tid_by_contig.end())
+				continue; // no coverage on this contig
+			for (auto region = regions[region_contig].begin(); region != regions[region_contig].end(); ++region) {
+				hts_itr_t* iterator = tbx_itr_queryi(index, tid->second, region->first, region->second);
+				if (iterator == NULL)
+					continue;
+				while (tbx_itr_next(coverage_track_file, index, iterator, &line) >= 0)
+					if (parse_bedgraph_line(line.s, contigs, contig_name, contig, start, end, depth) && contig == region_contig)
+						parser.add_interval(contig, start, end, depth);
+				hts_itr_destroy(iterator);
+				parser.finish_contig(); // the depth beyond the region is unknown
+			}
+		}
+		tbx_destroy(index);
+
+	} else {
+
+		while (hts_getline(coverage_track_file, KS_SEP_LINE, &line) >= 0)
+			if (parse_bedgraph_line(line.s, contigs, contig_name, contig, start, end, depth) && contig >= 0)
+				parser.add_interval(contig, start, end, depth);
+		parser.finish_contig();
+	}
+
+	free(line.s);
+	hts_close(coverage_track_file);
+
+	return parser.loaded_windows;
+}
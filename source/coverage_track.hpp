@@ -0,0 +1,18 @@
+#ifndef _COVERAGE_TRACK_H
+#define _COVERAGE_TRACK_H 1
+
+#include <string>
+#include "common.hpp"
+#include "read_stats.hpp"
+
+using namespace std;
+
+// loads a precomputed per-base coverage track in bedGraph format (e.g., from mosdepth or bedtools genomecov)
+// instead of computing the coverage from the alignments; only the vicinity of the breakpoints of the given fusions is loaded
+// if the file is compressed with bgzip and indexed with tabix, only these regions are read, otherwise the whole file is scanned
+// the coverage of a window is the depth at its center; fragments are assumed to start where the depth rises
+// and to end where it falls, since a coverage track does not tell which reads are chimeric
+// returns the number of windows with coverage which have been loaded
+unsigned int load_coverage_track(const string& coverage_track_file_path, const fusions_t& fusions, const contigs_t& contigs, const int max_mate_gap, coverage_t& coverage);
+
+#endif /* _COVERAGE_TRACK_H */
@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "cram.h"
+#include "hfile.h"
+#include "sam.h"
+#include "annotation.hpp"
+#include "common.hpp"
+#include "estimate_resources.hpp"
+#include "options.hpp"
+#include "read_stats.hpp"
+
+using namespace std;
+
+// coarse costs per item, which are used to extrapolate the resource consumption from the sample
+// the memory estimates are derived from the sizes of the data structures (sizeof) and the sampled read lengths,
+// CIGAR strings, and read names; only the overhead per hash node, the base memory, and the size of the annotation
+// relative to the GTF file are assumptions
+// the timings and the ratios of fusions per chimeric fragment are NOT calibrated against a reference data set:
+// they are order-of-magnitude guesses for a single core of a current server CPU and human RNA-Seq data;
+// to calibrate them, run Arriba on representative samples and divide the times of the stages, which are logged
+// in the line "Time taken by each step", by the numbers of items (records, chimeric fragments, fusions) of the run
+const double SECONDS_PER_RECORD = 1.5e-6; // reading and parsing a BAM record
+const double SECONDS_PER_ANNOTATION_BYTE = 2e-8; // parsing the GTF file
+const double SECONDS_PER_ASSEMBLY_BYTE = 3e-9; // parsing the FastA file
+const double SECONDS_PER_CHIMERIC_FRAGMENT_IN_READ_FILTERS = 5e-6; // all filters which discard reads combined
+const double SECONDS_PER_CHIMERIC_FRAGMENT_IN_FIND_FUSIONS = 2e-6;
+const double SECONDS_PER_FUSION_IN_FUSION_FILTERS = 2e-5; // all filters which discard fusions, except for 'homologs' and 'mismappers'
+const double SECONDS_PER_INDEXED_BASE = 1e-7; // making the k-mer index
+const double SECONDS_PER_REALIGNED_READ = 5e-4; // 'homologs' and 'mismappers' filters
+const double FUSIONS_PER_CHIMERIC_FRAGMENT = 0.4; // most breakpoints are supported by a single fragment only
+const double FRACTION_OF_FUSIONS_REACHING_REALIGNMENT = 0.02; // fraction of fusions which pass all cheaper filters
+const double AVERAGE_INDEXED_GENE_LENGTH = 60000; // only the genes of fusions which reach the 'homologs' and 'mismappers' filters are indexed
+const double ANNOTATION_BYTES_PER_GTF_BYTE = 0.6; // memory needed for the annotation relative to the size of the uncompressed GTF file
+const double GZIP_COMPRESSION_RATIO = 8; // used to guess the uncompressed size of gzip-compressed GTF/FastA files
+const unsigned int HASH_NODE_OVERHEAD = 32; // memory needed by a node of an unordered_map in addition to the payload
+const unsigned long int BASE_MEMORY = 50000000; // executable, libraries, I/O buffers
+const unsigned int SAMPLING_STRIDES = 100; // number of equidistant positions from which the sample is drawn, when an index is available
+
+// summary statistics of the records drawn from a BAM file
+struct alignment_sample_t {
+	string sampling; // method used to draw the sample
+	unsigned long int records; // all records in the sample
+	unsigned long int primary_records; // mapped primary alignments
+	unsigned long int paired_records; // mapped primary alignments from paired-end data
+	unsigned long int supplementary_records;
+	unsigned long int chimeric_records; // primary alignments of discordant mates and split reads
+	unsigned long long int chimeric_bases; // sum of the read lengths of chimeric records
+	unsigned long long int chimeric_cigar_operations; // sum of the number of CIGAR operations of chimeric records
+	unsigned long long int chimeric_name_length; // sum of the lengths of the read names of chimeric records
+	double total_records; // (extrapolated) number of records in the entire file
+	bool total_records_exact;
+	unsigned long long int genome_length; // total length of the interesting contigs listed in the header
+	unsigned long long int coverage_windows; // number of windows for which the coverage is stored
+	unsigned int contigs; // number of interesting contigs listed in the header
+	alignment_sample_t(): records(0), primary_records(0), paired_records(0), supplementary_records(0), chimeric_records(0), chimeric_bases(0), chimeric_cigar_operations(0), chimeric_name_length(0), total_records(0), total_records_exact(false), genome_length(0), coverage_windows(0), contigs(0) {};
+};
+
+// classify a record the same way as read_chimeric_alignments() does
+void add_record_to_sample(const bam1_t* bam_record, const bool is_chimeric_bam_file, alignment_sample_t& sample) {
+
+	sample.records++;
+
+	if (bam_record->core.flag & BAM_FUNMAP)
+		return;
+
+	if (bam_record->core.flag & BAM_FSUPPLEMENTARY || is_chimeric_bam_file && (bam_record->core.flag & BAM_FSECONDARY)) {
+		sample.supplementary_records++;
+		return;
+	}
+
+	if (bam_record->core.flag & BAM_FSECONDARY) // multi-mapping reads are ignored
+		return;
+
+	sample.primary_records++;
+	if (bam_record->core.flag & BAM_FPAIRED)
+		sample.paired_records++;
+
+	if (is_chimeric_bam_file || // everything in Chimeric.out.sam is chimeric
+	    (bam_record->core.flag & BAM_FPAIRED) && !(bam_record->core.flag & BAM_FPROPER_PAIR) && !(bam_record->core.flag & BAM_FMUNMAP) || // discordant mates
+	    bam_aux_get(bam_record, "SA") != NULL) { // split read
+		sample.chimeric_records++;
+		sample.chimeric_bases += bam_record->core.l_qseq;
+		sample.chimeric_cigar_operations += bam_record->core.n_cigar;
+		sample.chimeric_name_length += bam_record->core.l_qname;
+	}
+}
+
+// get the size of a file, or estimate the uncompressed size, if the file is gzip-compressed
+double get_uncompressed_file_size(const string& file_path) {
+	struct stat file_stats;
+	if (file_path.empty() || stat(file_path.c_str(), &file_stats) != 0)
+		return 0;
+	if (file_path.size() >= 3 && file_path.substr(file_path.size() - 3) == ".gz")
+		return file_stats.st_size * GZIP_COMPRESSION_RATIO;
+	else
+		return file_stats.st_size;
+}
+
+void sample_alignments(const string& bam_file_path, const string& assembly_file_path, const contigs_t& interesting_contigs, const unsigned int sample_size, const bool is_chimeric_bam_file, alignment_sample_t& sample) {
+
+	// open BAM file
+	samFile* bam_file = sam_open(bam_file_path.c_str(), "rb");
+	if (bam_file == NULL) {
+		cerr << "ERROR: failed to open '" << bam_file_path << "'." << endl;
+		exit(1);
+	}
+	if (bam_file->is_cram)
+		cram_set_option(bam_file->fp.cram, CRAM_OPT_REFERENCE, assembly_file_path.c_str());
+	bam_hdr_t* bam_header = sam_hdr_read(bam_file);
+	if (bam_header == NULL) {
+		cerr << "ERROR: failed to read header of '" << bam_file_path << "'." << endl;
+		exit(1);
+	}
+
+	// memory for the assembly and the coverage is allocated for the interesting contigs
+	unsigned long long int total_target_length = 0;
+	for (int target = 0; target < bam_header->n_targets; ++target) {
+		total_target_length += bam_header->target_len[target];
+		if (interesting_contigs.empty() || interesting_contigs.find(removeChr(bam_header->target_name[target])) != interesting_contigs.end()) {
+			sample.genome_length += bam_header->target_len[target];
+			sample.coverage_windows += bam_header->target_len[target] / COVERAGE_RESOLUTION + 2;
+			sample.contigs++;
+		}
+	}
+
+	bam1_t* bam_record = bam_init1();
+	if (bam_record == NULL) {
+		cerr << "ERROR: failed to allocate memory." << endl;
+		exit(1);
+	}
+
+	// if there is an index, it tells us the exact number of records,
+	// and we can draw the sample from across the genome rather than only from the beginning of the file
+	// CRAM indices have no statistics about the number of records, so they are not used
+	hts_idx_t* bam_index = (bam_file->is_cram) ? NULL : sam_index_load(bam_file, bam_file_path.c_str());
+	if (bam_index != NULL) {
+		// the sample is drawn via region queries, which only return records with a position (mapped reads and their unmapped mates),
+		// so the total must count the same population; unplaced records are neither mapped nor chimeric and need not be extrapolated
+		sample.total_records = 0;
+		sample.total_records_exact = true;
+		for (int target = 0; target < bam_header->n_targets; ++target) {
+			uint64_t mapped, unmapped;
+			if (hts_idx_get_stat(bam_index, target, &mapped, &unmapped) >= 0) // fails for contigs without reads
+				sample.total_records += mapped + unmapped;
+		}
+
+		// read a block of records at equidistant positions of the genome
+		sample.sampling = "strided";
+		const unsigned int records_per_stride = max(sample_size / SAMPLING_STRIDES, 1U);
+		int target = 0;
+		unsigned long long int target_offset = 0; // position of the current target in the concatenated genome
+		for (unsigned int stride = 0; stride < SAMPLING_STRIDES && target < bam_header->n_targets; ++stride) {
+			unsigned long long int stride_position = total_target_length * stride / SAMPLING_STRIDES;
+			while (target < bam_header->n_targets && target_offset + bam_header->target_len[target] <= stride_position)
+				target_offset += bam_header->target_len[target++];
+			if (target == bam_header->n_targets)
+				break;
+			hts_itr_t* bam_iterator = sam_itr_queryi(bam_index, target, stride_position - target_offset, bam_header->target_len[target]);
+			if (bam_iterator == NULL)
+				continue;
+			for (unsigned int record = 0; record < records_per_stride && sam_itr_next(bam_file, bam_iterator, bam_record) >= 0; ++record)
+				add_record_to_sample(bam_record, is_chimeric_bam_file, sample);
+			hts_itr_destroy(bam_iterator);
+		}
+		hts_idx_destroy(bam_index);
+
+	} else {
+
+		// read the first records and extrapolate the total number of records from the fraction of the file read so far
+		sample.sampling = "first_records";
+		while (sample.records < sample_size && sam_read1(bam_file, bam_header, bam_record) >= 0)
+			add_record_to_sample(bam_record, is_chimeric_bam_file, sample);
+		if (sample.records < sample_size) { // the entire file has been read
+			sample.total_records = sample.records;
+			sample.total_records_exact = true;
+		} else {
+			off_t file_position = (bam_file->is_cram) ? htell(cram_fd_get_fp(bam_file->fp.cram)) : (bgzf_tell(bam_file->fp.bgzf) >> 16); // position in the compressed file
+			struct stat file_stats;
+			if (file_position > 0 && stat(bam_file_path.c_str(), &file_stats) == 0)
+				sample.total_records = 1.0 * sample.records * file_stats.st_size / file_position;
+			else
+				sample.total_records = sample.records;
+		}
+
+	}
+
+	// close BAM file
+	bam_destroy1(bam_record);
+	bam_hdr_destroy(bam_header);
+	sam_close(bam_file);
+}
+
+// helper functions to format values for the JSON output
+string to_json_integer(const double value) {
+	return to_string(static_cast<long long int>(llround(value)));
+}
+
+string to_json_string(const string& value) {
+	string result = "\"";
+	for (string::const_iterator c = value.begin(); c != value.end(); ++c) {
+		if (*c == '"' || *c == '\\')
+			result += '\\';
+		result += *c;
+	}
+	return result + "\"";
+}
+
+string to_json_float(const double value) {
+	ostringstream oss;
+	oss << setprecision(4) << value;
+	return oss.str();
+}
+
+string estimate_resources(const string& rna_bam_file_path, const string& chimeric_bam_file_path, const string& assembly_file_path, const string& gene_annotation_file_path, const contigs_t& interesting_contigs, const unsigned int sample_size) {
+
+	alignment_sample_t rna_sample;
+	sample_alignments(rna_bam_file_path, assembly_file_path, interesting_contigs, sample_size, false, rna_sample);
+
+	// when STAR was run with --chimOutType SeparateSAMold, the chimeric alignments are read from Chimeric.out.sam
+	alignment_sample_t chimeric_sample;
+	if (!chimeric_bam_file_path.empty())
+		sample_alignments(chimeric_bam_file_path, assembly_file_path, interesting_contigs, sample_size, true, chimeric_sample);
+	const alignment_sample_t& sample = (chimeric_bam_file_path.empty()) ? rna_sample : chimeric_sample;
+
+	// extrapolate number of reads and chimeric fragments
+	const double records_per_fragment = (rna_sample.paired_records * 2 > rna_sample.primary_records) ? 2 : 1;
+	const double total_reads = rna_sample.total_records * rna_sample.primary_records / max(rna_sample.records, 1UL) / records_per_fragment;
+	const double chimeric_fragments = sample.total_records * sample.chimeric_records / max(sample.records, 1UL) / records_per_fragment;
+	const double chimeric_fraction = (total_reads > 0) ? chimeric_fragments / total_reads : 0;
+	const double fusions = chimeric_fragments * FUSIONS_PER_CHIMERIC_FRAGMENT;
+	const double realigned_fusions = fusions * FRACTION_OF_FUSIONS_REACHING_REALIGNMENT;
+	const double realigned_reads = chimeric_fragments * FRACTION_OF_FUSIONS_REACHING_REALIGNMENT;
+
+	// memory consumption of the main data structures
+	const unsigned long int chimeric_records = max(sample.chimeric_records, 1UL);
+	const double supplementary_per_fragment = min(1.0, sample.supplementary_records * records_per_fragment / chimeric_records);
+	const double alignments_per_fragment = records_per_fragment + supplementary_per_fragment;
+	const double bytes_per_chimeric_fragment =
+		HASH_NODE_OVERHEAD + sizeof(string) + 1.0 * sample.chimeric_name_length / chimeric_records + sizeof(mates_t) +
+		alignments_per_fragment * (sizeof(alignment_t) + sizeof(uint32_t) * sample.chimeric_cigar_operations / chimeric_records + sizeof(gene_t)) +
+		records_per_fragment * sample.chimeric_bases / chimeric_records; // supplementary alignments do not store the sequence
+	const double bytes_per_fusion =
+		HASH_NODE_OVERHEAD + sizeof(fusions_t::value_type) +
+		sizeof(chimeric_alignments_t::iterator) / FUSIONS_PER_CHIMERIC_FRAGMENT + // lists of supporting reads
+		3 * sizeof(fusion_t*); // gene pair index
+	const double indexed_bases = min(1.0 * rna_sample.genome_length, realigned_fusions * 2 * AVERAGE_INDEXED_GENE_LENGTH);
+	const double indexed_kmers = min(indexed_bases, 65536.0 * rna_sample.contigs); // there are at most 4^8 distinct k-mers per contig
+
+	const double assembly_memory = rna_sample.genome_length;
+	const double annotation_memory = get_uncompressed_file_size(gene_annotation_file_path) * ANNOTATION_BYTES_PER_GTF_BYTE;
+	const double coverage_memory = rna_sample.coverage_windows * (sizeof(unsigned short int) + 0.25/*two bits*/); // upper bound, blocks without reads are not allocated
+	const double chimeric_alignments_memory = chimeric_fragments * bytes_per_chimeric_fragment;
+	const double fusions_memory = fusions * bytes_per_fusion;
+	const double kmer_index_memory = indexed_bases * sizeof(int) + indexed_kmers * (HASH_NODE_OVERHEAD + sizeof(vector<int>));
+	// all of the above are held until the end
+	const double peak_memory = BASE_MEMORY + assembly_memory + annotation_memory + coverage_memory + chimeric_alignments_memory + fusions_memory + kmer_index_memory;
+
+	// runtime of the main steps
+	const double load_annotation_time = get_uncompressed_file_size(gene_annotation_file_path) * SECONDS_PER_ANNOTATION_BYTE;
+	const double load_assembly_time = get_uncompressed_file_size(assembly_file_path) * SECONDS_PER_ASSEMBLY_BYTE;
+	const double read_alignments_time = (rna_sample.total_records + chimeric_sample.total_records) * SECONDS_PER_RECORD;
+	const double read_filters_time = chimeric_fragments * SECONDS_PER_CHIMERIC_FRAGMENT_IN_READ_FILTERS;
+	const double find_fusions_time = chimeric_fragments * SECONDS_PER_CHIMERIC_FRAGMENT_IN_FIND_FUSIONS;
+	const double fusion_filters_time = fusions * SECONDS_PER_FUSION_IN_FUSION_FILTERS;
+	const double realignment_time = indexed_bases * SECONDS_PER_INDEXED_BASE + realigned_reads * SECONDS_PER_REALIGNED_READ;
+	// the assembly and the annotation are loaded concurrently
+	const double total_time = max(load_annotation_time, load_assembly_time) + read_alignments_time + read_filters_time + find_fusions_time + fusion_filters_time + realignment_time;
+
+	ostringstream json;
+	json << "{" << endl
+	     << "  \"version\": " << to_json_string(ARRIBA_VERSION) << "," << endl
+	     << "  \"input\": {" << endl
+	     << "    \"file\": " << to_json_string(rna_bam_file_path) << "," << endl
+	     << "    \"sampling\": " << to_json_string(rna_sample.sampling) << "," << endl
+	     << "    \"sampled_records\": " << rna_sample.records << "," << endl
+	     << "    \"total_records\": " << to_json_integer(rna_sample.total_records) << "," << endl
+	     << "    \"total_records_exact\": " << ((rna_sample.total_records_exact) ? "true" : "false") << endl
+	     << "  }," << endl;
+	if (!chimeric_bam_file_path.empty())
+		json << "  \"chimeric_input\": {" << endl
+		     << "    \"file\": " << to_json_string(chimeric_bam_file_path) << "," << endl
+		     << "    \"sampling\": " << to_json_string(chimeric_sample.sampling) << "," << endl
+		     << "    \"sampled_records\": " << chimeric_sample.records << "," << endl
+		     << "    \"total_records\": " << to_json_integer(chimeric_sample.total_records) << "," << endl
+		     << "    \"total_records_exact\": " << ((chimeric_sample.total_records_exact) ? "true" : "false") << endl
+		     << "  }," << endl;
+	json << "  \"reads\": {" << endl
+	     << "    \"paired_end\": " << ((records_per_fragment == 2) ? "true" : "false") << "," << endl
+	     << "    \"total\": " << to_json_integer(total_reads) << "," << endl
+	     << "    \"chimeric\": " << to_json_integer(chimeric_fragments) << "," << endl
+	     << "    \"chimeric_fraction\": " << to_json_float(chimeric_fraction) << endl
+	     << "  }," << endl
+	     << "  \"fusions\": " << to_json_integer(fusions) << "," << endl
+	     << "  \"memory_bytes\": {" << endl
+	     << "    \"assembly\": " << to_json_integer(assembly_memory) << "," << endl
+	     << "    \"annotation\": " << to_json_integer(annotation_memory) << "," << endl
+	     << "    \"coverage\": " << to_json_integer(coverage_memory) << "," << endl
+	     << "    \"chimeric_alignments\": " << to_json_integer(chimeric_alignments_memory) << "," << endl
+	     << "    \"fusions\": " << to_json_integer(fusions_memory) << "," << endl
+	     << "    \"kmer_index\": " << to_json_integer(kmer_index_memory) << "," << endl
+	     << "    \"peak\": " << to_json_integer(peak_memory) << endl
+	     << "  }," << endl
+	     << "  \"runtime_seconds\": {" << endl
+	     << "    \"load_annotation\": " << to_json_float(load_annotation_time) << "," << endl
+	     << "    \"load_assembly\": " << to_json_float(load_assembly_time) << "," << endl
+	     << "    \"read_alignments\": " << to_json_float(read_alignments_time) << "," << endl
+	     << "    \"read_filters\": " << to_json_float(read_filters_time) << "," << endl
+	     << "    \"find_fusions\": " << to_json_float(find_fusions_time) << "," << endl
+	     << "    \"fusion_filters\": " << to_json_float(fusion_filters_time) << "," << endl
+	     << "    \"homologs_and_mismappers\": " << to_json_float(realignment_time) << "," << endl
+	     << "    \"total\": " << to_json_float(total_time) << endl
+	     << "  }" << endl
+	     << "}" << endl;
+	return json.str();
+}
@@ -0,0 +1,14 @@
+#ifndef _ESTIMATE_RESOURCES_H
+#define _ESTIMATE_RESOURCES_H 1
+
+#include <string>
+#include "common.hpp"
+
+using namespace std;
+
+// predict the number of reads, the peak memory consumption, and the runtime of the main steps
+// from a sample of the alignments without running the workflow
+// the estimate is returned as a JSON document
+string estimate_resources(const string& rna_bam_file_path, const string& chimeric_bam_file_path, const string& assembly_file_path, const string& gene_annotation_file_path, const contigs_t& interesting_contigs, const unsigned int sample_size);
+
+#endif /* _ESTIMATE_RESOURCES_H */
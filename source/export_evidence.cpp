@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include "sam.h"
+#include "common.hpp"
+#include "read_stats.hpp"
+#include "export_evidence.hpp"
+
+using namespace std;
+
+const position_t EVIDENCE_COVERAGE_FLANK = 1000; // how many bp up- and downstream of a breakpoint to write the coverage for
+
+// the alignments in chimeric_alignments_t lack qualities, flags, and tags,
+// so we synthesize BAM records from what we have: name, position, strand, CIGAR string, and sequence
+bam1_t* alignment_to_bam_record(const string& name, const mates_t& mates, const unsigned int index) {
+
+	const alignment_t& alignment = mates[index];
+	bam1_t* bam_record = bam_init1();
+	bam_record->core.tid = alignment.contig;
+	bam_record->core.pos = alignment.start;
+	bam_record->core.bin = hts_reg2bin(alignment.start, alignment.end + 1, 14, 5);
+	bam_record->core.qual = 255; // mapping quality is unavailable
+	// like bam_set1() of htslib, the read name is padded with NULs to a multiple of 4 bytes, such that the CIGAR string is aligned
+	// (unless the padded name would not fit into l_qname, which only happens for names near the limit of the SAM format)
+	bam_record->core.l_extranul = (name.size() + 1 <= 252) ? (4 - (name.size() + 1) % 4) % 4 : 0;
+	bam_record->core.l_qname = name.size() + 1 + bam_record->core.l_extranul;
+	bam_record->core.n_cigar = alignment.cigar.size();
+	bam_record->core.l_qseq = alignment.sequence.size(); // the sequence of supplementary alignments is not kept
+	bam_record->core.mtid = -1;
+	bam_record->core.mpos = -1;
+	bam_record->core.isize = 0;
+
+	bam_record->core.flag = 0;
+	if (alignment.strand == REVERSE)
+		bam_record->core.flag |= BAM_FREVERSE;
+	if (alignment.supplementary)
+		bam_record->core.flag |= BAM_FSUPPLEMENTARY;
+	// reads discarded by a read-level filter are kept, because they are counted in the column 'filters' of the output file
+	if (mates.filter == FILTERS.at("duplicates"))
+		bam_record->core.flag |= BAM_FDUP;
+	else if (mates.filter != NULL)
+		bam_record->core.flag |= BAM_FQCFAIL;
+	if (!mates.single_end) {
+		bam_record->core.flag |= BAM_FPAIRED | ((alignment.first_in_pair) ? BAM_FREAD1 : BAM_FREAD2);
+		// the mate of the split read and of the supplementary alignment is MATE1 and vice versa
+		const alignment_t& mate = mates[(index == MATE1) ? MATE2 : MATE1];
+		bam_record->core.mtid = mate.contig;
+		bam_record->core.mpos = mate.start;
+		if (mate.strand == REVERSE)
+			bam_record->core.flag |= BAM_FMREVERSE;
+	}
+
+	// layout of the data block: read name, CIGAR string, sequence, qualities
+	bam_record->l_data = bam_record->core.l_qname + bam_record->core.n_cigar * 4 + (bam_record->core.l_qseq + 1) / 2 + bam_record->core.l_qseq;
+	bam_record->m_data = bam_record->l_data;
+	bam_record->data = (uint8_t*) realloc(bam_record->data, bam_record->m_data);
+	if (bam_record->data == NULL) {
+		cerr << "ERROR: failed to allocate memory." << endl;
+		exit(1);
+	}
+	memcpy(bam_get_qname(bam_record), name.c_str(), name.size() + 1);
+	memset(bam_get_qname(bam_record) + name.size() + 1, 0, bam_record->core.l_extranul);
+	for (unsigned int i = 0; i < alignment.cigar.size(); ++i)
+		bam_get_cigar(bam_record)[i] = alignment.cigar[i];
+	uint8_t* sequence = bam_get_seq(bam_record);
+	memset(sequence, 0, (bam_record->core.l_qseq + 1) / 2);
+	for (int i = 0; i < bam_record->core.l_qseq; ++i)
+		sequence[i/2] |= seq_nt16_table[(unsigned char) alignment.sequence[i]] << ((~i & 1) << 2);
+	memset(bam_get_qual(bam_record), 0xff, bam_record->core.l_qseq); // qualities are unavailable
+
+	return bam_record;
+}
+
+bool sort_bam_records_by_coordinate(const bam1_t* x, const bam1_t* y) {
+	if (x->core.tid != y->core.tid)
+		return x->core.tid < y->core.tid;
+	if (x->core.pos != y->core.pos)
+		return x->core.pos < y->core.pos;
+	return strcmp(bam_get_qname(x), bam_get_qname(y)) < 0;
+}
+
+void write_evidence_bam(const vector<chimeric_alignments_t::iterator>& supporting_reads, const string& output_file, const assembly_t& assembly, const vector<string>& contigs_by_id) {
+
+	// convert the alignments to BAM records and sort them
+	vector<bam1_t*> bam_records;
+	vector<position_t> contig_lengths(contigs_by_id.size(), 0);
+	for (auto chimeric_alignment = supporting_reads.begin(); chimeric_alignment != supporting_reads.end(); ++chimeric_alignment) {
+		const mates_t& mates = (**chimeric_alignment).second;
+		for (unsigned int index = 0; index < mates.size(); ++index) {
+			if (mates.single_end && index == MATE1)
+				continue; // for single-end reads, MATE1 is a copy of the SPLIT_READ (see filter_multi_mappers.cpp)
+			bam_records.push_back(alignment_to_bam_record((**chimeric_alignment).first, mates, index));
+			contig_lengths[mates[index].contig] = max(contig_lengths[mates[index].contig], mates[index].end + 1);
+		}
+	}
+	sort(bam_records.begin(), bam_records.end(), sort_bam_records_by_coordinate);
+
+	// the header lists all contigs by their ID, so that the contig IDs of the alignments can be used as is
+	string header_text = "@HD\tVN:1.4\tSO:coordinate\n";
+	bam_hdr_t* bam_header = bam_hdr_init();
+	bam_header->n_targets = contigs_by_id.size();
+	bam_header->target_name = (char**) malloc(contigs_by_id.size() * sizeof(char*));
+	bam_header->target_len = (uint32_t*) malloc(contigs_by_id.size() * sizeof(uint32_t));
+	for (contig_t contig = 0; (unsigned int) contig < contigs_by_id.size(); ++contig) {
+		assembly_t::const_iterator contig_sequence = assembly.find(contig);
+		if (contig_sequence != assembly.end())
+			contig_lengths[contig] = max(contig_lengths[contig], (position_t) contig_sequence->second.size());
+		contig_lengths[contig] = max(contig_lengths[contig], 1); // contigs of length 0 are invalid
+		bam_header->target_name[contig] = strdup(contigs_by_id[contig].c_str());
+		bam_header->target_len[contig] = contig_lengths[contig];
+		header_text += "@SQ\tSN:" + contigs_by_id[contig] + "\tLN:" + to_string(static_cast<long long int>(contig_lengths[contig])) + "\n";
+	}
+	bam_header->l_text = header_text.size();
+	bam_header->text = strdup(header_text.c_str());
+
+	samFile* bam_file = sam_open(output_file.c_str(), "wb");
+	if (bam_file == NULL) {
+		cerr << "ERROR: failed to open output file '" << output_file << "'." << endl;
+		exit(1);
+	}
+	if (sam_hdr_write(bam_file, bam_header) < 0) {
+		cerr << "ERROR: failed to write header to '" << output_file << "'." << endl;
+		exit(1);
+	}
+	for (auto bam_record = bam_records.begin(); bam_record != bam_records.end(); ++bam_record) {
+		if (sam_write1(bam_file, bam_header, *bam_record) < 0) {
+			cerr << "ERROR: failed to write alignment to '" << output_file << "'." << endl;
+			exit(1);
+		}
+		bam_destroy1(*bam_record);
+	}
+	sam_close(bam_file);
+	bam_hdr_destroy(bam_header);
+
+	if (sam_index_build(output_file.c_str(), 0) < 0)
+		cerr << "WARNING: failed to index '" << output_file << "'." << endl;
+}
+
+void write_coverage_track(const fusions_t& fusions, const string& output_file, const coverage_t& coverage, const vector<string>& contigs_by_id) {
+
+	// collect the windows around the breakpoints, sorted by coordinate and without duplicates
+	set< pair<contig_t,position_t> > windows;
+	for (fusions_t::const_iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
+		if (fusion->second.filter != NULL)
+			continue;
+		for (int breakpoint = 1; breakpoint <= 2; ++breakpoint) {
+			contig_t contig = (breakpoint == 1) ? fusion->second.contig1 : fusion->second.contig2;
+			position_t position = (breakpoint == 1) ? fusion->second.breakpoint1 : fusion->second.breakpoint2;
+			for (position_t window = max(0, position - EVIDENCE_COVERAGE_FLANK) / COVERAGE_RESOLUTION; window <= (position + EVIDENCE_COVERAGE_FLANK) / COVERAGE_RESOLUTION; ++window)
+				windows.insert(make_pair(contig, window));
+		}
+	}
+
+	ofstream out(output_file);
+	if (!out.is_open()) {
+		cerr << "ERROR: failed to open output file '" << output_file << "'." << endl;
+		exit(1);
+	}
+	out << "track type=bedGraph name=\"coverage around breakpoints\"" << endl;
+	for (auto window = windows.begin(); window != windows.end(); ++window) {
+		int window_coverage = coverage.get_coverage(window->first, window->second * COVERAGE_RESOLUTION);
+		if (window_coverage < 0)
+			continue; // coverage is not available for this contig
+		out << contigs_by_id[window->first] << "\t" << (window->second * COVERAGE_RESOLUTION) << "\t" << ((window->second + 1) * COVERAGE_RESOLUTION) << "\t" << window_coverage << endl;
+	}
+	out.close();
+}
+
+void export_evidence(const fusions_t& fusions, const string& output_prefix, const coverage_t& coverage, const assembly_t& assembly, const vector<string>& contigs_by_id) {
+
+	// a read may support several fusions, but it must be written only once
+	vector<chimeric_alignments_t::iterator> supporting_reads;
+	for (fusions_t::const_iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
+		if (fusion->second.filter != NULL)
+			continue;
+		supporting_reads.insert(supporting_reads.end(), fusion->second.split_read1_list.begin(), fusion->second.split_read1_list.end());
+		supporting_reads.insert(supporting_reads.end(), fusion->second.split_read2_list.begin(), fusion->second.split_read2_list.end());
+		supporting_reads.insert(supporting_reads.end(), fusion->second.discordant_mate_list.begin(), fusion->second.discordant_mate_list.end());
+	}
+	sort(supporting_reads.begin(), supporting_reads.end(), [](const chimeric_alignments_t::iterator& x, const chimeric_alignments_t::iterator& y) { return x->first < y->first; });
+	supporting_reads.erase(unique(supporting_reads.begin(), supporting_reads.end()), supporting_reads.end());
+
+	write_evidence_bam(supporting_reads, output_prefix + ".bam", assembly, contigs_by_id);
+	write_coverage_track(fusions, output_prefix + ".coverage.bedGraph", coverage, contigs_by_id);
+}
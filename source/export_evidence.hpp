@@ -0,0 +1,16 @@
+#ifndef _EXPORT_EVIDENCE_H
+#define _EXPORT_EVIDENCE_H 1
+
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "read_stats.hpp"
+
+using namespace std;
+
+// the supporting reads of the fusions which passed all filters are written to <output_prefix>.bam,
+// sorted by coordinate and indexed, and the coverage around their breakpoints is written to <output_prefix>.coverage.bedGraph,
+// so that the fusions can be visualized without scanning the entire BAM file again
+void export_evidence(const fusions_t& fusions, const string& output_prefix, const coverage_t& coverage, const assembly_t& assembly, const vector<string>& contigs_by_id);
+
+#endif /* _EXPORT_EVIDENCE_H */
@@ -14,17 +14,6 @@
 
 using namespace std;
 
-enum blacklist_item_type_t { BLACKLIST_RANGE, BLACKLIST_POSITION, BLACKLIST_GENE, BLACKLIST_ANY, BLACKLIST_SPLIT_READ_DONOR, BLACKLIST_SPLIT_READ_ACCEPTOR, BLACKLIST_SPLIT_READ_ANY, BLACKLIST_DISCORDANT_MATES, BLACKLIST_READ_THROUGH, BLACKLIST_LOW_SUPPORT, BLACKLIST_FILTER_SPLICED, BLACKLIST_NOT_BOTH_SPLICED };
-struct blacklist_item_t {
-	blacklist_item_type_t type;
-	bool strand_defined;
-	strand_t strand;
-	contig_t contig;
-	position_t start;
-	position_t end;
-	gene_t gene;
-};
-
 // convert string representation of a range into coordinates
 bool parse_range(string range, const contigs_t& contigs, blacklist_item_t& blacklist_item) {
 	istringstream iss;
@@ -223,7 +212,29 @@ void get_index_keys_from_range(const contig_t contig, const position_t start, co
 		index_keys.push_back(make_tuple(contig, position*bucket_size));
 }
 
-unsigned int filter_blacklisted_ranges(fusions_t& fusions, const string& blacklist_file_path, const contigs_t& contigs, const unordered_map<string,gene_t>& genes, const float evalue_cutoff, const int max_mate_gap) {
+void read_blacklist(const string& blacklist_file_path, const contigs_t& contigs, const unordered_map<string,gene_t>& genes, blacklist_t& blacklist) {
+	stringstream blacklist_file;
+	autodecompress_file(blacklist_file_path, blacklist_file);
+	string line;
+	while (getline(blacklist_file, line)) {
+
+		// skip comment lines
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		// parse line
+		istringstream iss(line);
+		string range1, range2;
+		iss >> range1 >> range2;
+		blacklist_item_t item1, item2;
+		if (!parse_blacklist_item(range1, item1, contigs, genes, false) ||
+		    !parse_blacklist_item(range2, item2, contigs, genes, true))
+			continue;
+		blacklist.push_back(make_pair(item1, item2));
+	}
+}
+
+unsigned int filter_blacklisted_ranges(fusions_t& fusions, const blacklist_t& blacklist, const float evalue_cutoff, const int max_mate_gap) {
 
 	// index fusions by coordinate
 	unordered_map< tuple<contig_t,position_t>, set<fusion_t*> > fusions_by_coordinate;
@@ -243,24 +254,9 @@ unsigned int filter_blacklisted_ranges(fusions_t& fusions, const string& blackli
 			fusions_by_coordinate[*index_key].insert(&(fusion->second));
 	}
 
-	// load blacklist from file
-	stringstream blacklist_file;
-	autodecompress_file(blacklist_file_path, blacklist_file);
-	string line;
-	while (getline(blacklist_file, line)) {
-
-		// skip comment lines
-		if (line.empty() || line[0] == '#')
-			continue;
-
-		// parse line
-		istringstream iss(line);
-		string range1, range2;
-		iss >> range1 >> range2;
-		blacklist_item_t item1, item2;
-		if (!parse_blacklist_item(range1, item1, contigs, genes, false) ||
-		    !parse_blacklist_item(range2, item2, contigs, genes, true))
-			continue;
+	for (blacklist_t::const_iterator blacklist_entry = blacklist.begin(); blacklist_entry != blacklist.end(); ++blacklist_entry) {
+		const blacklist_item_t& item1 = blacklist_entry->first;
+		const blacklist_item_t& item2 = blacklist_entry->second;
 
 		// find all fusions with breakpoints in the vicinity of the blacklist items
 		vector< tuple<contig_t,position_t> > index_keys;
@@ -3,10 +3,27 @@
 
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include "common.hpp"
 
 using namespace std;
 
-unsigned int filter_blacklisted_ranges(fusions_t& fusions, const string& blacklist_file_path, const contigs_t& contigs, const unordered_map<string,gene_t>& genes, const float evalue_cutoff, const int max_mate_gap);
+enum blacklist_item_type_t { BLACKLIST_RANGE, BLACKLIST_POSITION, BLACKLIST_GENE, BLACKLIST_ANY, BLACKLIST_SPLIT_READ_DONOR, BLACKLIST_SPLIT_READ_ACCEPTOR, BLACKLIST_SPLIT_READ_ANY, BLACKLIST_DISCORDANT_MATES, BLACKLIST_READ_THROUGH, BLACKLIST_LOW_SUPPORT, BLACKLIST_FILTER_SPLICED, BLACKLIST_NOT_BOTH_SPLICED };
+struct blacklist_item_t {
+	blacklist_item_type_t type;
+	bool strand_defined;
+	strand_t strand;
+	contig_t contig;
+	position_t start;
+	position_t end;
+	gene_t gene;
+};
+typedef vector< pair<blacklist_item_t,blacklist_item_t> > blacklist_t;
+
+// the blacklist is parsed once, so that it can be applied to several samples
+void read_blacklist(const string& blacklist_file_path, const contigs_t& contigs, const unordered_map<string,gene_t>& genes, blacklist_t& blacklist);
+
+unsigned int filter_blacklisted_ranges(fusions_t& fusions, const blacklist_t& blacklist, const float evalue_cutoff, const int max_mate_gap);
 
 #endif /* _FILTER_BLACKLISTED_RANGES_H */
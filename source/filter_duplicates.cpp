@@ -1,46 +1,172 @@
-#include <unordered_map>
-#include <tuple>
+#include <algorithm>
+#include <stdint.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include "common.hpp"
 #include "filter_duplicates.hpp"
 
 using namespace std;
 
+// duplicates are identified by the contigs and the 5' ends (including clipped bases) of both mates
+// each contig takes 32 bits of the key, such that the key does not depend on the number of contigs
+struct duplicate_key_t {
+	uint64_t contigs;
+	uint32_t position1;
+	uint32_t position2;
+	uint32_t read; // index of the read in the order of iteration over the chimeric alignments
+};
+
+// contigs are converted to unsigned values of the same width, so that negative IDs do not spill into the upper bits
+typedef make_unsigned<contig_t>::type unsigned_contig_t;
+static_assert(sizeof(contig_t) <= sizeof(uint32_t), "contig IDs must fit into the duplicate key");
+
+// below this number of reads, spawning threads costs more than it saves
+const size_t MIN_READS_PER_THREAD = 1 << 16;
+
+// splits the range [0, size) into one chunk per thread and runs the given function on each chunk
+template <class F> void run_in_chunks(const size_t size, const unsigned int threads, F function) {
+	vector<thread> workers;
+	for (unsigned int t = 1; t < threads; ++t)
+		workers.push_back(thread(function, t, size * t / threads, size * (t+1) / threads));
+	function(0, 0, size / threads); // the calling thread processes the first chunk
+	for (auto worker = workers.begin(); worker != workers.end(); ++worker)
+		worker->join();
+}
+
+inline unsigned int get_key_byte(const duplicate_key_t& key, const unsigned int byte) {
+	if (byte < 4)
+		return (key.position2 >> (byte * 8)) & 0xff;
+	else if (byte < 8)
+		return (key.position1 >> ((byte - 4) * 8)) & 0xff;
+	else
+		return (key.contigs >> ((byte - 8) * 8)) & 0xff;
+}
+
+// the bytes of the key which can be non-zero: both positions and as many bytes of each contig as contig_t has
+vector<unsigned int> get_significant_key_bytes() {
+	vector<unsigned int> bytes;
+	for (unsigned int byte = 0; byte < 8; ++byte)
+		bytes.push_back(byte);
+	for (unsigned int contig = 0; contig < 2; ++contig)
+		for (unsigned int byte = 0; byte < sizeof(unsigned_contig_t); ++byte)
+			bytes.push_back(8 + contig * 4 + byte);
+	return bytes;
+}
+
+// stable least-significant-digit radix sort by the significant bytes of the key
+// each pass counts the bytes per chunk, then every thread scatters its chunk to the offsets reserved for it,
+// such that reads with equal keys retain their original order
+void radix_sort_duplicate_keys(vector<duplicate_key_t>& keys, const unsigned int threads) {
+	vector<duplicate_key_t> buffer(keys.size());
+	vector< vector<size_t> > offsets(threads, vector<size_t>(256));
+	const vector<unsigned int> significant_bytes = get_significant_key_bytes();
+	for (auto significant_byte = significant_bytes.begin(); significant_byte != significant_bytes.end(); ++significant_byte) {
+		const unsigned int byte = *significant_byte;
+
+		// count occurrences of each value of the byte in each chunk
+		run_in_chunks(keys.size(), threads, [&](const unsigned int t, const size_t begin, const size_t end) {
+			vector<size_t>& histogram = offsets[t];
+			fill(histogram.begin(), histogram.end(), 0);
+			for (size_t i = begin; i < end; ++i)
+				++histogram[get_key_byte(keys[i], byte)];
+		});
+
+		// skip the pass, if all keys have the same value (e.g., the high bytes of contigs and positions)
+		bool constant_byte = false;
+		for (unsigned int value = 0; value < 256 && !constant_byte; ++value) {
+			size_t count = 0;
+			for (unsigned int t = 0; t < threads; ++t)
+				count += offsets[t][value];
+			if (count == keys.size())
+				constant_byte = true;
+			else if (count > 0)
+				break;
+		}
+		if (constant_byte)
+			continue;
+
+		// convert counts to offsets: values in ascending order, chunks in ascending order within each value
+		size_t offset = 0;
+		for (unsigned int value = 0; value < 256; ++value) {
+			for (unsigned int t = 0; t < threads; ++t) {
+				size_t count = offsets[t][value];
+				offsets[t][value] = offset;
+				offset += count;
+			}
+		}
+
+		// scatter keys into buffer
+		run_in_chunks(keys.size(), threads, [&](const unsigned int t, const size_t begin, const size_t end) {
+			vector<size_t>& chunk_offsets = offsets[t];
+			for (size_t i = begin; i < end; ++i)
+				buffer[chunk_offsets[get_key_byte(keys[i], byte)]++] = keys[i];
+		});
+		keys.swap(buffer);
+	}
+}
+
 unsigned int filter_duplicates(chimeric_alignments_t& chimeric_alignments) {
-	unsigned int remaining = 0;
-	unordered_map< tuple<contig_t,contig_t,position_t,position_t> , unsigned int> duplicate_count;
-	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
-		if (chimeric_alignment->second.filter != NULL)
-			continue; // read has already been filtered
-
-		unsigned int mate2 = (chimeric_alignment->second.size() == 2) ? MATE2 : SUPPLEMENTARY;
-
-		// get start coordinates of reads
-		position_t position1 = static_cast<position_t>(
-			(chimeric_alignment->second[MATE1].strand == FORWARD) ?
-			chimeric_alignment->second[MATE1].start - chimeric_alignment->second[MATE1].preclipping() :
-			chimeric_alignment->second[MATE1].end   + chimeric_alignment->second[MATE1].postclipping()
-		);
-		position_t position2 = static_cast<position_t>(
-			(chimeric_alignment->second[mate2].strand == FORWARD) ?
-			chimeric_alignment->second[mate2].start - chimeric_alignment->second[mate2].preclipping() :
-			chimeric_alignment->second[mate2].end   + chimeric_alignment->second[mate2].postclipping()
-		);
-		contig_t contig1 = chimeric_alignment->second[MATE1].contig;
-		contig_t contig2 = chimeric_alignment->second[mate2].contig;
-
-		// always put the mate with the lower coordinate in first position
-		// or else we might not recognize the duplicate
-		if (position1 > position2) {
-			swap(position1, position2);
-			swap(contig1, contig2);
+
+	// collect reads which have not been filtered yet
+	// the order of iteration defines which read of a set of duplicates is kept (the first one)
+	vector<chimeric_alignments_t::iterator> reads;
+	reads.reserve(chimeric_alignments.size());
+	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment)
+		if (chimeric_alignment->second.filter == NULL) // read has not been filtered yet
+			reads.push_back(chimeric_alignment);
+	if (reads.empty())
+		return 0;
+
+	unsigned int threads = max(1U, min(thread::hardware_concurrency(), static_cast<unsigned int>(reads.size() / MIN_READS_PER_THREAD)));
+
+	// compute keys of reads in parallel
+	vector<duplicate_key_t> keys(reads.size());
+	run_in_chunks(reads.size(), threads, [&](const unsigned int t, const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			mates_t& mates = reads[i]->second;
+			unsigned int mate2 = (mates.size() == 2) ? MATE2 : SUPPLEMENTARY;
+
+			// get start coordinates of reads
+			position_t position1 = static_cast<position_t>(
+				(mates[MATE1].strand == FORWARD) ?
+				mates[MATE1].start - mates[MATE1].preclipping() :
+				mates[MATE1].end   + mates[MATE1].postclipping()
+			);
+			position_t position2 = static_cast<position_t>(
+				(mates[mate2].strand == FORWARD) ?
+				mates[mate2].start - mates[mate2].preclipping() :
+				mates[mate2].end   + mates[mate2].postclipping()
+			);
+			contig_t contig1 = mates[MATE1].contig;
+			contig_t contig2 = mates[mate2].contig;
+
+			// always put the mate with the lower coordinate in first position
+			// or else we might not recognize the duplicate
+			if (position1 > position2) {
+				swap(position1, position2);
+				swap(contig1, contig2);
+			}
+
+			keys[i].contigs = (static_cast<uint64_t>(static_cast<unsigned_contig_t>(contig1)) << 32) | static_cast<unsigned_contig_t>(contig2);
+			keys[i].position1 = static_cast<uint32_t>(position1);
+			keys[i].position2 = static_cast<uint32_t>(position2);
+			keys[i].read = i;
 		}
+	});
 
-		if (duplicate_count[make_tuple(contig1, contig2, position1, position2)]++ > 0)
-			chimeric_alignment->second.filter = FILTERS.at("duplicates");
+	// group duplicates by sorting the keys
+	radix_sort_duplicate_keys(keys, threads);
+
+	// keep the first read of each group of identical keys and discard the rest
+	unsigned int remaining = 0;
+	filter_t duplicates_filter = FILTERS.at("duplicates");
+	for (size_t i = 0; i < keys.size(); ++i) {
+		if (i > 0 && keys[i].contigs == keys[i-1].contigs && keys[i].position1 == keys[i-1].position1 && keys[i].position2 == keys[i-1].position2)
+			reads[keys[i].read]->second.filter = duplicates_filter;
 		else
 			++remaining;
 	}
 
 	return remaining;
 }
-
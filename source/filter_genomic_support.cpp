@@ -7,6 +7,7 @@
 #include <vector>
 #include "common.hpp"
 #include "annotation.hpp"
+#include "gene_pair_index.hpp"
 #include "read_compressed_file.hpp"
 #include "read_stats.hpp"
 #include "filter_genomic_support.hpp"
@@ -156,15 +157,10 @@ unsigned int mark_genomic_support(fusions_t& fusions, const string& genomic_brea
 	return marked;
 }
 
-void assign_confidence(fusions_t& fusions, const coverage_t& coverage) {
+void assign_confidence(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const coverage_t& coverage) {
 
-	// order fusions by gene pair
-	// => the confidence in an event is increased, when there are other events between the same pair of genes
-	map< gene_t, vector<fusion_t*> > fusions_by_gene;
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
-		fusions_by_gene[fusion->second.gene1].push_back(&fusion->second);
-		fusions_by_gene[fusion->second.gene2].push_back(&fusion->second);
-	}
+	// the confidence in an event is increased, when there are other events between the same pair of genes
+	// => fusions of a given gene are looked up in the gene pair index
 
 	// assign a confidence to each fusion
 	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
@@ -206,8 +202,8 @@ void assign_confidence(fusions_t& fusions, const coverage_t& coverage) {
 				} else {
 					// look for multiple deletions involving the same gene
 					unsigned int number_of_deletions = 0;
-					auto fusions_of_gene = fusions_by_gene.find(fusion->second.gene1);
-					for (auto fusion_of_gene = fusions_of_gene->second.begin(); fusion_of_gene != fusions_of_gene->second.end(); ++fusion_of_gene) {
+					gene_pair_index_t::range_t fusions_of_gene = gene_pair_index.find(fusion->second.gene1);
+					for (gene_pair_index_t::iterator fusion_of_gene = fusions_of_gene.first; fusion_of_gene != fusions_of_gene.second; ++fusion_of_gene) {
 						if ((**fusion_of_gene).filter == NULL &&
 						    (**fusion_of_gene).split_reads1 + (**fusion_of_gene).split_reads2 > 0 &&
 						    (**fusion_of_gene).direction1 == DOWNSTREAM && (**fusion_of_gene).direction2 == UPSTREAM &&
@@ -218,8 +214,8 @@ void assign_confidence(fusions_t& fusions, const coverage_t& coverage) {
 							++number_of_deletions;
 						}
 					}
-					fusions_of_gene = fusions_by_gene.find(fusion->second.gene2);
-					for (auto fusion_of_gene = fusions_of_gene->second.begin(); fusion_of_gene != fusions_of_gene->second.end(); ++fusion_of_gene) {
+					fusions_of_gene = gene_pair_index.find(fusion->second.gene2);
+					for (gene_pair_index_t::iterator fusion_of_gene = fusions_of_gene.first; fusion_of_gene != fusions_of_gene.second; ++fusion_of_gene) {
 						if ((**fusion_of_gene).filter == NULL &&
 						    (**fusion_of_gene).split_reads1 + (**fusion_of_gene).split_reads2 > 0 &&
 						    (**fusion_of_gene).direction1 == DOWNSTREAM && (**fusion_of_gene).direction2 == UPSTREAM &&
@@ -263,15 +259,15 @@ void assign_confidence(fusions_t& fusions, const coverage_t& coverage) {
 			if (fusion->second.confidence < CONFIDENCE_HIGH &&
 			    fusion->second.spliced1 && fusion->second.spliced2 && !fusion->second.is_read_through() && fusion->second.gene1 != fusion->second.gene2) {
 				unsigned int number_of_spliced_breakpoints = 0;
-				auto fusions_of_gene = fusions_by_gene.find(fusion->second.gene1);
-				for (auto fusion_of_gene = fusions_of_gene->second.begin(); fusion_of_gene != fusions_of_gene->second.end(); ++fusion_of_gene) {
+				gene_pair_index_t::range_t fusions_of_gene = gene_pair_index.find(fusion->second.gene1);
+				for (gene_pair_index_t::iterator fusion_of_gene = fusions_of_gene.first; fusion_of_gene != fusions_of_gene.second; ++fusion_of_gene) {
 					if ((**fusion_of_gene).gene1 == fusion->second.gene1 && (**fusion_of_gene).gene2 == fusion->second.gene2 &&
 					    (**fusion_of_gene).spliced1 && (**fusion_of_gene).spliced2 &&
 					    (abs((**fusion_of_gene).breakpoint1 - fusion->second.breakpoint1) > 2 || abs((**fusion_of_gene).breakpoint2 - fusion->second.breakpoint2) > 2))
 						++number_of_spliced_breakpoints;
 				}
-				fusions_of_gene = fusions_by_gene.find(fusion->second.gene2);
-				for (auto fusion_of_gene = fusions_of_gene->second.begin(); fusion_of_gene != fusions_of_gene->second.end(); ++fusion_of_gene) {
+				fusions_of_gene = gene_pair_index.find(fusion->second.gene2);
+				for (gene_pair_index_t::iterator fusion_of_gene = fusions_of_gene.first; fusion_of_gene != fusions_of_gene.second; ++fusion_of_gene) {
 					if ((**fusion_of_gene).gene1 == fusion->second.gene1 && (**fusion_of_gene).gene2 == fusion->second.gene2 &&
 					    (**fusion_of_gene).spliced1 && (**fusion_of_gene).spliced2 &&
 					    (abs((**fusion_of_gene).breakpoint1 - fusion->second.breakpoint1) > 2 || abs((**fusion_of_gene).breakpoint2 - fusion->second.breakpoint2) > 2))
@@ -3,13 +3,14 @@
 
 #include <string>
 #include "common.hpp"
+#include "gene_pair_index.hpp"
 #include "read_stats.hpp"
 
 using namespace std;
 
 unsigned int mark_genomic_support(fusions_t& fusions, const string& genomic_breakpoints_file_path, const contigs_t& contigs, const int max_distance);
 
-void assign_confidence(fusions_t& fusions, const coverage_t& coverage);
+void assign_confidence(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const coverage_t& coverage);
 
 unsigned int filter_no_genomic_support(fusions_t& fusions);
 
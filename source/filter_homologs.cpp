@@ -1,16 +1,108 @@
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <list>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "common.hpp"
 #include "annotation.hpp"
 #include "assembly.hpp"
 #include "filter_mismappers.hpp"
 #include "filter_homologs.hpp"
+#include "progress.hpp"
+#include "time_budget.hpp"
+#include "tracepoints.hpp"
 
 using namespace std;
 
-bool is_homolog(const gene_t gene1, const gene_t gene2, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const float max_identity_fraction) {
+// most pairs of genes are obviously not homologous, but the exact test below scans the whole sequence of the smaller gene;
+// a sketch of each gene (FracMinHash) allows estimating the fraction of shared k-mers in time proportional to the sketch size:
+// a sketch holds all k-mers whose hash falls below a threshold, so it samples ~1/SKETCH_SCALE of the k-mers of every gene,
+// which keeps the estimate accurate even when the genes differ vastly in size
+// the k-mers are canonical (the lesser of the k-mer and its reverse complement), which can only overestimate the similarity;
+// the exact test counts matching positions rather than distinct k-mers, so the sketch records how often each k-mer occurs,
+// otherwise repeats, which make up much of the similarity of some genes, would be counted only once
+const char SKETCH_KMER_LENGTH = 16; // same as the k-mers compared by is_homolog() (<kmer_length> + <extended_kmer_length>)
+const kmer_as_int_t SKETCH_SCALE = 16;
+const unsigned int MIN_SKETCH_SIZE = 100; // smaller sketches are too inaccurate => do the exact test
+const float SKETCH_SAFETY_MARGIN = 0.5; // only skip the exact test, if the estimate is below this fraction of max_identity_fraction
+
+typedef vector< pair<kmer_as_int_t,unsigned int> > gene_sketch_t; // sorted hashes of the sampled k-mers and how often they occur in the gene
+typedef unordered_map<gene_t,gene_sketch_t> gene_sketches_t;
+
+// scramble the bits of a k-mer, such that sampling by hash value picks k-mers uniformly
+inline kmer_as_int_t hash_kmer(kmer_as_int_t kmer) {
+	kmer ^= kmer >> 16;
+	kmer *= 0x85ebca6b;
+	kmer ^= kmer >> 13;
+	kmer *= 0xc2b2ae35;
+	kmer ^= kmer >> 16;
+	return kmer;
+}
+
+const gene_sketch_t& get_gene_sketch(const gene_t gene, const assembly_t& assembly, gene_sketches_t& gene_sketches) {
+
+	gene_sketches_t::iterator cached_sketch = gene_sketches.find(gene);
+	if (cached_sketch != gene_sketches.end())
+		return cached_sketch->second;
+
+	gene_sketch_t& sketch = gene_sketches[gene];
+	const string& contig_sequence = assembly.at(gene->contig);
+	const kmer_as_int_t max_hash = ~((kmer_as_int_t) 0) / SKETCH_SCALE;
+	vector<kmer_as_int_t> sampled_hashes;
+	kmer_as_int_t kmer = 0, reverse_complement_kmer = 0;
+	for (position_t position = gene->start; position <= gene->end && position < (int) contig_sequence.size(); ++position) {
+		const kmer_as_int_t base = NUCLEOTIDE_TO_2BIT[(unsigned char) contig_sequence[position]];
+		kmer = (kmer << 2) | base; // the mask is not needed, since 16 bases fill the integer
+		reverse_complement_kmer = (reverse_complement_kmer >> 2) | ((3 - base) << (2 * SKETCH_KMER_LENGTH - 2)); // complement base = 3 - base
+		if (position - gene->start + 1 >= SKETCH_KMER_LENGTH) {
+			const kmer_as_int_t hash = hash_kmer(min(kmer, reverse_complement_kmer));
+			if (hash <= max_hash)
+				sampled_hashes.push_back(hash);
+		}
+	}
+
+	// collapse repeated k-mers into one entry with the number of occurrences
+	sort(sampled_hashes.begin(), sampled_hashes.end());
+	for (vector<kmer_as_int_t>::iterator hash = sampled_hashes.begin(); hash != sampled_hashes.end(); ++hash)
+		if (sketch.empty() || sketch.back().first != *hash)
+			sketch.push_back(make_pair(*hash, 1));
+		else
+			sketch.back().second++;
+	return sketch;
+}
+
+// returns false, if the genes are certainly not similar enough to be homologs
+bool may_be_homolog(const gene_t small_gene, const gene_t big_gene, const assembly_t& assembly, const float max_identity_fraction, gene_sketches_t& gene_sketches) {
+
+	const gene_sketch_t& small_sketch = get_gene_sketch(small_gene, assembly, gene_sketches);
+	if (small_sketch.size() < MIN_SKETCH_SIZE)
+		return true;
+	const gene_sketch_t& big_sketch = get_gene_sketch(big_gene, assembly, gene_sketches);
+
+	// count the sampled positions of the small gene whose k-mer is present in the big gene
+	unsigned int sampled_positions = 0;
+	for (gene_sketch_t::const_iterator small_kmer = small_sketch.begin(); small_kmer != small_sketch.end(); ++small_kmer)
+		sampled_positions += small_kmer->second;
+	unsigned int shared_positions = 0;
+	for (gene_sketch_t::const_iterator small_kmer = small_sketch.begin(), big_kmer = big_sketch.begin(); small_kmer != small_sketch.end() && big_kmer != big_sketch.end();) {
+		if (small_kmer->first < big_kmer->first) {
+			++small_kmer;
+		} else if (big_kmer->first < small_kmer->first) {
+			++big_kmer;
+		} else {
+			shared_positions += small_kmer->second;
+			++small_kmer;
+			++big_kmer;
+		}
+	}
+
+	return shared_positions >= sampled_positions * max_identity_fraction * SKETCH_SAFETY_MARGIN;
+}
+
+bool is_homolog(const gene_t gene1, const gene_t gene2, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const float max_identity_fraction, gene_sketches_t& gene_sketches, const bool prefilter, homolog_comparisons_t& comparisons) {
 
 	// we look for kmers of length <kmer_length> + <extended_kmer_length> that are present in both genes
 	const char extended_kmer_length = 8;
@@ -31,6 +123,13 @@ bool is_homolog(const gene_t gene1, const gene_t gene2, const kmer_indices_t& km
 	     small_gene->end   >= big_gene->start && small_gene->end   <= big_gene->end))
 		return false;
 
+	// skip the exact test, if the sketches show that the genes are not similar
+	if (prefilter && !may_be_homolog(small_gene, big_gene, assembly, max_identity_fraction, gene_sketches)) {
+		comparisons.skipped_by_prefilter++;
+		return false;
+	}
+	comparisons.exact++;
+
 	// retrieve sequence of smaller gene
 	string small_gene_sequence = assembly.at(small_gene->contig).substr(small_gene->start, small_gene->length());
 	if (small_gene->strand != big_gene->strand)
@@ -62,7 +161,11 @@ bool is_homolog(const gene_t gene1, const gene_t gene2, const kmer_indices_t& km
 	return false;
 }
 
-unsigned int filter_homologs(fusions_t& fusions, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const float max_identity_fraction) {
+bool sort_fusions_by_support(const fusion_t* x, const fusion_t* y) {
+	return x->supporting_reads() > y->supporting_reads();
+}
+
+unsigned int filter_homologs(fusions_t& fusions, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const float max_identity_fraction, const unsigned int degraded_max_checked_fusions, stage_watchdog_t& watchdog, const bool prefilter, homolog_comparisons_t* comparisons) {
 
 	// select non-discarded fusions for better speed,
 	// we need to iterate over them many times
@@ -71,13 +174,46 @@ unsigned int filter_homologs(fusions_t& fusions, const kmer_indices_t& kmer_indi
 		if (fusion->second.filter == NULL)
 			remaining_fusions.push_front(&fusion->second);
 
+	// every fusion is compared to all fusions after it => track the progress in terms of comparisons
+	unsigned long long int total_comparisons = remaining_fusions.size() * (remaining_fusions.size() + 1ULL) / 2;
+	unsigned long long int done_comparisons = 0;
+	unsigned long int fusions_after_current = remaining_fusions.size();
+
+	// when we are running out of time, only the fusions with the most supporting reads are checked
+	const string degradation = "checking homology only for the " + to_string(static_cast<long long int>(degraded_max_checked_fusions)) + " fusions with the most supporting reads";
+	unordered_set<fusion_t*> checked_fusions;
+	gene_sketches_t gene_sketches; // computed when a gene is first compared
+	homolog_comparisons_t own_comparisons;
+	if (comparisons == NULL)
+		comparisons = &own_comparisons;
+	progress_reporter_t progress("filter 'homologs'");
+
 	// discard fusion, if gene1 and gene2 are homologs
 	for (auto fusion = remaining_fusions.begin(); fusion != remaining_fusions.end(); ++fusion) {
 
+		if (!watchdog.is_degraded() && watchdog.degrade_if_overdue(done_comparisons, total_comparisons, degradation)) {
+			vector<fusion_t*> fusions_by_support;
+			for (auto unchecked_fusion = fusion; unchecked_fusion != remaining_fusions.end(); ++unchecked_fusion)
+				if ((**unchecked_fusion).filter == NULL)
+					fusions_by_support.push_back(*unchecked_fusion);
+			stable_sort(fusions_by_support.begin(), fusions_by_support.end(), sort_fusions_by_support);
+			if (fusions_by_support.size() > degraded_max_checked_fusions)
+				fusions_by_support.resize(degraded_max_checked_fusions);
+			checked_fusions.insert(fusions_by_support.begin(), fusions_by_support.end());
+		}
+		if (progress.is_due())
+			progress.report(to_string(static_cast<long long unsigned int>(done_comparisons)) + "/" + to_string(static_cast<long long unsigned int>(total_comparisons)) + " pairs of fusions compared");
+		done_comparisons += fusions_after_current--;
+
 		if ((**fusion).filter != NULL)
 			continue;
 
-		if (is_homolog((**fusion).gene1, (**fusion).gene2, kmer_indices, kmer_length, assembly, max_identity_fraction)) {
+		if (watchdog.is_degraded() && checked_fusions.find(*fusion) == checked_fusions.end())
+			continue;
+
+		TRACEPOINT3(homologs__fusion__start, (**fusion).gene1->id, (**fusion).gene2->id, (**fusion).supporting_reads());
+
+		if (is_homolog((**fusion).gene1, (**fusion).gene2, kmer_indices, kmer_length, assembly, max_identity_fraction, gene_sketches, prefilter, *comparisons)) {
 
 			(**fusion).filter = FILTERS.at("homologs");
 
@@ -92,6 +228,9 @@ unsigned int filter_homologs(fusions_t& fusions, const kmer_indices_t& kmer_indi
 				if ((**other_fusion).filter != NULL)
 					continue;
 
+				if (watchdog.is_degraded() && checked_fusions.find(*other_fusion) == checked_fusions.end())
+					continue;
+
 				// check if geneA of fusion == geneA of other fusion
 				// to determine which genes need to be checked for homology (geneB and geneC)
 				gene_t homolog1, homolog2;
@@ -115,7 +254,7 @@ unsigned int filter_homologs(fusions_t& fusions, const kmer_indices_t& kmer_indi
 				unsigned int anchor2 = ((**other_fusion).split_reads1 > 0) + ((**other_fusion).split_reads2 > 0) + ((**other_fusion).discordant_mates > 0);
 
 				// check if the fusion partners geneB and geneC are homologs
-				if (is_homolog(homolog1, homolog2, kmer_indices, kmer_length, assembly, max_identity_fraction)) {
+				if (is_homolog(homolog1, homolog2, kmer_indices, kmer_length, assembly, max_identity_fraction, gene_sketches, prefilter, *comparisons)) {
 
 					// other event must have poorer alignments or fewer reads or a worse e-value for us to consider its supporting reads to be mismappers
 					if (anchor1 > anchor2 ||
@@ -129,6 +268,8 @@ unsigned int filter_homologs(fusions_t& fusions, const kmer_indices_t& kmer_indi
 				}
 			}
 		}
+
+		TRACEPOINT3(homologs__fusion__end, (**fusion).gene1->id, (**fusion).gene2->id, (int) ((**fusion).filter != NULL));
 	}
 
 	// count fusions remaining after filtering
@@ -4,9 +4,19 @@
 #include "common.hpp"
 #include "assembly.hpp"
 #include "filter_mismappers.hpp"
+#include "time_budget.hpp"
 
 using namespace std;
 
-unsigned int filter_homologs(fusions_t& fusions, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const float max_identity_fraction);
+// how many pairs of genes were compared exactly and how many were ruled out by their sketches
+struct homolog_comparisons_t {
+	unsigned long int exact;
+	unsigned long int skipped_by_prefilter;
+	homolog_comparisons_t(): exact(0), skipped_by_prefilter(0) {};
+};
+
+// <prefilter> skips the exact comparison of genes whose sketches show that they are not similar; the result is the same, only faster
+// if <comparisons> is given, the number of exact and skipped comparisons is added to it
+unsigned int filter_homologs(fusions_t& fusions, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const float max_identity_fraction, const unsigned int degraded_max_checked_fusions, stage_watchdog_t& watchdog, const bool prefilter = true, homolog_comparisons_t* comparisons = NULL);
 
 #endif /* _FILTER_HOMOLOGS_H */
@@ -38,6 +38,10 @@ unsigned int filter_long_gap(chimeric_alignments_t& chimeric_alignments) {
 
 		for (mates_t::iterator mate = chimeric_alignment->second.begin(); mate != chimeric_alignment->second.end(); ++mate) {
 
+			// skip the CIGAR string, if it has no gap long enough to be checked
+			if (mate->longest_intron < (unsigned int) min_long_gap && !(mate->longest_intron > 0 && size_of_deletion >= min_long_gap && size_of_deletion <= max_long_gap))
+				continue;
+
 			// look for long gap
 			for (unsigned int i = 1; i < mate->cigar.size()-1; ++i) {
 				if (mate->cigar.operation(i) == BAM_CREF_SKIP && ((int) mate->cigar.op_length(i) >= min_long_gap || size_of_deletion >= min_long_gap && size_of_deletion <= max_long_gap)) {
@@ -3,6 +3,7 @@
 #include "common.hpp"
 #include "filter_low_entropy.hpp"
 #include "filter_mismappers.hpp"
+#include "nucleotides.hpp"
 
 using namespace std;
 
@@ -57,9 +58,10 @@ unsigned int filter_low_entropy(chimeric_alignments_t& chimeric_alignments, cons
 				vector<string::size_type> previous_kmer_pos(kmer_count.size());
 
 				// count all different k-mers for each read
-				for (string::size_type kmer_pos = 0; kmer_pos < chimeric_alignment->second[mate].sequence.length() - kmer_length; kmer_pos++) {
-
-					kmer_as_int_t kmer_as_int = kmer_to_int(chimeric_alignment->second[mate].sequence, kmer_pos, kmer_length);
+				const string& sequence = chimeric_alignment->second[mate].sequence;
+				const kmer_as_int_t mask = kmer_mask(kmer_length);
+				kmer_as_int_t kmer_as_int = kmer_to_int(sequence, 0, kmer_length);
+				for (string::size_type kmer_pos = 0; kmer_pos < sequence.length() - kmer_length; kmer_as_int = roll_kmer(kmer_as_int, sequence[kmer_pos + kmer_length], mask), kmer_pos++) {
 
 					// only count the k-mer if it does not overlap with a k-mer with identical sequence
 					if (previous_kmer_pos[kmer_as_int] <= kmer_pos) {
@@ -1,4 +1,6 @@
+#include <climits>
 #include <cmath>
+#include <iostream>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -6,11 +8,14 @@
 #include "common.hpp"
 #include "annotation.hpp"
 #include "assembly.hpp"
+#include "nucleotides.hpp"
+#include "progress.hpp"
 #include "filter_mismappers.hpp"
+#include "time_budget.hpp"
+#include "tracepoints.hpp"
 
 using namespace std;
 
-typedef set<position_t> splice_sites_t;
 typedef unordered_map<gene_t,splice_sites_t> splice_sites_by_gene_t;
 
 void get_downstream_splice_sites(const gene_t gene, const exon_annotation_index_t& exon_annotation_index, splice_sites_t& splice_sites) {
@@ -30,20 +35,6 @@ void get_downstream_splice_sites(const gene_t gene, const exon_annotation_index_
 	}
 }
 
-kmer_as_int_t kmer_to_int(const string& kmer, const string::size_type position, const char kmer_length) {
-	kmer_as_int_t result = 0;
-	for (char base = 0; base < kmer_length; ++base) {
-		result = result<<2;
-		switch (kmer.c_str()[position + base]) {
-			case 'T': result += 0; break;
-			case 'G': result += 1; break;
-			case 'C': result += 2; break;
-			default:  result += 3; break;
-		}
-	}
-	return result;
-}
-
 void make_kmer_index(const fusions_t& fusions, const assembly_t& assembly, const char kmer_length, kmer_indices_t& kmer_indices) {
 
 	// find genes which are involved in fusions which have not been discarded yet
@@ -58,13 +49,16 @@ void make_kmer_index(const fusions_t& fusions, const assembly_t& assembly, const
 	}
 
 	// store positions of kmers in hash
+	TRACEPOINT1(kmer__index__start, (unsigned long int) genes_to_filter.size());
 	for (gene_set_t::iterator gene = genes_to_filter.begin(); gene != genes_to_filter.end(); ++gene) {
 		const string& contig_sequence = assembly.at((**gene).contig);
 		if ((int) kmer_indices.size() <= (**gene).contig)
 			kmer_indices.resize((**gene).contig+1);
-		for (position_t pos = (**gene).start; pos + kmer_length < (**gene).end; pos++)
+		const kmer_as_int_t mask = kmer_mask(kmer_length);
+		kmer_as_int_t kmer = kmer_to_int(contig_sequence, (**gene).start, kmer_length);
+		for (position_t pos = (**gene).start; pos + kmer_length < (**gene).end; kmer = roll_kmer(kmer, contig_sequence[pos + kmer_length], mask), pos++)
 			if (contig_sequence[pos] != 'N') // don't index masked regions, as long stretches of N's inflate the number of hits
-				kmer_indices[(**gene).contig][kmer_to_int(contig_sequence, pos, kmer_length)].push_back(pos);
+				kmer_indices[(**gene).contig][kmer].push_back(pos);
 	}
 
 	// sort kmer hits by increasing position, so that we can go through the list sequentially
@@ -75,9 +69,10 @@ void make_kmer_index(const fusions_t& fusions, const assembly_t& assembly, const
 			auto last = unique(kmer_hits->second.begin(), kmer_hits->second.end());
 			kmer_hits->second.erase(last, kmer_hits->second.end());
 		}
+	TRACEPOINT1(kmer__index__end, (unsigned long int) kmer_indices.size());
 }
 
-bool align(int score, const string& read_sequence, int read_pos, const string& contig_sequence, const int gene_pos, const position_t gene_start, const position_t gene_end, const kmer_index_t& kmer_index, const char kmer_length, const splice_sites_t& splice_sites, const int min_score, int max_deletions) {
+bool align(int score, const string& read_sequence, int read_pos, const string& contig_sequence, const int gene_pos, const position_t gene_start, const position_t gene_end, const kmer_index_t& kmer_index, const char kmer_length, const splice_sites_t& splice_sites, const int min_score, int max_deletions, realignment_budget_t& budget) {
 
 	int skipped_bases = 0;
 
@@ -93,6 +88,10 @@ bool align(int score, const string& read_sequence, int read_pos, const string& c
 
 		for (auto kmer_hit = lower_bound(kmer_hits->second.begin(), kmer_hits->second.end(), gene_pos); kmer_hit != kmer_hits->second.end() && *kmer_hit < gene_end; ++kmer_hit) {
 
+			if (budget.exhausted())
+				return false;
+			budget.spend();
+
 			int extended_score = score + kmer_length;
 			if (read_pos == skipped_bases) // so far, all bases at the beginning of the read have been skipped
 				extended_score += skipped_bases; // this effectively removes any penalties on leading mismatches (as in local alignment)
@@ -106,6 +105,7 @@ bool align(int score, const string& read_sequence, int read_pos, const string& c
 				unsigned int mismatch_count = 0;
 				while (extended_read_pos >= read_pos - skipped_bases && // only align yet unaligned bases
 				       extended_gene_pos >= gene_start) {
+					budget.spend();
 
 					if (read_sequence[extended_read_pos] == contig_sequence[extended_gene_pos]) {
 
@@ -138,13 +138,14 @@ bool align(int score, const string& read_sequence, int read_pos, const string& c
 				unsigned int consecutive_mismatches = 0;
 				splice_sites_t::const_iterator next_splice_site = splice_sites.lower_bound(extended_gene_pos - 1);
 				while (extended_read_pos < (int) read_sequence.length() && extended_gene_pos <= gene_end) {
+					budget.spend();
 
 					// try a spliced alignment, if we run over a splice-site
 					if (next_splice_site != splice_sites.end()) {
 						if (extended_gene_pos - 1 > *next_splice_site)
 							++next_splice_site;
 						if (next_splice_site != splice_sites.end() && extended_gene_pos - 1 == *next_splice_site)
-							if (align(extended_score, read_sequence, extended_read_pos, contig_sequence, extended_gene_pos, gene_start, gene_end, kmer_index, kmer_length, splice_sites, min_score, max_deletions))
+							if (align(extended_score, read_sequence, extended_read_pos, contig_sequence, extended_gene_pos, gene_start, gene_end, kmer_index, kmer_length, splice_sites, min_score, max_deletions, budget))
 								return true;
 					}
 
@@ -161,7 +162,7 @@ bool align(int score, const string& read_sequence, int read_pos, const string& c
 						mismatch_count++;
 						if (mismatch_count == 1) // when there is more than one mismatch, do another k-mer lookup
 							if (max_deletions > 0 && read_sequence.length() >= 30 && // do not allow too many deletions/introns and only if the read is reasonably long
-							    align(extended_score, read_sequence, extended_read_pos, contig_sequence, extended_gene_pos, gene_start, gene_end, kmer_index, kmer_length, splice_sites, min_score, max_deletions-1))
+							    align(extended_score, read_sequence, extended_read_pos, contig_sequence, extended_gene_pos, gene_start, gene_end, kmer_index, kmer_length, splice_sites, min_score, max_deletions-1, budget))
 								return true;
 						extended_score--; // penalize mismatch
 						consecutive_mismatches++;
@@ -180,9 +181,10 @@ bool align(int score, const string& read_sequence, int read_pos, const string& c
 	return false;
 }
 
-bool align_both_strands(const string& read_sequence, const int read_length, const int max_mate_gap, const bool breakpoints_on_same_contig, const position_t alignment_start, const position_t alignment_end, const kmer_indices_t& kmer_indices, const assembly_t& assembly, const exon_annotation_index_t& exon_annotation_index, splice_sites_by_gene_t& splice_sites_by_gene, gene_set_t& genes, const char kmer_length, const float min_align_percent, int min_score) {
+bool align_both_strands(const string& read_sequence, const int read_length, const int max_mate_gap, const bool breakpoints_on_same_contig, const position_t alignment_start, const position_t alignment_end, const kmer_indices_t& kmer_indices, const assembly_t& assembly, const exon_annotation_index_t& exon_annotation_index, splice_sites_by_gene_t& splice_sites_by_gene, gene_set_t& genes, const char kmer_length, const float min_align_percent, int min_score, realignment_budget_t& budget) {
 	min_score = min(min_score, (int) (min_align_percent * read_sequence.size() + 0.5));
-	for (gene_set_t::iterator gene = genes.begin(); gene != genes.end(); ++gene) {
+	string reverse_complement; // computed when it is first needed and reused for all genes
+	for (gene_set_t::iterator gene = genes.begin(); gene != genes.end() && !budget.exhausted(); ++gene) {
 
 		// find all splice sites in the genes
 		if (splice_sites_by_gene.find(*gene) == splice_sites_by_gene.end())
@@ -200,13 +202,12 @@ bool align_both_strands(const string& read_sequence, const int read_length, cons
 		     alignment_end   >= gene_start && alignment_end   <= gene_end))
 			continue;
 
-		if (align(0, read_sequence, 0, assembly.at((**gene).contig), gene_start, gene_start, gene_end, kmer_indices[(**gene).contig], kmer_length, splice_sites_by_gene.at(*gene), min_score, 1)) { // align on forward strand
+		if (align(0, read_sequence, 0, assembly.at((**gene).contig), gene_start, gene_start, gene_end, kmer_indices[(**gene).contig], kmer_length, splice_sites_by_gene.at(*gene), min_score, 1, budget)) { // align on forward strand
 			return true;
 		} else { // align on reverse strand
-			string reverse_complement;
-			string original = read_sequence;
-			dna_to_reverse_complement(original, reverse_complement);
-			if (align(0, reverse_complement, 0, assembly.at((**gene).contig), gene_start, gene_start, gene_end, kmer_indices[(**gene).contig], kmer_length, splice_sites_by_gene.at(*gene), min_score, 1))
+			if (reverse_complement.empty())
+				dna_to_reverse_complement(read_sequence, reverse_complement);
+			if (align(0, reverse_complement, 0, assembly.at((**gene).contig), gene_start, gene_start, gene_end, kmer_indices[(**gene).contig], kmer_length, splice_sites_by_gene.at(*gene), min_score, 1, budget))
 				return true;
 		}
 	}
@@ -226,39 +227,63 @@ void count_mismappers(vector<chimeric_alignments_t::iterator>& chimeric_alignmen
 	}
 }
 
+unsigned int count_unfiltered_reads(const vector<chimeric_alignments_t::iterator>& chimeric_alignments_list) {
+	unsigned int unfiltered_reads = 0;
+	for (auto chimeric_alignment = chimeric_alignments_list.begin(); chimeric_alignment != chimeric_alignments_list.end(); ++chimeric_alignment)
+		if ((**chimeric_alignment).second.filter == NULL)
+			unfiltered_reads++;
+	return unfiltered_reads;
+}
+
+// selects <sample_size> of <population> items at evenly spaced indices
+inline bool is_in_sample(const unsigned int index, const unsigned int sample_size, const unsigned int population) {
+	return (unsigned long long int) index * sample_size % population < sample_size;
+}
+
 // extend split read and compare against reference to check if STAR clipped prematurely (mostly due to accumulation of SNPs)
 bool extend_split_read(const alignment_t& split_read, const assembly_t& assembly, const float min_align_percent) {
 
 	// get clipped segment and the reference sequence at the position of the clipped segment
-	string clipped_sequence;
-	string reference_sequence;
+	const string& contig_sequence = assembly.at(split_read.contig);
+	const char* clipped_sequence;
+	const char* reference_sequence;
 	int clipped_count;
 	if (split_read.strand == FORWARD) {
 		clipped_count = min((int) split_read.preclipping(), split_read.start); // don't run over contig boundary
-		clipped_sequence = split_read.sequence.substr(split_read.preclipping() - clipped_count, clipped_count);
-		reference_sequence = assembly.at(split_read.contig).substr(split_read.start - clipped_count, clipped_count);
+		clipped_sequence = split_read.sequence.c_str() + split_read.preclipping() - clipped_count;
+		reference_sequence = contig_sequence.c_str() + split_read.start - clipped_count;
 	} else {
-		clipped_count = min((int) split_read.postclipping(), (int) assembly.at(split_read.contig).size() - split_read.end); // don't run over contig boundary
-		clipped_sequence = split_read.sequence.substr(split_read.sequence.size() - split_read.postclipping(), clipped_count);
-		reference_sequence = assembly.at(split_read.contig).substr(split_read.end, clipped_count);
+		clipped_count = min((int) split_read.postclipping(), (int) contig_sequence.size() - split_read.end); // don't run over contig boundary
+		clipped_sequence = split_read.sequence.c_str() + split_read.sequence.size() - split_read.postclipping();
+		reference_sequence = contig_sequence.c_str() + split_read.end;
 	}
 
 	// count number of matching bases between clipped segment and reference
-	unsigned int matching_bases = 0;
-	for (unsigned int i = 0; i < clipped_sequence.size(); ++i)
-		if (clipped_sequence[i] == reference_sequence[i])
-			++matching_bases;
+	unsigned int matching_bases = count_matching_bases(clipped_sequence, reference_sequence, clipped_count);
 
-	return matching_bases >= floor(clipped_sequence.size() * min_align_percent);
+	return matching_bases >= floor(clipped_count * min_align_percent);
 }
 
-unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const exon_annotation_index_t& exon_annotation_index, const float max_mismapper_fraction, const int max_mate_gap) {
+unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const exon_annotation_index_t& exon_annotation_index, const float max_mismapper_fraction, const int max_mate_gap, const unsigned int degraded_max_realigned_reads, stage_watchdog_t& watchdog) {
 
 	const float min_align_percent = 0.8; // allow ~1 mismatch for every 10 matches
 	const int min_score = 40; // consider this score or higher a match (even if less than min_align_percent match)
 
 	splice_sites_by_gene_t splice_sites_by_gene;
 
+	// count the reads which need to be re-aligned to track the progress
+	unsigned long int reads_to_realign = 0;
+	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion)
+		if (fusion->second.gene1 != fusion->second.gene2 && fusion->second.filter == NULL)
+			reads_to_realign += fusion->second.split_read1_list.size() + fusion->second.split_read2_list.size() + fusion->second.discordant_mate_list.size();
+	unsigned long int processed_reads = 0;
+	const string degradation = "re-aligning at most " + to_string(static_cast<long long int>(degraded_max_realigned_reads)) + " reads per fusion";
+	unordered_map<fusion_t*,unsigned int> sampled_reads_by_fusion; // number of reads which were re-aligned of fusions which were subsampled
+	unsigned long int sampled_reads = 0, candidate_reads_of_sampled_fusions = 0;
+	progress_reporter_t progress("filter 'mismappers'");
+	unsigned long int reads_exceeding_budget = 0; // reads whose re-alignment was aborted, because it took too much work
+	unordered_map<fusion_t*,unsigned int> undecided_reads_by_fusion; // reads which could not be classified, because their re-alignment was aborted
+
 	// align discordnat mate / clipped segment in gene of origin
 	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
 
@@ -268,10 +293,31 @@ unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_in
 		if (fusion->second.filter != NULL)
 			continue;
 
+		if (progress.is_due())
+			progress.report(to_string(static_cast<long long unsigned int>(processed_reads)) + "/" + to_string(static_cast<long long unsigned int>(reads_to_realign)) + " reads re-aligned, " + to_string(static_cast<long long unsigned int>(reads_exceeding_budget)) + " exceeded work limit");
+
+		// when we are running out of time, only re-align a sample of the reads of each fusion
+		unsigned int max_realigned_reads = (watchdog.degrade_if_overdue(processed_reads, reads_to_realign, degradation)) ? degraded_max_realigned_reads : UINT_MAX;
+		unsigned int realigned_reads = 0;
+		unsigned int candidate_reads = 0; // reads which have not been filtered yet
+		processed_reads += fusion->second.split_read1_list.size() + fusion->second.split_read2_list.size() + fusion->second.discordant_mate_list.size();
+
 		//TODO hotfix to prevent MTAP:CDKN2B-AS1 from being removed
 		if (fusion->second.gene1->name == "MTAP" && fusion->second.gene2->name == "CDKN2B-AS1")
 			continue;
 
+		TRACEPOINT3(mismappers__fusion__start, fusion->second.gene1->id, fusion->second.gene2->id, fusion->second.supporting_reads());
+
+		// when only a sample of the reads is re-aligned, it is drawn evenly across the reads of the fusion,
+		// such that the fraction of mismappers does not depend on the order of the reads
+		unsigned int population = count_unfiltered_reads(fusion->second.split_read1_list) + count_unfiltered_reads(fusion->second.split_read2_list) + count_unfiltered_reads(fusion->second.discordant_mate_list);
+		unsigned int sample_size = min(population, max_realigned_reads);
+		if (sample_size < population) {
+			sampled_reads_by_fusion[&fusion->second] = sample_size;
+			sampled_reads += sample_size;
+			candidate_reads_of_sampled_fusions += population;
+		}
+
 		// re-align split reads
 		vector<chimeric_alignments_t::iterator> all_split_reads;
 		all_split_reads.insert(all_split_reads.end(), fusion->second.split_read1_list.begin(), fusion->second.split_read1_list.end());
@@ -281,24 +327,33 @@ unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_in
 			if ((**chimeric_alignment).second.filter != NULL)
 				continue; // read has already been filtered
 
+			if (!is_in_sample(candidate_reads++, sample_size, population))
+				continue;
+			realigned_reads++;
+
 			// introduce aliases for cleaner code
 			alignment_t& split_read = (**chimeric_alignment).second[SPLIT_READ];
 			alignment_t& supplementary = (**chimeric_alignment).second[SUPPLEMENTARY];
 			alignment_t& mate1 = (**chimeric_alignment).second[MATE1];
 
+			realignment_budget_t budget;
 			if (split_read.strand == FORWARD) {
 				if (extend_split_read(split_read, assembly, min_align_percent) ||
-				    align_both_strands(split_read.sequence.substr(0, split_read.preclipping()), split_read.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, supplementary.start, supplementary.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, split_read.genes, kmer_length, min_align_percent, min_score) || // clipped segment aligns to donor
-				    align_both_strands(mate1.sequence.substr(mate1.preclipping()), mate1.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate1.start, mate1.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, supplementary.genes, kmer_length, min_align_percent, min_score)) { // non-spliced mate aligns to acceptor
+				    align_both_strands(split_read.sequence.substr(0, split_read.preclipping()), split_read.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, supplementary.start, supplementary.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, split_read.genes, kmer_length, min_align_percent, min_score, budget) || // clipped segment aligns to donor
+				    align_both_strands(mate1.sequence.substr(mate1.preclipping()), mate1.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate1.start, mate1.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, supplementary.genes, kmer_length, min_align_percent, min_score, budget)) { // non-spliced mate aligns to acceptor
 					(**chimeric_alignment).second.filter = FILTERS.at("mismappers");
 				}
 			} else { // split_read.strand == REVERSE
 				if (extend_split_read(split_read, assembly, min_align_percent) ||
-				    align_both_strands(split_read.sequence.substr(split_read.sequence.length() - split_read.postclipping()), split_read.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, supplementary.start, supplementary.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, split_read.genes, kmer_length, min_align_percent, min_score) || // clipped segment aligns to donor
-				    align_both_strands(mate1.sequence.substr(0, mate1.sequence.length() - mate1.postclipping()), mate1.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate1.start, mate1.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, supplementary.genes, kmer_length, min_align_percent, min_score)) { // non-spliced mate aligns to acceptor
+				    align_both_strands(split_read.sequence.substr(split_read.sequence.length() - split_read.postclipping()), split_read.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, supplementary.start, supplementary.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, split_read.genes, kmer_length, min_align_percent, min_score, budget) || // clipped segment aligns to donor
+				    align_both_strands(mate1.sequence.substr(0, mate1.sequence.length() - mate1.postclipping()), mate1.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate1.start, mate1.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, supplementary.genes, kmer_length, min_align_percent, min_score, budget)) { // non-spliced mate aligns to acceptor
 					(**chimeric_alignment).second.filter = FILTERS.at("mismappers");
 				}
 			}
+			if (budget.exhausted() && (**chimeric_alignment).second.filter == NULL) {
+				reads_exceeding_budget++;
+				undecided_reads_by_fusion[&fusion->second]++;
+			}
 		}
 
 		// re-align discordant mates
@@ -306,21 +361,37 @@ unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_in
 			if ((**chimeric_alignment).second.filter != NULL)
 				continue; // read has already been filtered
 
+			if (!is_in_sample(candidate_reads++, sample_size, population))
+				continue;
+			realigned_reads++;
+
 			if ((**chimeric_alignment).second.size() == 2) { // discordant mates
 
 				// introduce aliases for cleaner code
 				alignment_t& mate1 = (**chimeric_alignment).second[MATE1];
 				alignment_t& mate2 = (**chimeric_alignment).second[MATE2];
 
-				if (align_both_strands(mate1.sequence, mate1.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate1.start, mate1.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, mate2.genes, kmer_length, min_align_percent, min_score) ||
-				    align_both_strands(mate2.sequence, mate2.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate2.start, mate2.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, mate1.genes, kmer_length, min_align_percent, min_score)) {
+				realignment_budget_t budget;
+				if (align_both_strands(mate1.sequence, mate1.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate1.start, mate1.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, mate2.genes, kmer_length, min_align_percent, min_score, budget) ||
+				    align_both_strands(mate2.sequence, mate2.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate2.start, mate2.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, mate1.genes, kmer_length, min_align_percent, min_score, budget)) {
 					(**chimeric_alignment).second.filter = FILTERS.at("mismappers");
 				}
+				if (budget.exhausted() && (**chimeric_alignment).second.filter == NULL) {
+					reads_exceeding_budget++;
+					undecided_reads_by_fusion[&fusion->second]++;
+				}
 			}
 		}
 
+		TRACEPOINT3(mismappers__fusion__end, fusion->second.gene1->id, fusion->second.gene2->id, realigned_reads);
 	}
 
+	if (watchdog.is_degraded())
+		watchdog.amend_degradation(to_string(static_cast<long long unsigned int>(sampled_reads)) + " of " + to_string(static_cast<long long unsigned int>(candidate_reads_of_sampled_fusions)) + " reads of " + to_string(static_cast<long long unsigned int>(sampled_reads_by_fusion.size())) + " fusions were re-aligned");
+
+	if (reads_exceeding_budget > 0)
+		watchdog.add_degradation("leaving " + to_string(static_cast<long long unsigned int>(reads_exceeding_budget)) + " reads of " + to_string(static_cast<long long unsigned int>(undecided_reads_by_fusion.size())) + " fusions out of the fraction of mis-mappers", "too many candidate alignments to re-align reads");
+
 	// discard all fusions with more than XX% mismappers
 	unsigned int remaining = 0;
 	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
@@ -334,6 +405,19 @@ unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_in
 		count_mismappers(fusion->second.split_read2_list, mismappers, total_reads, fusion->second.split_reads2);
 		count_mismappers(fusion->second.discordant_mate_list, mismappers, total_reads, fusion->second.discordant_mates);
 
+		// reads whose re-alignment was aborted are neither mismappers nor properly aligned, so they are left out of the fraction
+		unsigned int undecided_reads = 0;
+		unordered_map<fusion_t*,unsigned int>::iterator undecided = undecided_reads_by_fusion.find(&fusion->second);
+		if (undecided != undecided_reads_by_fusion.end())
+			undecided_reads = undecided->second;
+
+		// if only a sample of the reads was re-aligned, the fraction of mismappers is estimated from the sample
+		unordered_map<fusion_t*,unsigned int>::iterator sample = sampled_reads_by_fusion.find(&fusion->second);
+		if (sample != sampled_reads_by_fusion.end())
+			total_reads = min(total_reads, (short unsigned int) max((unsigned int) mismappers, sample->second - undecided_reads));
+		else
+			total_reads -= min((unsigned int) (total_reads - mismappers), undecided_reads);
+
 		// remove fusions with mostly mismappers
 		if (mismappers > 0 && mismappers >= floor(max_mismapper_fraction * total_reads))
 			fusion->second.filter = FILTERS.at("mismappers");
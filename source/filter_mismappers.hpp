@@ -1,22 +1,42 @@
 #ifndef _FILTER_MISMAPPER_H
 #define _FILTER_MISMAPPER_H 1
 
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "common.hpp"
 #include "annotation.hpp"
 #include "assembly.hpp"
+#include "nucleotides.hpp"
+#include "time_budget.hpp"
 
 using namespace std;
 
-typedef unsigned int kmer_as_int_t; // represent kmer as integer
 typedef unordered_map< kmer_as_int_t, vector<int> > kmer_index_t; // store coordinates of kmers
 typedef vector<kmer_index_t> kmer_indices_t; // one index per contig
+typedef set<position_t> splice_sites_t;
+
+// in repetitive genes, a read can have thousands of k-mer hits, each of which is extended and may spawn
+// spliced or gapped sub-alignments; to keep single reads from dominating the runtime, the number of
+// k-mer hits and extension steps per read is limited; when the budget is used up, the read is left out of the fraction of mismappers
+const unsigned long int MAX_REALIGNMENT_WORK_PER_READ = 1000000;
+
+class realignment_budget_t {
+	private:
+		unsigned long int remaining;
+	public:
+		realignment_budget_t(const unsigned long int max_work = MAX_REALIGNMENT_WORK_PER_READ): remaining(max_work) {};
+		bool exhausted() const { return remaining == 0; };
+		void spend() { if (remaining > 0) remaining--; };
+};
+
+// returns true, if the read can be aligned to the given region with at least <min_score>;
+// returns false, if it cannot or if the budget runs out before an alignment is found
+bool align(int score, const string& read_sequence, int read_pos, const string& contig_sequence, const int gene_pos, const position_t gene_start, const position_t gene_end, const kmer_index_t& kmer_index, const char kmer_length, const splice_sites_t& splice_sites, const int min_score, int max_deletions, realignment_budget_t& budget);
 
-kmer_as_int_t kmer_to_int(const string& kmer, const string::size_type position, const char kmer_length);
 void make_kmer_index(const fusions_t& fusions, const assembly_t& assembly, const char kmer_length, kmer_indices_t& kmer_indices);
 
-unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const exon_annotation_index_t& exon_annotation_index, const float max_mismapper_fraction, const int max_mate_gap);
+unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_indices, const char kmer_length, const assembly_t& assembly, const exon_annotation_index_t& exon_annotation_index, const float max_mismapper_fraction, const int max_mate_gap, const unsigned int degraded_max_realigned_reads, stage_watchdog_t& watchdog);
 
 #endif /* _FILTER_MISMAPPERS_H */
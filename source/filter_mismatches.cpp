@@ -4,6 +4,7 @@
 #include "annotation.hpp"
 #include "assembly.hpp"
 #include "common.hpp"
+#include "nucleotides.hpp"
 #include "filter_mismatches.hpp"
 
 using namespace std;
@@ -37,15 +38,9 @@ void count_mismatches(const alignment_t& alignment, const string& sequence, cons
 			case BAM_CMATCH:
 			case BAM_CEQUAL:
 			case BAM_CDIFF:
-				for (unsigned int operation_i = 1; operation_i <= alignment.cigar.op_length(i); ++operation_i) {
-					if (sequence[read_position] != 'N') {
-						if (sequence[read_position] != assembly.at(alignment.contig)[reference_position])
-							mismatches++;
-						alignment_length++;
-					}
-					reference_position++;
-					read_position++;
-				}
+				mismatches += count_mismatching_bases(sequence.c_str() + read_position, assembly.at(alignment.contig).c_str() + reference_position, alignment.cigar.op_length(i), alignment_length);
+				reference_position += alignment.cigar.op_length(i);
+				read_position += alignment.cigar.op_length(i);
 				break;
 		}
 	}
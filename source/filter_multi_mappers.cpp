@@ -14,24 +14,19 @@ unsigned int filter_multi_mappers(chimeric_alignments_t& chimeric_alignments) {
 
 				// use the alignment with the shorter anchor as the SUPPLEMENTARY and the longer one as the SPLIT_READ
 				// and copy the split read in the MATE1 place (to simulate paired-end data)
-				if (chimeric_alignment->second[MATE1].end - chimeric_alignment->second[MATE1].start > chimeric_alignment->second[MATE2].end - chimeric_alignment->second[MATE2].start) {
-					chimeric_alignment->second.push_back(chimeric_alignment->second[MATE2]);
-					chimeric_alignment->second[MATE2] = chimeric_alignment->second[MATE1];
-				} else {
-					chimeric_alignment->second.push_back(chimeric_alignment->second[MATE1]);
-					chimeric_alignment->second[MATE1] = chimeric_alignment->second[MATE2];
-				}
+				// the alignments are moved rather than copied where possible, the vector is reserved to avoid reallocation
+				chimeric_alignment->second.reserve(3);
+				if (chimeric_alignment->second[MATE1].end - chimeric_alignment->second[MATE1].start > chimeric_alignment->second[MATE2].end - chimeric_alignment->second[MATE2].start)
+					swap(chimeric_alignment->second[MATE1], chimeric_alignment->second[MATE2]);
+				chimeric_alignment->second.push_back(move(chimeric_alignment->second[MATE1]));
+				chimeric_alignment->second[MATE1] = chimeric_alignment->second[MATE2];
 
 				// MATE1 and SPLIT_READ must have the sequence, SUPPLEMENTARY must not
-				if (!chimeric_alignment->second[MATE1].supplementary) {
-					chimeric_alignment->second[SPLIT_READ].sequence = chimeric_alignment->second[MATE1].sequence;
-				} else if (!chimeric_alignment->second[SPLIT_READ].supplementary) {
-					chimeric_alignment->second[MATE1].sequence = chimeric_alignment->second[SPLIT_READ].sequence;
-				} else { // !chimeric_alignment->second[SUPPLEMENTARY].supplementary
+				if (chimeric_alignment->second[MATE1].supplementary) { // else the sequence has been copied along with the split read
 					chimeric_alignment->second[MATE1].sequence = chimeric_alignment->second[SUPPLEMENTARY].sequence;
-					chimeric_alignment->second[SPLIT_READ].sequence = chimeric_alignment->second[SUPPLEMENTARY].sequence;
+					chimeric_alignment->second[SPLIT_READ].sequence = move(chimeric_alignment->second[SUPPLEMENTARY].sequence);
 				}
-				chimeric_alignment->second[SUPPLEMENTARY].sequence.clear();
+				string().swap(chimeric_alignment->second[SUPPLEMENTARY].sequence); // release the memory, too
 
 				// set supplementary flag like it would be set if we had paired-end data
 				chimeric_alignment->second[SUPPLEMENTARY].supplementary = true;
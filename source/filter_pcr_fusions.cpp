@@ -5,6 +5,7 @@
 #include "sam.h"
 #include "common.hpp"
 #include "annotation.hpp"
+#include "gene_pair_index.hpp"
 #include "filter_pcr_fusions.hpp"
 
 using namespace std;
@@ -30,6 +31,18 @@ gene_t find_higher_expressed_gene(const contig_t contig, const position_t breakp
 	return highest_expressed_gene;
 }
 
+// look up the number of exonic breakpoints between two genes regardless of which gene is upstream
+unsigned int count_exonic_breakpoints(const gene_t gene1, const gene_t gene2, const gene_pair_index_t& gene_pair_index, const vector<unsigned int>& exonic_breakpoints_by_gene_pair) {
+	unsigned int exonic_breakpoints = 0;
+	gene_pair_index_t::range_t fusions_of_gene_pair = gene_pair_index.find(gene1, gene2);
+	if (fusions_of_gene_pair.first != fusions_of_gene_pair.second)
+		exonic_breakpoints += exonic_breakpoints_by_gene_pair[fusions_of_gene_pair.first - gene_pair_index.begin()];
+	fusions_of_gene_pair = gene_pair_index.find(gene2, gene1);
+	if (fusions_of_gene_pair.first != fusions_of_gene_pair.second)
+		exonic_breakpoints += exonic_breakpoints_by_gene_pair[fusions_of_gene_pair.first - gene_pair_index.begin()];
+	return exonic_breakpoints;
+}
+
 // make helper class to sort genes by the number of chimeric reads
 struct sort_genes_by_reads_t {
 	unordered_map<gene_t,unsigned int>* read_count;
@@ -44,7 +57,7 @@ struct sort_genes_by_reads_t {
 	}
 };
 
-unsigned int filter_pcr_fusions(fusions_t& fusions, const chimeric_alignments_t& chimeric_alignments, const float high_expression_quantile, const gene_annotation_index_t& gene_annotation_index) {
+unsigned int filter_pcr_fusions(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const chimeric_alignments_t& chimeric_alignments, const float high_expression_quantile, const gene_annotation_index_t& gene_annotation_index) {
 
 	// older version of STAR occasionally clipped discordant mates for no good reason,
 	// which appeared as though the mate overlaps a breakpoint
@@ -56,17 +69,21 @@ unsigned int filter_pcr_fusions(fusions_t& fusions, const chimeric_alignments_t&
 	const unsigned int max_exonic_breakpoints_by_gene_pair = 8;
 
 	// count the number of breakpoints within exons for each gene pair
-	unordered_map< tuple<gene_t/*gene1*/,gene_t/*gene2*/>, unsigned int > exonic_breakpoints_by_gene_pair;
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
-		if (fusion->second.gene1 != fusion->second.gene2 && // it is perfectly normal to have many breakpoints within the same gene (hairpin fusions)
-		    !fusion->second.spliced1 && !fusion->second.spliced2 && // breakpoints at splice sites are almost exclusively a result of splicing and thus, no PCR/RT-mediated fusions
-		    fusion->second.exonic1 && fusion->second.exonic2 && // PCR/RT fusions only contain spliced transcripts, so we ignore intronic/intergenic breakpoints
-		    fusion->second.split_read1_list.size() + fusion->second.split_read2_list.size() > 0 && // require a split read for exact location of the breakpoint
-		    fusion->second.filter != FILTERS.at("merge_adjacent") && // slightly varying alignments may lead to adjacent breakpoints, we should not count them as separate breakpoints
-		    fusion->second.filter != FILTERS.at("uninteresting_contigs")) { // skip uninteresting contigs to save some runtime/memory
-			exonic_breakpoints_by_gene_pair[make_tuple(fusion->second.gene1, fusion->second.gene2)]++;
-			exonic_breakpoints_by_gene_pair[make_tuple(fusion->second.gene2, fusion->second.gene1)]++;
+	// the count of a gene pair is stored at the position of the first fusion of the gene pair in the index
+	vector<unsigned int> exonic_breakpoints_by_gene_pair(gene_pair_index.size());
+	for (gene_pair_index_t::iterator group_start = gene_pair_index.begin(); group_start != gene_pair_index.end();) {
+		gene_pair_index_t::range_t fusions_of_gene_pair = gene_pair_index.group_of(group_start, false);
+		for (gene_pair_index_t::iterator fusion = fusions_of_gene_pair.first; fusion != fusions_of_gene_pair.second; ++fusion) {
+			if ((**fusion).gene1 != (**fusion).gene2 && // it is perfectly normal to have many breakpoints within the same gene (hairpin fusions)
+			    !(**fusion).spliced1 && !(**fusion).spliced2 && // breakpoints at splice sites are almost exclusively a result of splicing and thus, no PCR/RT-mediated fusions
+			    (**fusion).exonic1 && (**fusion).exonic2 && // PCR/RT fusions only contain spliced transcripts, so we ignore intronic/intergenic breakpoints
+			    (**fusion).split_read1_list.size() + (**fusion).split_read2_list.size() > 0 && // require a split read for exact location of the breakpoint
+			    (**fusion).filter != FILTERS.at("merge_adjacent") && // slightly varying alignments may lead to adjacent breakpoints, we should not count them as separate breakpoints
+			    (**fusion).filter != FILTERS.at("uninteresting_contigs")) { // skip uninteresting contigs to save some runtime/memory
+				exonic_breakpoints_by_gene_pair[group_start - gene_pair_index.begin()]++;
+			}
 		}
+		group_start = fusions_of_gene_pair.second;
 	}
 
 	// PCR/RT fusions are mostly observed between highly expressed genes
@@ -170,8 +187,8 @@ unsigned int filter_pcr_fusions(fusions_t& fusions, const chimeric_alignments_t&
 
 		// find out how many non-spliced, non-intronic breakpoints there are between the fused genes (or genes overlapping the breakpoints)
 		unsigned int exonic_breakpoints = max(
-			find_or_default(exonic_breakpoints_by_gene_pair, make_tuple(gene1, gene2), (unsigned int) 0),
-			find_or_default(exonic_breakpoints_by_gene_pair, make_tuple(fusion->second.gene1, fusion->second.gene2), (unsigned int) 0)
+			count_exonic_breakpoints(gene1, gene2, gene_pair_index, exonic_breakpoints_by_gene_pair),
+			count_exonic_breakpoints(fusion->second.gene1, fusion->second.gene2, gene_pair_index, exonic_breakpoints_by_gene_pair)
 		);
 
 		// check if the event exhibits the characteristics of a PCR/RT-mediated fusion
@@ -3,9 +3,10 @@
 
 #include "common.hpp"
 #include "annotation.hpp"
+#include "gene_pair_index.hpp"
 
 using namespace std;
 
-unsigned int filter_pcr_fusions(fusions_t& fusions, const chimeric_alignments_t& chimeric_alignments, const float high_expression_quantile, const gene_annotation_index_t& gene_annotation_index);
+unsigned int filter_pcr_fusions(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const chimeric_alignments_t& chimeric_alignments, const float high_expression_quantile, const gene_annotation_index_t& gene_annotation_index);
 
 #endif /* _FILTER_PCR_FUSIONS_H */
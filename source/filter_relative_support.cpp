@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <fstream>
@@ -14,54 +15,123 @@
 
 using namespace std;
 
+// a fusion partner of a gene as observed in a fusion with the given breakpoints
+struct fusion_partner_t {
+	unsigned int gene; // ID of the gene
+	position_t breakpoint1, breakpoint2;
+	unsigned int order; // order in which the fusion partner was encountered
+	unsigned int partner; // ID of the fusion partner
+	bool operator<(const fusion_partner_t& x) const {
+		return make_tuple(gene, breakpoint1, breakpoint2, order) < make_tuple(x.gene, x.breakpoint1, x.breakpoint2, x.order);
+	}
+};
+
+// statistics which are needed to normalize the e-values by type and location of the breakpoints
+struct breakpoint_statistics_t {
+	unsigned int spliced_breakpoints, exonic_breakpoints, intronic_breakpoints, exonic_intronic_breakpoints;
+	unsigned int intragenic_duplications, intragenic_inversions;
+	unsigned int spliced_events_in_same_gene, spliced_events_in_different_genes;
+	breakpoint_statistics_t(): spliced_breakpoints(0), exonic_breakpoints(0), intronic_breakpoints(0), exonic_intronic_breakpoints(0), intragenic_duplications(0), intragenic_inversions(0), spliced_events_in_same_gene(0), spliced_events_in_different_genes(0) {};
+	void add(const fusion_t& fusion);
+};
+
+void breakpoint_statistics_t::add(const fusion_t& fusion) {
+
+	// estimate the fraction of breakpoints by location (splice-site vs. exon vs. intron)
+	// non-spliced breakpoints get a penalty based on how much more frequent they are than spliced breakpoints
+	if (fusion.filter == NULL &&
+	    (fusion.contig1 != fusion.contig2 || fusion.breakpoint2 - fusion.breakpoint1 > 500000) && // ignore proximity artifacts
+	    fusion.supporting_reads() >= 2 && fusion.split_reads1 + fusion.split_reads2 > 0 && // require at least 2 reads, because most events with 1 read are artifacts
+	    !fusion.gene1->is_dummy && !fusion.gene2->is_dummy) {
+		if (fusion.spliced1 || fusion.spliced2)
+			spliced_breakpoints++;
+		else if (fusion.exonic1 && fusion.exonic2)
+			exonic_breakpoints++;
+		else if (!fusion.exonic1 && !fusion.exonic2)
+			intronic_breakpoints++;
+		else
+			exonic_intronic_breakpoints++;
+	}
+
+	// penalize intragenic events according to event type (inversion vs. duplication),
+	// because some libraries produce a huge amount of artifacts of on of these two types of events:
+	// stranded libraries produce many inversions/unstranded libraries produce many duplications
+	if (fusion.filter == NULL && fusion.gene1 == fusion.gene2 && fusion.split_reads1 + fusion.split_reads2 >= 2) {
+		if (fusion.direction1 == UPSTREAM && fusion.direction2 == DOWNSTREAM)
+			intragenic_duplications++;
+		else if (fusion.direction1 == fusion.direction2)
+			intragenic_inversions++;
+	}
+
+	// some samples have an extraordinary number of intragenic events
+	// if this is the case, we penalize intragenic events proportionately
+	// consider only spliced events to compute the ratio, otherwise we would penalize TCR- and IG-rearranged tumors too much
+	if (fusion.spliced1 && fusion.spliced2) {
+		if (fusion.gene1 == fusion.gene2)
+			spliced_events_in_same_gene++;
+		else
+			spliced_events_in_different_genes++;
+	}
+}
+
 void estimate_expected_fusions(fusions_t& fusions, const unsigned long int mapped_reads, const exon_annotation_index_t& exon_annotation_index) {
 
 	// find all fusion partners for each gene
-	unordered_map< gene_t,gene_set_t > fusion_partners;
-	unordered_map< tuple<gene_t,position_t,position_t>,char > overlap_duplicates;
+	// when a gene has multiple fusions with the same breakpoints (because the partner overlaps with other genes),
+	// only the partner of the first such fusion is considered
+	// => make a flat list of (gene, breakpoints, partner) and keep only the first occurrence of each (gene, breakpoints)
+	vector<fusion_partner_t> fusion_partners;
+	unsigned int max_gene_id = 0;
+	breakpoint_statistics_t statistics;
 	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
 		if (fusion->second.filter == NULL && fusion->second.gene1 != fusion->second.gene2) {
-			if (!overlap_duplicates[make_tuple(fusion->second.gene2, fusion->second.breakpoint1, fusion->second.breakpoint2)]++)
-				fusion_partners[fusion->second.gene2].insert(fusion->second.gene1);
-			if (!overlap_duplicates[make_tuple(fusion->second.gene1, fusion->second.breakpoint1, fusion->second.breakpoint2)]++)
-				fusion_partners[fusion->second.gene1].insert(fusion->second.gene2);
+			fusion_partner_t fusion_partner;
+			fusion_partner.breakpoint1 = fusion->second.breakpoint1;
+			fusion_partner.breakpoint2 = fusion->second.breakpoint2;
+			fusion_partner.gene = fusion->second.gene2->id;
+			fusion_partner.partner = fusion->second.gene1->id;
+			fusion_partner.order = fusion_partners.size();
+			fusion_partners.push_back(fusion_partner);
+			fusion_partner.gene = fusion->second.gene1->id;
+			fusion_partner.partner = fusion->second.gene2->id;
+			fusion_partner.order = fusion_partners.size();
+			fusion_partners.push_back(fusion_partner);
 		}
+		max_gene_id = max(max_gene_id, max(fusion->second.gene1->id, fusion->second.gene2->id));
+
+		// collect the statistics needed for the e-value in the same pass
+		statistics.add(fusion->second);
 	}
-	overlap_duplicates.clear();
+	sort(fusion_partners.begin(), fusion_partners.end());
+
+	// reduce the list to unique pairs of (gene, partner)
+	vector< pair<unsigned int/*gene*/,unsigned int/*partner*/> > fusion_partner_pairs;
+	fusion_partner_pairs.reserve(fusion_partners.size());
+	for (auto fusion_partner = fusion_partners.begin(); fusion_partner != fusion_partners.end(); ++fusion_partner)
+		if (fusion_partner == fusion_partners.begin() ||
+		    (fusion_partner-1)->gene != fusion_partner->gene || (fusion_partner-1)->breakpoint1 != fusion_partner->breakpoint1 || (fusion_partner-1)->breakpoint2 != fusion_partner->breakpoint2)
+			fusion_partner_pairs.push_back(make_pair(fusion_partner->gene, fusion_partner->partner));
+	fusion_partners.clear();
+	sort(fusion_partner_pairs.begin(), fusion_partner_pairs.end());
+	fusion_partner_pairs.erase(unique(fusion_partner_pairs.begin(), fusion_partner_pairs.end()), fusion_partner_pairs.end());
+
+	// count the number of distinct fusion partners of each gene
+	vector<unsigned int> distinct_fusion_partners(max_gene_id + 1);
+	for (auto fusion_partner_pair = fusion_partner_pairs.begin(); fusion_partner_pair != fusion_partner_pairs.end(); ++fusion_partner_pair)
+		distinct_fusion_partners[fusion_partner_pair->first]++;
 
 	// count the number of fusion partners for each gene
 	// fusions with genes that have more fusion partners are ignored
-	unordered_map<gene_t,int> fusion_partner_count;
-	for (auto fusion_partner1 = fusion_partners.begin(); fusion_partner1 != fusion_partners.end(); ++fusion_partner1) {
-		for (auto fusion_partner2 = fusion_partner1->second.begin(); fusion_partner2 != fusion_partner1->second.end(); ++fusion_partner2) {
-			if (fusion_partner1->second.size() >= fusion_partners[*fusion_partner2].size()) {
-				fusion_partner_count[fusion_partner1->first]++;
-			}
-		}
-	}
+	vector<int> fusion_partner_count(max_gene_id + 1);
+	for (auto fusion_partner_pair = fusion_partner_pairs.begin(); fusion_partner_pair != fusion_partner_pairs.end(); ++fusion_partner_pair)
+		if (distinct_fusion_partners[fusion_partner_pair->first] >= distinct_fusion_partners[fusion_partner_pair->second])
+			fusion_partner_count[fusion_partner_pair->first]++;
 
-	// estimate the fraction of breakpoints by location (splice-site vs. exon vs. intron)
-	// non-spliced breakpoints get a penalty based on how much more frequent they are than spliced breakpoints
-	unsigned int spliced_breakpoints = 0;
-	unsigned int exonic_breakpoints = 0;
-	unsigned int intronic_breakpoints = 0;
-	unsigned int exonic_intronic_breakpoints = 0;
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
-		if (fusion->second.filter == NULL &&
-		    (fusion->second.contig1 != fusion->second.contig2 || fusion->second.breakpoint2 - fusion->second.breakpoint1 > 500000) && // ignore proximity artifacts
-		    fusion->second.supporting_reads() >= 2 && fusion->second.split_reads1 + fusion->second.split_reads2 > 0 && // require at least 2 reads, because most events with 1 read are artifacts
-		    !fusion->second.gene1->is_dummy && !fusion->second.gene2->is_dummy) {
-			if (fusion->second.spliced1 || fusion->second.spliced2)
-				spliced_breakpoints++;
-			else if (fusion->second.exonic1 && fusion->second.exonic2)
-				exonic_breakpoints++;
-			else if (!fusion->second.exonic1 && !fusion->second.exonic2)
-				intronic_breakpoints++;
-			else
-				exonic_intronic_breakpoints++;
-		}
-	}
 	// use some reasonable default values if there are not enough data points to estimate the fractions accurately
+	unsigned int spliced_breakpoints = statistics.spliced_breakpoints;
+	unsigned int exonic_breakpoints = statistics.exonic_breakpoints;
+	unsigned int intronic_breakpoints = statistics.intronic_breakpoints;
+	unsigned int exonic_intronic_breakpoints = statistics.exonic_intronic_breakpoints;
 	if (spliced_breakpoints + exonic_breakpoints + intronic_breakpoints + exonic_intronic_breakpoints < 100 ||
 	    spliced_breakpoints == 0 || exonic_breakpoints == 0 || intronic_breakpoints == 0 || exonic_intronic_breakpoints == 0) {
 		spliced_breakpoints = 10;
@@ -70,39 +140,17 @@ void estimate_expected_fusions(fusions_t& fusions, const unsigned long int mappe
 		exonic_intronic_breakpoints = 15;
 	}
 
-	// penalize intragenic events according to event type (inversion vs. duplication),
-	// because some libraries produce a huge amount of artifacts of on of these two types of events:
-	// stranded libraries produce many inversions/unstranded libraries produce many duplications
-	unsigned int intragenic_duplications = 0;
-	unsigned int intragenic_inversions = 0;
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
-		if (fusion->second.filter == NULL && fusion->second.gene1 == fusion->second.gene2 && fusion->second.split_reads1 + fusion->second.split_reads2 >= 2) {
-			if (fusion->second.direction1 == UPSTREAM && fusion->second.direction2 == DOWNSTREAM)
-				intragenic_duplications++;
-			else if (fusion->second.direction1 == fusion->second.direction2)
-				intragenic_inversions++;
-		}
-	}
 	// use reasonable defaut values, if sample size is too small
+	unsigned int intragenic_duplications = statistics.intragenic_duplications;
+	unsigned int intragenic_inversions = statistics.intragenic_inversions;
 	if (intragenic_inversions + intragenic_duplications < 100) {
 		intragenic_inversions = 1;
 		intragenic_duplications = 1;
 	}
 
-	// some samples have an extraordinary number of intragenic events
-	// if this is the case, we penalize intragenic events proportionately
-	// consider only spliced events to compute the ratio, otherwise we would penalize TCR- and IG-rearranged tumors too much
-	unsigned int spliced_events_in_same_gene = 0;
-	unsigned int spliced_events_in_different_genes = 0;
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
-		if (fusion->second.spliced1 && fusion->second.spliced2) {
-			if (fusion->second.gene1 == fusion->second.gene2)
-				spliced_events_in_same_gene++;
-			else
-				spliced_events_in_different_genes++;
-		}
-	}
 	// use reasonable defaut values, if sample size is too small
+	unsigned int spliced_events_in_same_gene = statistics.spliced_events_in_same_gene;
+	unsigned int spliced_events_in_different_genes = statistics.spliced_events_in_different_genes;
 	if (spliced_events_in_same_gene + spliced_events_in_different_genes < 100) {
 		spliced_events_in_same_gene = 0; // effectively disables penalty
 		spliced_events_in_different_genes = 100;
@@ -114,8 +162,8 @@ void estimate_expected_fusions(fusions_t& fusions, const unsigned long int mappe
 
 		// pick the gene with the most fusion partners
 		float max_fusion_partners = max(
-			10000.0 / fusion->second.gene1->exonic_length * max(fusion_partner_count[fusion->second.gene1]-1, 1),
-			10000.0 / fusion->second.gene2->exonic_length * max(fusion_partner_count[fusion->second.gene2]-1, 1)
+			10000.0 / fusion->second.gene1->exonic_length * max(fusion_partner_count[fusion->second.gene1->id]-1, 1),
+			10000.0 / fusion->second.gene2->exonic_length * max(fusion_partner_count[fusion->second.gene2->id]-1, 1)
 		);
 
 		// calculate expected number of fusions (e-value)
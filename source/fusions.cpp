@@ -9,6 +9,7 @@
 #include "common.hpp"
 #include "annotation.hpp"
 #include "fusions.hpp"
+#include "time_budget.hpp"
 
 using namespace std;
 
@@ -200,15 +201,22 @@ void predict_transcript_start(fusion_t& fusion) {
 }
 
 
-unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t& fusions, exon_annotation_index_t& exon_annotation_index, const int max_mate_gap, const unsigned int subsampling_threshold) {
+unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t& fusions, exon_annotation_index_t& exon_annotation_index, const int max_mate_gap, unsigned int subsampling_threshold, const unsigned int degraded_subsampling_threshold, stage_watchdog_t& watchdog) {
 
 	typedef unordered_map< tuple<unsigned int/*gene1->id*/,unsigned int/*gene2->id*/>, vector<chimeric_alignments_t::iterator> > discordant_mates_by_gene_pair_t;
 	discordant_mates_by_gene_pair_t discordant_mates_by_gene_pair; // contains the discordant mates for each pair of genes
 
 	bool subsampled_fusions = false;
 
+	// when we are running out of time, subsample more aggressively
+	const string degradation = "subsampling threshold lowered from " + to_string(static_cast<long long int>(subsampling_threshold)) + " to " + to_string(static_cast<long long int>(min(subsampling_threshold, degraded_subsampling_threshold)));
+
+	unsigned long int processed_alignments = 0;
 	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
 
+		if (++processed_alignments % 1024 == 0 && watchdog.degrade_if_overdue(processed_alignments, chimeric_alignments.size(), degradation))
+			subsampling_threshold = min(subsampling_threshold, degraded_subsampling_threshold);
+
 		contig_t contig1, contig2;
 		position_t breakpoint1, breakpoint2;
 		direction_t direction1, direction2;
@@ -368,8 +376,13 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 	}
 
 	// for each fusion, count the supporting discordant mates
+	// (the progress is measured from the start of this loop, but the elapsed time includes the loop above, which errs on the safe side)
+	unsigned long int processed_fusions = 0;
 	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
 
+		if (++processed_fusions % 1024 == 0 && watchdog.degrade_if_overdue(processed_fusions, fusions.size(), degradation))
+			subsampling_threshold = min(subsampling_threshold, degraded_subsampling_threshold);
+
 		if (fusion->second.filter != NULL)
 			continue; // don't look for discordant mates, if the fusion has been filtered
 
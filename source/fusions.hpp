@@ -3,9 +3,10 @@
 
 #include "common.hpp"
 #include "annotation.hpp"
+#include "time_budget.hpp"
 
 using namespace std;
 
-unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t& fusions, exon_annotation_index_t& exon_annotation_index, const int max_mate_gap, const unsigned int subsampling_threshold);
+unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t& fusions, exon_annotation_index_t& exon_annotation_index, const int max_mate_gap, unsigned int subsampling_threshold, const unsigned int degraded_subsampling_threshold, stage_watchdog_t& watchdog);
 
 #endif /* _FIND_FUSIONS_H */
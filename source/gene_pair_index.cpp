@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <tuple>
+#include <vector>
+#include "common.hpp"
+#include "gene_pair_index.hpp"
+
+using namespace std;
+
+// key by which fusions are grouped
+// we sort by gene IDs rather than by pointers to get deterministic behavior
+typedef tuple<unsigned int /*gene1 id*/, unsigned int /*gene2 id*/, direction_t /*direction1*/, direction_t /*direction2*/> gene_pair_key_t;
+
+gene_pair_key_t get_gene_pair_key(const fusion_t* fusion) {
+	return make_tuple(fusion->gene1->id, fusion->gene2->id, (direction_t) fusion->direction1, (direction_t) fusion->direction2);
+}
+
+bool sort_fusions_by_gene_pair(const fusion_t* x, const fusion_t* y) {
+	return get_gene_pair_key(x) < get_gene_pair_key(y);
+}
+
+bool sort_fusions_by_gene(const pair<unsigned int,fusion_t*>& x, const pair<unsigned int,fusion_t*>& y) {
+	return x.first < y.first;
+}
+
+// helper classes for binary search of (partial) keys
+struct compare_gene_pair_t {
+	bool operator()(const fusion_t* x, const tuple<unsigned int,unsigned int>& y) const { return make_tuple(x->gene1->id, x->gene2->id) < y; };
+	bool operator()(const tuple<unsigned int,unsigned int>& x, const fusion_t* y) const { return x < make_tuple(y->gene1->id, y->gene2->id); };
+};
+struct compare_gene_pair_and_directions_t {
+	bool operator()(const fusion_t* x, const gene_pair_key_t& y) const { return get_gene_pair_key(x) < y; };
+	bool operator()(const gene_pair_key_t& x, const fusion_t* y) const { return x < get_gene_pair_key(y); };
+};
+
+gene_pair_index_t::gene_pair_index_t(fusions_t& fusions) {
+
+	// make a list of all fusions, filtered or not, since the filter status may change later
+	by_gene_pair.reserve(fusions.size());
+	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion)
+		by_gene_pair.push_back(&fusion->second);
+
+	// group fusions by gene pair
+	// stable sorting retains the order of the fusions within a group,
+	// such that stages which depend on the order of traversal behave the same as when iterating over <fusions>
+	stable_sort(by_gene_pair.begin(), by_gene_pair.end(), sort_fusions_by_gene_pair);
+
+	// list every fusion under both of its genes
+	vector< pair<unsigned int,fusion_t*> > fusions_by_gene;
+	fusions_by_gene.reserve(2 * by_gene_pair.size());
+	for (auto fusion = by_gene_pair.begin(); fusion != by_gene_pair.end(); ++fusion) {
+		fusions_by_gene.push_back(make_pair((**fusion).gene1->id, *fusion));
+		fusions_by_gene.push_back(make_pair((**fusion).gene2->id, *fusion));
+	}
+	stable_sort(fusions_by_gene.begin(), fusions_by_gene.end(), sort_fusions_by_gene);
+	by_gene.reserve(fusions_by_gene.size());
+	by_gene_ids.reserve(fusions_by_gene.size());
+	for (auto fusion = fusions_by_gene.begin(); fusion != fusions_by_gene.end(); ++fusion) {
+		by_gene_ids.push_back(fusion->first);
+		by_gene.push_back(fusion->second);
+	}
+}
+
+gene_pair_index_t::range_t gene_pair_index_t::find(const gene_t gene1, const gene_t gene2) const {
+	return equal_range(by_gene_pair.begin(), by_gene_pair.end(), make_tuple(gene1->id, gene2->id), compare_gene_pair_t());
+}
+
+gene_pair_index_t::range_t gene_pair_index_t::find(const gene_t gene1, const gene_t gene2, const direction_t direction1, const direction_t direction2) const {
+	return equal_range(by_gene_pair.begin(), by_gene_pair.end(), make_tuple(gene1->id, gene2->id, direction1, direction2), compare_gene_pair_and_directions_t());
+}
+
+gene_pair_index_t::range_t gene_pair_index_t::find(const gene_t gene) const {
+	auto ids = equal_range(by_gene_ids.begin(), by_gene_ids.end(), gene->id);
+	return make_pair(by_gene.begin() + (ids.first - by_gene_ids.begin()), by_gene.begin() + (ids.second - by_gene_ids.begin()));
+}
+
+gene_pair_index_t::range_t gene_pair_index_t::group_of(const iterator fusion, const bool by_direction) const {
+	if (by_direction)
+		return find((**fusion).gene1, (**fusion).gene2, (**fusion).direction1, (**fusion).direction2);
+	else
+		return find((**fusion).gene1, (**fusion).gene2);
+}
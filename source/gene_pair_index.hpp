@@ -0,0 +1,38 @@
+#ifndef _GENE_PAIR_INDEX_H
+#define _GENE_PAIR_INDEX_H 1
+
+#include <utility>
+#include <vector>
+#include "common.hpp"
+
+using namespace std;
+
+// index which groups fusions by gene pair and directions
+// the groups are stored contiguously and sorted by (gene1, gene2, direction1, direction2),
+// such that all fusions between the same pair of genes are adjacent regardless of their directions
+// the index holds pointers to the fusions, so it remains valid as long as no fusions are added or removed
+// and it always reflects the current filter status of the fusions
+class gene_pair_index_t {
+	public:
+		typedef vector<fusion_t*>::const_iterator iterator;
+		typedef pair<iterator,iterator> range_t;
+	private:
+		vector<fusion_t*> by_gene_pair; // all fusions sorted by gene pair and directions
+		vector<fusion_t*> by_gene; // every fusion listed twice, once for gene1 and once for gene2
+		vector<unsigned int> by_gene_ids; // ID of the gene under which the respective element of <by_gene> is listed
+	public:
+		gene_pair_index_t(fusions_t& fusions);
+		iterator begin() const { return by_gene_pair.begin(); };
+		iterator end() const { return by_gene_pair.end(); };
+		unsigned int size() const { return by_gene_pair.size(); };
+		// find all fusions between the given genes (in any direction)
+		range_t find(const gene_t gene1, const gene_t gene2) const;
+		// find all fusions between the given genes with the given directions
+		range_t find(const gene_t gene1, const gene_t gene2, const direction_t direction1, const direction_t direction2) const;
+		// find all fusions involving the given gene (as gene1 or gene2)
+		range_t find(const gene_t gene) const;
+		// find the group which the given element of the index belongs to
+		range_t group_of(const iterator fusion, const bool by_direction = true) const;
+};
+
+#endif /* _GENE_PAIR_INDEX_H */
@@ -0,0 +1,706 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "sam.h"
+#include "common.hpp"
+#include "annotation.hpp"
+#include "assembly.hpp"
+#include "options.hpp"
+#include "read_compressed_file.hpp"
+#include "read_ahead.hpp"
+#include "progress.hpp"
+#include "read_stats.hpp"
+#include "coverage_track.hpp"
+#include "read_chimeric_alignments.hpp"
+#include "filter_multi_mappers.hpp"
+#include "filter_uninteresting_contigs.hpp"
+#include "filter_inconsistently_clipped.hpp"
+#include "filter_homopolymer.hpp"
+#include "filter_duplicates.hpp"
+#include "filter_proximal_read_through.hpp"
+#include "filter_same_gene.hpp"
+#include "filter_small_insert_size.hpp"
+#include "filter_long_gap.hpp"
+#include "filter_hairpin.hpp"
+#include "filter_mismatches.hpp"
+#include "filter_low_entropy.hpp"
+#include "fusions.hpp"
+#include "gene_pair_index.hpp"
+#include "filter_relative_support.hpp"
+#include "filter_both_intronic.hpp"
+#include "filter_non_coding_neighbors.hpp"
+#include "filter_intragenic_both_exonic.hpp"
+#include "filter_min_support.hpp"
+#include "recover_known_fusions.hpp"
+#include "recover_both_spliced.hpp"
+#include "filter_blacklisted_ranges.hpp"
+#include "filter_pcr_fusions.hpp"
+#include "memory_budget.hpp"
+#include "merge_adjacent_fusions.hpp"
+#include "select_best.hpp"
+#include "filter_end_to_end.hpp"
+#include "filter_short_anchor.hpp"
+#include "filter_homologs.hpp"
+#include "filter_mismappers.hpp"
+#include "filter_no_coverage.hpp"
+#include "filter_genomic_support.hpp"
+#include "recover_many_spliced.hpp"
+#include "recover_isoforms.hpp"
+#include "output_fusions.hpp"
+#include "export_evidence.hpp"
+#include "pipeline.hpp"
+#include "time_budget.hpp"
+#include "partial_state.hpp"
+#include "libarriba.hpp"
+
+
+using namespace std;
+
+unordered_map<string,filter_t> FILTERS({
+	{"inconsistently_clipped", static_cast<string*>(NULL)},
+	{"homopolymer", static_cast<string*>(NULL)},
+	{"duplicates", static_cast<string*>(NULL)},
+	{"read_through", static_cast<string*>(NULL)},
+	{"same_gene", static_cast<string*>(NULL)},
+	{"small_insert_size", static_cast<string*>(NULL)},
+	{"long_gap", static_cast<string*>(NULL)},
+	{"hairpin", static_cast<string*>(NULL)},
+	{"mismatches", static_cast<string*>(NULL)},
+	{"mismappers", static_cast<string*>(NULL)},
+	{"relative_support", static_cast<string*>(NULL)},
+	{"intronic", static_cast<string*>(NULL)},
+	{"non_coding_neighbors", static_cast<string*>(NULL)},
+	{"intragenic_exonic", static_cast<string*>(NULL)},
+	{"min_support", static_cast<string*>(NULL)},
+	{"known_fusions", static_cast<string*>(NULL)},
+	{"spliced", static_cast<string*>(NULL)},
+	{"blacklist", static_cast<string*>(NULL)},
+	{"end_to_end", static_cast<string*>(NULL)},
+	{"pcr_fusions", static_cast<string*>(NULL)},
+	{"merge_adjacent", static_cast<string*>(NULL)},
+	{"select_best", static_cast<string*>(NULL)},
+	{"short_anchor", static_cast<string*>(NULL)},
+	{"no_coverage", static_cast<string*>(NULL)},
+	{"many_spliced", static_cast<string*>(NULL)},
+	{"no_genomic_support", static_cast<string*>(NULL)},
+	{"uninteresting_contigs", static_cast<string*>(NULL)},
+	{"genomic_support", static_cast<string*>(NULL)},
+	{"isoforms", static_cast<string*>(NULL)},
+	{"low_entropy", static_cast<string*>(NULL)},
+	{"homologs", static_cast<string*>(NULL)}
+});
+
+// convert a value to a string the same way it would be printed to the log
+template <class T> string to_log_string(const T& value) {
+	ostringstream oss;
+	oss << value;
+	return oss.str();
+}
+
+// make the summary of a filter for the log
+string remaining(const unsigned int remaining_count) {
+	return "remaining=" + to_log_string(remaining_count);
+}
+
+contigs_t parse_interesting_contigs(const options_t& options) {
+	// convert options.interesting_contigs from string to contigs_t
+	contigs_t interesting_contigs;
+	if (options.filters.at("uninteresting_contigs") && !options.interesting_contigs.empty()) {
+		istringstream iss(options.interesting_contigs);
+		while (iss) {
+			string contig;
+			iss >> contig;
+			if (!contig.empty())
+				interesting_contigs.insert(pair<string,contig_t>(removeChr(contig),interesting_contigs.size()));
+		}
+	}
+	return interesting_contigs;
+}
+
+reference_context_t::reference_context_t(const options_t& options) {
+
+	// must be set before any file is preloaded
+	set_read_ahead_depth(options.read_ahead_depth * 1024ULL * 1024ULL);
+	set_progress_reporting(options.progress_interval, options.progress_file);
+
+	// initialize filter names
+	for (auto i = FILTERS.begin(); i != FILTERS.end(); ++i)
+		i->second = &i->first; // filters are represented by pointers to the name of the filter (this saves memory compared to storing strings)
+
+	interesting_contigs = parse_interesting_contigs(options);
+	contigs = interesting_contigs;
+
+	// files needed by later filters are loaded in the background, while the annotation, the assembly and the alignments are read
+	// (the scatter step does not run any filters)
+	if (options.shards == 0) {
+		if (!options.genomic_breakpoints_file.empty())
+			preload_file(options.genomic_breakpoints_file);
+		if (!options.known_fusions_file.empty() && options.filters.at("known_fusions"))
+			preload_file(options.known_fusions_file);
+		if (!options.blacklist_file.empty() && options.filters.at("blacklist"))
+			preload_file(options.blacklist_file);
+	}
+
+	// load sequences of contigs from assembly in a separate thread, while the GTF file is loaded
+	cout << get_time_string() << " Loading assembly from '" << options.assembly_file << "'" << endl;
+	contig_sequences_t contig_sequences;
+	thread assembly_loader(read_assembly, cref(options.assembly_file), cref(interesting_contigs), ref(contig_sequences));
+
+	// load GTF file
+	cout << get_time_string() << " Loading annotation from '" << options.gene_annotation_file << "'" << endl << flush;
+	read_annotation_gtf(options.gene_annotation_file, options.gtf_features, contigs, gene_annotation, transcript_annotation, exon_annotation, gene_names);
+
+	// sort genes and exons by coordinate (make index)
+	make_annotation_index(exon_annotation, exon_annotation_index);
+	make_annotation_index(gene_annotation, gene_annotation_index);
+
+	// contigs of the assembly are numbered after those of the GTF file, no matter which file finished loading first
+	assembly_loader.join();
+	number_assembly(contig_sequences, assembly, contigs, interesting_contigs);
+	make_cds_maps(exon_annotation, assembly);
+
+	// prevent htslib from downloading the assembly via the Internet, if CRAM is used
+	setenv("REF_PATH", ".", 0);
+
+	// calculate sum of the lengths of all exons for each gene
+	// we will need this to normalize the number of events over the gene length
+	for (exon_annotation_index_t::iterator contig = exon_annotation_index.begin(); contig != exon_annotation_index.end(); ++contig) {
+		position_t region_start = 0;
+		for (exon_contig_annotation_index_t::iterator region = contig->begin(); region != contig->end(); ++region) {
+			gene_t previous_gene = NULL;
+			for (exon_set_t::iterator overlapping_exon = region->second.begin(); overlapping_exon != region->second.end(); ++overlapping_exon) {
+				gene_t& current_gene = (**overlapping_exon).gene;
+				if (previous_gene != current_gene) {
+					current_gene->exonic_length += region->first - region_start;
+					previous_gene = current_gene;
+				}
+			}
+			region_start = region->first;
+		}
+	}
+	for (gene_annotation_t::iterator gene = gene_annotation.begin(); gene != gene_annotation.end(); ++gene)
+		if (gene->exonic_length == 0)
+			gene->exonic_length = gene->end - gene->start; // use total gene length, if the gene has no exons
+
+	// assign IDs to genes
+	// this is necessary for deterministic behavior, because fusions are hashed by genes
+	unsigned int gene_id = 0;
+	for (gene_annotation_t::iterator gene = gene_annotation.begin(); gene != gene_annotation.end(); ++gene)
+		gene->id = gene_id++;
+
+	// parse blacklist once, so that it can be applied to any number of samples
+	if (options.filters.at("blacklist") && !options.blacklist_file.empty() && options.shards == 0) {
+		cout << get_time_string() << " Loading blacklist from '" << options.blacklist_file << "'" << endl;
+		read_blacklist(options.blacklist_file, contigs, gene_names, blacklist);
+	}
+}
+
+sample_session_t::sample_session_t(const reference_context_t& reference, const options_t& options):
+	reference(reference), options(options), own_time_budget(options.time_budget), time_budget(own_time_budget),
+	contigs(reference.contigs), gene_annotation_index(reference.gene_annotation_index), exon_annotation_index(reference.exon_annotation_index),
+	mapped_reads(0), coverage(contigs, reference.assembly), fragment_statistics(gene_annotation_index, exon_annotation_index), separate_chimeric_bam_file(false), chimeric_records_extractor(NULL), rna_records_extractor(NULL), record_buffer(NULL), provisional_fusions(NULL), fusions_by_gene_pair(NULL) {
+	if (!options.provisional_output_file.empty())
+		provisional_fusions = new provisional_fusions_t(options.provisional_output_file, options.known_fusions_file, reference.gene_names, gene_annotation_index, options.provisional_min_support);
+	if (!options.coverage_track_file.empty())
+		coverage.set_precomputed();
+}
+
+sample_session_t::sample_session_t(const reference_context_t& reference, const options_t& options, time_budget_t& time_budget):
+	reference(reference), options(options), own_time_budget(0), time_budget(time_budget),
+	contigs(reference.contigs), gene_annotation_index(reference.gene_annotation_index), exon_annotation_index(reference.exon_annotation_index),
+	mapped_reads(0), coverage(contigs, reference.assembly), fragment_statistics(gene_annotation_index, exon_annotation_index), separate_chimeric_bam_file(false), chimeric_records_extractor(NULL), rna_records_extractor(NULL), record_buffer(NULL), provisional_fusions(NULL), fusions_by_gene_pair(NULL) {
+	if (!options.provisional_output_file.empty())
+		provisional_fusions = new provisional_fusions_t(options.provisional_output_file, options.known_fusions_file, reference.gene_names, gene_annotation_index, options.provisional_min_support);
+	if (!options.coverage_track_file.empty())
+		coverage.set_precomputed();
+}
+
+sample_session_t::~sample_session_t() {
+	delete chimeric_records_extractor;
+	delete rna_records_extractor;
+	if (record_buffer != NULL)
+		bam_destroy1(record_buffer);
+	delete fusions_by_gene_pair;
+	delete provisional_fusions;
+}
+
+unsigned int sample_session_t::read_chimeric_bam_file(const string& bam_file_path) {
+	return read_chimeric_bam_files(vector<string>(1, bam_file_path));
+}
+
+unsigned int sample_session_t::read_rna_bam_file(const string& bam_file_path) {
+	return read_rna_bam_files(vector<string>(1, bam_file_path));
+}
+
+unsigned int sample_session_t::read_chimeric_bam_files(const vector<string>& bam_file_paths) {
+	separate_chimeric_bam_file = true;
+	return read_chimeric_alignments(bam_file_paths, options.assembly_file, chimeric_alignments, mapped_reads, coverage, fragment_statistics, contigs, reference.interesting_contigs, gene_annotation_index, true, false, provisional_fusions);
+}
+
+unsigned int sample_session_t::read_rna_bam_files(const vector<string>& bam_file_paths) {
+	finish_chimeric_records();
+	return read_chimeric_alignments(bam_file_paths, options.assembly_file, chimeric_alignments, mapped_reads, coverage, fragment_statistics, contigs, reference.interesting_contigs, gene_annotation_index, separate_chimeric_bam_file, true, provisional_fusions);
+}
+
+unsigned int sample_session_t::read_chimeric_bam_shard(const vector<string>& bam_file_paths, const string& rna_bam_file_path, const unsigned int shard, const unsigned int shards) {
+	separate_chimeric_bam_file = true;
+	// when an indexed file is split into ranges of the genome, a shard may contain any read, so all names are needed
+	return read_chimeric_read_names(bam_file_paths, options.assembly_file, chimeric_alignments, shard, (has_bam_index(rna_bam_file_path)) ? 1 : shards);
+}
+
+unsigned int sample_session_t::read_rna_bam_shard(const string& bam_file_path, const unsigned int shard, const unsigned int shards, const string& partial_state_file) {
+	finish_chimeric_records();
+	partial_bam_records_t partial_bam_records;
+	unsigned int result = read_chimeric_alignments(bam_file_path, options.assembly_file, chimeric_alignments, mapped_reads, coverage, fragment_statistics, contigs, reference.interesting_contigs, gene_annotation_index, separate_chimeric_bam_file, true, shard, shards, &partial_bam_records);
+	write_partial_state(partial_state_file, contigs, mapped_reads, coverage, fragment_statistics, partial_bam_records);
+	return result;
+}
+
+unsigned int sample_session_t::merge_partial_states(const vector<string>& partial_state_files) {
+	finish_chimeric_records();
+	partial_bam_records_t partial_bam_records;
+	read_partial_states(partial_state_files, contigs, mapped_reads, coverage, fragment_statistics, partial_bam_records);
+	return replay_partial_bam_records(partial_bam_records, chimeric_alignments, mapped_reads, coverage, fragment_statistics, gene_annotation_index, separate_chimeric_bam_file, true);
+}
+
+void sample_session_t::add_chimeric_records(const bam_hdr_t* bam_header, const bam1_t* const* records, const unsigned int count) {
+	if (rna_records_extractor != NULL) {
+		cerr << "ERROR: chimeric alignments must be added before the main alignments." << endl;
+		exit(1);
+	}
+	if (chimeric_records_extractor == NULL) {
+		separate_chimeric_bam_file = true;
+		chimeric_records_extractor = new chimeric_alignment_extractor_t(bam_header, contigs, reference.interesting_contigs, chimeric_alignments, mapped_reads, coverage, fragment_statistics, gene_annotation_index, true, false, NULL, provisional_fusions);
+	}
+	for (unsigned int i = 0; i < count; ++i) {
+		// the extractor modifies the record, so it is passed a copy
+		if (record_buffer == NULL)
+			record_buffer = bam_init1();
+		if (record_buffer == NULL || bam_copy1(record_buffer, records[i]) == NULL) {
+			cerr << "ERROR: failed to allocate memory." << endl;
+			exit(1);
+		}
+		chimeric_records_extractor->add_record(record_buffer);
+	}
+}
+
+void sample_session_t::add_rna_records(const bam_hdr_t* bam_header, const bam1_t* const* records, const unsigned int count) {
+	if (rna_records_extractor == NULL) {
+		finish_chimeric_records();
+		rna_records_extractor = new chimeric_alignment_extractor_t(bam_header, contigs, reference.interesting_contigs, chimeric_alignments, mapped_reads, coverage, fragment_statistics, gene_annotation_index, separate_chimeric_bam_file, true, NULL, provisional_fusions);
+	}
+	for (unsigned int i = 0; i < count; ++i) {
+		// the extractor modifies the record, so it is passed a copy
+		if (record_buffer == NULL)
+			record_buffer = bam_init1();
+		if (record_buffer == NULL || bam_copy1(record_buffer, records[i]) == NULL) {
+			cerr << "ERROR: failed to allocate memory." << endl;
+			exit(1);
+		}
+		rna_records_extractor->add_record(record_buffer);
+	}
+}
+
+// the chimeric alignments are complete, once the first main alignments are given
+void sample_session_t::finish_chimeric_records() {
+	if (chimeric_records_extractor != NULL) {
+		chimeric_records_extractor->finish();
+		delete chimeric_records_extractor;
+		chimeric_records_extractor = NULL;
+	}
+}
+
+void sample_session_t::finish_records() {
+	finish_chimeric_records();
+	if (rna_records_extractor != NULL) {
+		rna_records_extractor->finish();
+		delete rna_records_extractor;
+		rna_records_extractor = NULL;
+	}
+}
+
+vector<fusion_call_t> sample_session_t::call_fusions(const bool include_discarded) {
+
+	if (fusions_by_gene_pair != NULL) {
+		cerr << "ERROR: fusions have already been called in this session." << endl;
+		exit(1);
+	}
+	finish_records();
+
+	// map contig IDs to names
+	contigs_by_id.resize(contigs.size());
+	for (contigs_t::iterator i = contigs.begin(); i != contigs.end(); ++i)
+		contigs_by_id[i->second] = i->first;
+
+	// the BAM files may have added some contigs which were not in the GTF file
+	// => add empty indices for the new contigs so that lookups of these contigs won't cause array-out-of-bounds exceptions
+	gene_annotation_index.resize(contigs.size());
+	exon_annotation_index.resize(contigs.size());
+
+	cout << get_time_string() << " Filtering multi-mappers and single mates" << flush;
+	cout << " (remaining=" << filter_multi_mappers(chimeric_alignments) << ")" << endl;
+
+	strandedness_t strandedness = options.strandedness;
+	if (options.strandedness == STRANDEDNESS_AUTO) {
+		cout << get_time_string() << " Detecting strandedness" << flush;
+		strandedness = fragment_statistics.detect_strandedness();
+		switch (strandedness) {
+			case STRANDEDNESS_YES: cout << " (yes)" << endl; break;
+			case STRANDEDNESS_REVERSE: cout << " (reverse)" << endl; break;
+			default: cout << " (no)" << endl;
+		}
+	}
+	if (strandedness != STRANDEDNESS_NO) {
+		cout << get_time_string() << " Assigning strands to alignments" << endl << flush;
+		assign_strands_from_strandedness(chimeric_alignments, strandedness);
+	}
+
+	cout << get_time_string() << " Annotating alignments" << flush << endl;
+	// first, try to annotate with exons
+	for (chimeric_alignments_t::iterator mates = chimeric_alignments.begin(); mates != chimeric_alignments.end(); ++mates)
+		annotate_alignments(mates->second, exon_annotation_index);
+
+	// if the alignment does not map to an exon, try to map it to a gene
+	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
+		for (mates_t::iterator mate = chimeric_alignment->second.begin(); mate != chimeric_alignment->second.end(); ++mate) {
+			if (mate->genes.empty())
+				get_annotation_by_coordinate(mate->contig, mate->start, mate->end, mate->genes, gene_annotation_index);
+		}
+		// try to resolve ambiguous mappings using mapping information from mate
+		if (chimeric_alignment->second.size() == 3) {
+			gene_set_t combined;
+			combine_annotations(chimeric_alignment->second[SPLIT_READ].genes, chimeric_alignment->second[MATE1].genes, combined);
+			if (chimeric_alignment->second[MATE1].genes.empty() || combined.size() < chimeric_alignment->second[MATE1].genes.size())
+				chimeric_alignment->second[MATE1].genes = combined;
+			if (chimeric_alignment->second[SPLIT_READ].genes.empty() || combined.size() < chimeric_alignment->second[SPLIT_READ].genes.size())
+				chimeric_alignment->second[SPLIT_READ].genes = combined;
+		}
+	}
+
+	// if the alignment maps neither to an exon nor to a gene, make a dummy gene which subsumes all alignments with a distance of 10kb
+	gene_annotation_t unmapped_alignments;
+	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
+		gene_annotation_record_t gene_annotation_record;
+		if (chimeric_alignment->second.size() == 3) { // split-read
+			if (chimeric_alignment->second[SPLIT_READ].genes.empty()) {
+				gene_annotation_record.contig = chimeric_alignment->second[SPLIT_READ].contig;
+				gene_annotation_record.start = gene_annotation_record.end = (chimeric_alignment->second[SPLIT_READ].strand == FORWARD) ? chimeric_alignment->second[SPLIT_READ].start : chimeric_alignment->second[SPLIT_READ].end;
+				unmapped_alignments.push_back(gene_annotation_record);
+			}
+			if (chimeric_alignment->second[SUPPLEMENTARY].genes.empty()) {
+				gene_annotation_record.contig = chimeric_alignment->second[SUPPLEMENTARY].contig;
+				gene_annotation_record.start = gene_annotation_record.end = (chimeric_alignment->second[SUPPLEMENTARY].strand == FORWARD) ? chimeric_alignment->second[SUPPLEMENTARY].end : chimeric_alignment->second[SUPPLEMENTARY].start;
+				unmapped_alignments.push_back(gene_annotation_record);
+			}
+		} else { // discordant mates
+			for (mates_t::iterator mate = chimeric_alignment->second.begin(); mate != chimeric_alignment->second.end(); ++mate) {
+				if (mate->genes.empty()) {
+					gene_annotation_record.contig = mate->contig;
+					gene_annotation_record.start = gene_annotation_record.end = (mate->strand == FORWARD) ? mate->end : mate->start;
+					unmapped_alignments.push_back(gene_annotation_record);
+				}
+			}
+		}
+	}
+	if (unmapped_alignments.size() > 0) {
+		unmapped_alignments.sort();
+		gene_annotation_record_t gene_annotation_record;
+		gene_annotation_record.contig = unmapped_alignments.begin()->contig;
+		gene_annotation_record.start = unmapped_alignments.begin()->start;
+		gene_annotation_record.end = unmapped_alignments.begin()->end;
+		gene_annotation_record.strand = FORWARD;
+		gene_annotation_record.exonic_length = 10000; //TODO more exact estimation of exonic_length
+		gene_annotation_record.is_dummy = true;
+		gene_annotation_record.is_protein_coding = false;
+		gene_contig_annotation_index_t::iterator next_known_gene = gene_annotation_index[unmapped_alignments.begin()->contig].lower_bound(unmapped_alignments.begin()->end);
+		for (gene_annotation_t::iterator unmapped_alignment = next(unmapped_alignments.begin()); ; ++unmapped_alignment) {
+			// subsume all unmapped alignments in a range of 10kb into a dummy gene with the generic name "contig:start-end"
+			if (unmapped_alignment == unmapped_alignments.end() || // all unmapped alignments have been processed => add last record
+			    gene_annotation_record.end+10000 < unmapped_alignment->start || // current alignment is too far away
+			    (next_known_gene != gene_annotation_index[gene_annotation_record.contig].end() && next_known_gene->first <= unmapped_alignment->start) || // dummy gene must not overlap known genes
+			    unmapped_alignment->contig != gene_annotation_record.contig) { // end of contig reached
+				gene_annotation_record.name = contigs_by_id[gene_annotation_record.contig] + ":" + to_string(static_cast<long long int>(gene_annotation_record.start)) + "-" + to_string(static_cast<long long int>(gene_annotation_record.end));
+				dummy_genes.push_back(gene_annotation_record);
+				if (unmapped_alignment != unmapped_alignments.end()) {
+					gene_annotation_record.contig = unmapped_alignment->contig;
+					gene_annotation_record.start = unmapped_alignment->start;
+					next_known_gene = gene_annotation_index[unmapped_alignment->contig].lower_bound(unmapped_alignment->end);
+				} else {
+					break;
+				}
+			}
+			gene_annotation_record.end = unmapped_alignment->end;
+		}
+	}
+
+	// map yet unmapped alignments to the newly created dummy genes
+	make_annotation_index(dummy_genes, gene_annotation_index); // dummy genes are added to the index of the genes of the reference
+	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
+		for (mates_t::iterator mate = chimeric_alignment->second.begin(); mate != chimeric_alignment->second.end(); ++mate) {
+			if (mate->genes.empty())
+				get_annotation_by_coordinate(mate->contig, mate->start, mate->end, mate->genes, gene_annotation_index);
+		}
+		if (chimeric_alignment->second.size() == 3) // split-read
+			if (chimeric_alignment->second[MATE1].genes.empty()) // copy dummy gene from split-read, if mate1 still has no annotation
+				chimeric_alignment->second[MATE1].genes = chimeric_alignment->second[SPLIT_READ].genes;
+	}
+
+	// assign IDs to dummy genes following those of the reference (see reference_context_t::reference_context_t)
+	unsigned int gene_id = reference.gene_annotation.size();
+	for (gene_annotation_t::iterator gene = dummy_genes.begin(); gene != dummy_genes.end(); ++gene)
+		gene->id = gene_id++;
+
+	// filters which discard reads
+	// the order of the stages is determined by their dependencies (and the order of registration, if there is no dependency)
+	float mate_gap_mean, mate_gap_stddev;
+	int max_mate_gap = options.fragment_length;
+	pipeline_t read_filters;
+
+	read_filters.add_stage("duplicates", "Filtering duplicates", options.filters.at("duplicates"), "",
+		[&]() -> string { return remaining(filter_duplicates(chimeric_alignments)); });
+
+	read_filters.add_stage("uninteresting_contigs", "Filtering mates which do not map to interesting contigs (" + options.interesting_contigs + ")", options.filters.at("uninteresting_contigs") && !reference.interesting_contigs.empty(), "",
+		[&]() -> string { return remaining(filter_uninteresting_contigs(chimeric_alignments, contigs, reference.interesting_contigs)); });
+
+	// the mate gap distribution was estimated from the concordant mates while the alignments were read
+	read_filters.add_stage("mate_gap", "Estimating mate gap distribution", true, "",
+		[&]() -> string {
+			if (fragment_statistics.estimate_mate_gap_distribution(mate_gap_mean, mate_gap_stddev)) {
+				max_mate_gap = max(0, (int) (mate_gap_mean + 3*mate_gap_stddev));
+				return "mean=" + to_log_string(mate_gap_mean) + ", stddev=" + to_log_string(mate_gap_stddev);
+			} else
+				return "";
+		});
+
+	read_filters.add_stage("read_through", "Filtering read-through fragments with a distance <=" + to_log_string(options.min_read_through_distance) + "bp", options.filters.at("read_through"), "mate_gap",
+		[&]() -> string { return remaining(filter_proximal_read_through(chimeric_alignments, options.min_read_through_distance)); });
+
+	read_filters.add_stage("inconsistently_clipped", "Filtering inconsistently clipped mates", options.filters.at("inconsistently_clipped"), "mate_gap",
+		[&]() -> string { return remaining(filter_inconsistently_clipped_mates(chimeric_alignments)); });
+
+	read_filters.add_stage("homopolymer", "Filtering breakpoints adjacent to homopolymers >=" + to_log_string(options.homopolymer_length) + "nt", options.filters.at("homopolymer"), "mate_gap",
+		[&]() -> string { return remaining(filter_homopolymer(chimeric_alignments, options.homopolymer_length, exon_annotation_index)); });
+
+	read_filters.add_stage("small_insert_size", "Filtering fragments with small insert size", options.filters.at("small_insert_size"), "mate_gap",
+		[&]() -> string { return remaining(filter_small_insert_size(chimeric_alignments, 5)); });
+
+	read_filters.add_stage("long_gap", "Filtering alignments with long gaps", options.filters.at("long_gap"), "mate_gap",
+		[&]() -> string { return remaining(filter_long_gap(chimeric_alignments)); });
+
+	read_filters.add_stage("same_gene", "Filtering fragments with both mates in the same gene", options.filters.at("same_gene"), "mate_gap",
+		[&]() -> string { return remaining(filter_same_gene(chimeric_alignments, exon_annotation_index)); });
+
+	read_filters.add_stage("hairpin", "Filtering fusions arising from hairpin structures", options.filters.at("hairpin"), "mate_gap",
+		[&]() -> string { return remaining(filter_hairpin(chimeric_alignments, exon_annotation_index, max_mate_gap)); });
+
+	read_filters.add_stage("mismatches", "Filtering reads with a mismatch p-value <=" + to_log_string(options.mismatch_pvalue_cutoff), options.filters.at("mismatches"), "mate_gap",
+		[&]() -> string { return remaining(filter_mismatches(chimeric_alignments, reference.assembly, reference.interesting_contigs, 0.01, options.mismatch_pvalue_cutoff)); });
+
+	read_filters.add_stage("low_entropy", "Filtering reads with low entropy (k-mer content >=" + to_log_string(options.max_kmer_content*100) + "%)", options.filters.at("low_entropy"), "mate_gap",
+		[&]() -> string { return remaining(filter_low_entropy(chimeric_alignments, 3, options.max_kmer_content)); });
+
+	read_filters.run();
+
+	// when the memory consumption is high, release sequences which are not needed anymore, so that the following steps can reuse the memory
+	memory_threshold_t memory_threshold(options.sequence_release_threshold);
+	if (memory_threshold.is_exceeded() && options.filters.at("duplicates")) {
+		cout << get_time_string() << " Releasing sequences of duplicates" << flush;
+		cout << " (released=" << release_sequences_of_duplicates(chimeric_alignments) << ")" << endl;
+		if (!options.evidence_output_prefix.empty()) // the results are not affected otherwise
+			time_budget.add_degradation("duplicates: sequences of duplicates were not kept, they are missing from the exported evidence", "exceeding the memory threshold");
+	}
+
+	cout << get_time_string() << " Finding fusions and counting supporting reads" << flush;
+	stage_watchdog_t find_fusions_watchdog(time_budget, "find_fusions", 0.2);
+	cout << " (total=" << find_fusions(chimeric_alignments, fusions, exon_annotation_index, max_mate_gap, options.subsampling_threshold, 50, find_fusions_watchdog) << ")" << endl;
+
+	// the coverage is only needed around the breakpoints, so a precomputed coverage track can be loaded now that they are known
+	if (coverage.is_precomputed()) {
+		cout << get_time_string() << " Loading coverage around breakpoints from '" << options.coverage_track_file << "'" << flush;
+		cout << " (windows=" << load_coverage_track(options.coverage_track_file, fusions, contigs, max_mate_gap, coverage) << ")" << endl;
+	}
+
+	// no more fragments are added to the coverage from here on
+	cout << get_time_string() << " Compacting coverage" << flush;
+	coverage.compact();
+	cout << " (memory=" << (coverage.get_allocated_memory() / 1048576) << "MB)" << endl;
+
+	if (memory_threshold.is_exceeded()) {
+		cout << get_time_string() << " Releasing sequences of reads which do not belong to any fusion" << flush;
+		cout << " (released=" << release_sequences_of_unused_reads(chimeric_alignments, fusions) << ")" << endl;
+	}
+
+	// group fusions by gene pair for all steps which compare fusions between the same pair of genes
+	// this must come after all fusions have been found, since the index does not track added/removed fusions
+	fusions_by_gene_pair = new gene_pair_index_t(fusions);
+	gene_pair_index_t& gene_pair_index = *fusions_by_gene_pair;
+
+	// filters which discard (or recover) fusions
+	// the order of the stages is determined by their dependencies (and the order of registration, if there is no dependency)
+	pipeline_t fusion_filters;
+
+	fusion_filters.add_stage("mark_genomic_support", "Marking fusions with support from whole-genome sequencing in '" + options.genomic_breakpoints_file + "'", !options.genomic_breakpoints_file.empty(), "",
+		[&]() -> string { return "marked=" + to_log_string(mark_genomic_support(fusions, options.genomic_breakpoints_file, contigs, options.max_genomic_breakpoint_distance)); });
+
+	fusion_filters.add_stage("merge_adjacent", "Merging adjacent fusion breakpoints", options.filters.at("merge_adjacent"), "",
+		[&]() -> string { return remaining(merge_adjacent_fusions(fusions, 5)); });
+
+	// this step must come after the 'merge_adjacent' filter,
+	// because STAR clips reads supporting the same breakpoints at different position
+	// and that spreads the supporting reads over multiple breakpoints
+	fusion_filters.add_stage("evalue", "Estimating expected number of fusions by random chance (e-value)", true, "merge_adjacent",
+		[&]() -> string { estimate_expected_fusions(fusions, mapped_reads, exon_annotation_index); return ""; });
+
+	fusion_filters.add_stage("non_coding_neighbors", "Filtering fusions with both breakpoints in adjacent non-coding/intergenic regions", options.filters.at("non_coding_neighbors"), "",
+		[&]() -> string { return remaining(filter_non_coding_neighbors(fusions)); });
+
+	fusion_filters.add_stage("intragenic_exonic", "Filtering intragenic fusions with both breakpoints in exonic regions", options.filters.at("intragenic_exonic"), "",
+		[&]() -> string { return remaining(filter_intragenic_both_exonic(fusions, exon_annotation_index, options.exonic_fraction)); });
+
+	// this step must come after e-value calculation,
+	// because fusions with few supporting reads heavily influence the e-value
+	fusion_filters.add_stage("min_support", "Filtering fusions with <" + to_log_string(options.min_support) + " supporting reads", options.filters.at("min_support"), "evalue",
+		[&]() -> string { return remaining(filter_min_support(fusions, options.min_support)); });
+
+	fusion_filters.add_stage("relative_support", "Filtering fusions with an e-value >=" + to_log_string(options.evalue_cutoff), options.filters.at("relative_support"), "evalue",
+		[&]() -> string { return remaining(filter_relative_support(fusions, options.evalue_cutoff)); });
+
+	fusion_filters.add_stage("intronic", "Filtering fusions with both breakpoints in intronic/intergenic regions", options.filters.at("intronic"), "",
+		[&]() -> string { return remaining(filter_both_intronic(fusions)); });
+
+	// this step must come right after the 'relative_support' and 'min_support' filters
+	fusion_filters.add_stage("known_fusions", "Searching for known fusions in '" + options.known_fusions_file + "'", !options.known_fusions_file.empty() && options.filters.at("known_fusions"), "relative_support min_support",
+		[&]() -> string { return remaining(recover_known_fusions(fusions, options.known_fusions_file, reference.gene_names, coverage)); });
+
+	// this step must come after the 'merge_adjacent' filter,
+	// or else adjacent breakpoints will be counted several times
+	fusion_filters.add_stage("pcr_fusions", "Filtering PCR/RT fusions between genes with an expression above the " + to_log_string(options.high_expression_quantile*100) + "% quantile", options.filters.at("pcr_fusions"), "merge_adjacent",
+		[&]() -> string { return remaining(filter_pcr_fusions(fusions, gene_pair_index, chimeric_alignments, options.high_expression_quantile, gene_annotation_index)); });
+
+	// this step must come closely after the 'relative_support' and 'min_support' filters
+	// it must come after the 'pcr_fusions' filter, because it is prone to recovering PCR-mediated fusions
+	fusion_filters.add_stage("spliced", "Searching for fusions with spliced split reads", options.filters.at("spliced"), "relative_support min_support pcr_fusions",
+		[&]() -> string { return remaining(recover_both_spliced(fusions, gene_pair_index, 200)); });
+
+	// this step must come after the 'merge_adjacent' filter,
+	// because merging might yield a different best breakpoint
+	fusion_filters.add_stage("select_best", "Selecting best breakpoints from genes with multiple breakpoints", options.filters.at("select_best"), "merge_adjacent spliced",
+		[&]() -> string { return remaining(select_most_supported_breakpoints(gene_pair_index)); });
+
+	// this step must come after the 'select_best' filter, because it increases the chances of
+	// an event to pass all filters by recovering multiple breakpoints which evidence the same event
+	// moreover, this step must come after all the filters the 'relative_support' and 'min_support' filters
+	// and after the 'pcr_fusions' filter, because it is prone to recovering PCR-mediated fusions
+	fusion_filters.add_stage("many_spliced", "Searching for fusions with >=" + to_log_string(options.min_spliced_events) + " spliced events", options.filters.at("many_spliced"), "select_best relative_support min_support pcr_fusions",
+		[&]() -> string { return remaining(recover_many_spliced(fusions, gene_pair_index, options.min_spliced_events)); });
+
+	fusion_filters.add_stage("confidence_for_no_genomic_support", "Assigning confidence scores to events", !options.genomic_breakpoints_file.empty() && options.filters.at("no_genomic_support"), "many_spliced known_fusions intronic non_coding_neighbors intragenic_exonic",
+		[&]() -> string { assign_confidence(fusions, gene_pair_index, coverage); return ""; });
+
+	// this step must come after assigning confidence scores
+	fusion_filters.add_stage("no_genomic_support", "Filtering low-confidence events with no support from WGS", !options.genomic_breakpoints_file.empty() && options.filters.at("no_genomic_support"), "confidence_for_no_genomic_support",
+		[&]() -> string { return remaining(filter_no_genomic_support(fusions)); });
+
+	// this step must come after the 'select_best' filter, because the 'select_best' filter prefers
+	// soft-clipped breakpoints, which are easier to remove by blacklisting, because they are more recurrent
+	fusion_filters.add_stage("blacklist", "Filtering blacklisted fusions in '" + options.blacklist_file + "'", options.filters.at("blacklist") && !options.blacklist_file.empty(), "select_best",
+		[&]() -> string { return remaining(filter_blacklisted_ranges(fusions, reference.blacklist, options.evalue_cutoff, max_mate_gap)); });
+
+	fusion_filters.add_stage("short_anchor", "Filtering fusions with anchors <=" + to_log_string(options.min_anchor_length) + "nt", options.filters.at("short_anchor"), "select_best",
+		[&]() -> string { return remaining(filter_short_anchor(fusions, options.min_anchor_length)); });
+
+	fusion_filters.add_stage("end_to_end", "Filtering end-to-end fusions with low support", options.filters.at("end_to_end"), "select_best",
+		[&]() -> string { return remaining(filter_end_to_end_fusions(fusions)); });
+
+	fusion_filters.add_stage("no_coverage", "Filtering fusions with no coverage around the breakpoints", options.filters.at("no_coverage"), "select_best",
+		[&]() -> string { return remaining(filter_no_coverage(fusions, coverage, exon_annotation_index, max_mate_gap)); });
+
+	// make kmer indices from gene sequences
+	// only the genes of fusions which passed all cheaper filters are indexed
+	kmer_indices_t kmer_indices;
+	const char kmer_length = 8; // must not be longer than 16 or else conversion to int will fail
+	fusion_filters.add_stage("index_genes", "Indexing gene sequences", options.filters.at("homologs") || options.filters.at("mismappers"), "blacklist short_anchor end_to_end no_coverage no_genomic_support",
+		[&]() -> string { make_kmer_index(fusions, reference.assembly, kmer_length, kmer_indices); return ""; });
+
+	// this step must come near the end, because it is expensive in terms of memory consumption
+	fusion_filters.add_stage("homologs", "Filtering genes with >=" + to_log_string(options.max_homolog_identity*100) + "% identity", options.filters.at("homologs"), "index_genes",
+		[&]() -> string {
+			stage_watchdog_t watchdog(time_budget, "homologs", 0.3);
+			return remaining(filter_homologs(fusions, kmer_indices, kmer_length, reference.assembly, options.max_homolog_identity, 1000, watchdog));
+		});
+
+	// this step must come near the end, because it is expensive in terms of memory and CPU consumption
+	fusion_filters.add_stage("mismappers", "Re-aligning chimeric reads to filter fusions with >=" + to_log_string(options.max_mismapper_fraction*100) + "% mis-mappers", options.filters.at("mismappers"), "index_genes homologs",
+		[&]() -> string {
+			stage_watchdog_t watchdog(time_budget, "mismappers", 0.5);
+			return remaining(filter_mismappers(fusions, kmer_indices, kmer_length, reference.assembly, exon_annotation_index, options.max_mismapper_fraction, max_mate_gap, 30, watchdog));
+		});
+
+	// this step must come after all heuristic filters, to undo them
+	fusion_filters.add_stage("genomic_support", "Searching for fusions with support from WGS", !options.genomic_breakpoints_file.empty() && options.filters.at("genomic_support"), "mark_genomic_support non_coding_neighbors intragenic_exonic min_support relative_support intronic pcr_fusions blacklist short_anchor end_to_end no_coverage homologs mismappers",
+		[&]() -> string { return remaining(recover_genomic_support(fusions)); });
+
+	// the 'select_best' filter needs to be run again, to remove redundant events recovered by the 'genomic_support' and 'many_spliced' filters
+	fusion_filters.add_stage("select_best_after_recovery", "Selecting best breakpoints from genes with multiple breakpoints", options.filters.at("select_best") && (!options.genomic_breakpoints_file.empty() && options.filters.at("genomic_support") || options.filters.at("many_spliced")), "genomic_support many_spliced",
+		[&]() -> string { return remaining(select_most_supported_breakpoints(gene_pair_index)); });
+
+	// this filter must come last, because it should only recover isoforms of fusions which pass all other filters
+	fusion_filters.add_stage("isoforms", "Searching for additional isoforms", options.filters.at("isoforms"), "select_best_after_recovery genomic_support homologs mismappers",
+		[&]() -> string { return remaining(recover_isoforms(gene_pair_index)); });
+
+	fusion_filters.run();
+
+	// this step must come after the 'isoforms' filter, because recovered isoforms need to be scored anew
+	cout << get_time_string() << " Assigning confidence scores to events" << endl << flush;
+	assign_confidence(fusions, gene_pair_index, coverage);
+
+	// convert the fusions into the structure returned to the caller
+	vector<fusion_call_t> fusion_calls;
+	for (gene_pair_index_t::iterator fusion = gene_pair_index.begin(); fusion != gene_pair_index.end(); ++fusion) {
+		if ((**fusion).filter != NULL && !include_discarded)
+			continue;
+		fusion_call_t fusion_call;
+		fusion_call.gene1 = (**fusion).gene1->name;
+		fusion_call.gene2 = (**fusion).gene2->name;
+		fusion_call.contig1 = contigs_by_id[(**fusion).contig1];
+		fusion_call.contig2 = contigs_by_id[(**fusion).contig2];
+		fusion_call.breakpoint1 = (**fusion).breakpoint1 + 1;
+		fusion_call.breakpoint2 = (**fusion).breakpoint2 + 1;
+		fusion_call.direction1 = (**fusion).direction1;
+		fusion_call.direction2 = (**fusion).direction2;
+		fusion_call.split_reads1 = (**fusion).split_reads1;
+		fusion_call.split_reads2 = (**fusion).split_reads2;
+		fusion_call.discordant_mates = (**fusion).discordant_mates;
+		fusion_call.evalue = (**fusion).evalue;
+		fusion_call.confidence = (**fusion).confidence;
+		if ((**fusion).filter != NULL)
+			fusion_call.filter = *(**fusion).filter;
+		fusion_call.fusion = *fusion;
+		fusion_calls.push_back(fusion_call);
+	}
+	return fusion_calls;
+}
+
+void sample_session_t::write_fusions(const string& output_file, const bool write_discarded_fusions) {
+	if (fusions_by_gene_pair == NULL) {
+		cerr << "ERROR: fusions must be called before they can be written." << endl;
+		exit(1);
+	}
+	if (!write_discarded_fusions)
+		write_fusions_to_file(fusions, *fusions_by_gene_pair, output_file, coverage, reference.assembly, gene_annotation_index, exon_annotation_index, contigs_by_id, options.print_supporting_reads, options.print_fusion_sequence, options.print_peptide_sequence, false);
+	else
+		write_fusions_to_file(fusions, *fusions_by_gene_pair, output_file, coverage, reference.assembly, gene_annotation_index, exon_annotation_index, contigs_by_id, options.print_supporting_reads_for_discarded_fusions, options.print_fusion_sequence_for_discarded_fusions, options.print_peptide_sequence_for_discarded_fusions, true);
+}
+
+void sample_session_t::write_evidence(const string& output_prefix) {
+	if (fusions_by_gene_pair == NULL) {
+		cerr << "ERROR: fusions must be called before evidence can be written." << endl;
+		exit(1);
+	}
+	export_evidence(fusions, output_prefix, coverage, reference.assembly, contigs_by_id);
+}
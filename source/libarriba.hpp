@@ -0,0 +1,122 @@
+#ifndef _LIBARRIBA_H
+#define _LIBARRIBA_H 1
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "sam.h"
+#include "common.hpp"
+#include "annotation.hpp"
+#include "filter_blacklisted_ranges.hpp"
+#include "gene_pair_index.hpp"
+#include "options.hpp"
+#include "provisional_fusions.hpp"
+#include "read_chimeric_alignments.hpp"
+#include "read_stats.hpp"
+#include "time_budget.hpp"
+
+using namespace std;
+
+// API to embed fusion detection into other programs:
+// - a reference_context_t holds the data which is independent of the sample (annotation, assembly, blacklist)
+// - a sample_session_t receives the alignments of a sample, either from files or as batches of BAM records
+// - sample_session_t::call_fusions() runs all filters and returns the predicted fusions
+// the command-line tool is a thin wrapper around this API (see arriba.cpp)
+
+// the contigs given by -i (empty, if the filter 'uninteresting_contigs' is disabled)
+contigs_t parse_interesting_contigs(const options_t& options);
+
+// reference data which is loaded once and can be reused for any number of samples
+// the parameters -a, -g, -G, -b, and -i are taken from <options>
+// sessions do not modify the reference, so several sessions may use the same reference at the same time
+class reference_context_t {
+	public:
+		reference_context_t(const options_t& options);
+		contigs_t interesting_contigs;
+		contigs_t contigs; // contigs of the annotation and the assembly; sessions add the contigs of the BAM files to a copy
+		assembly_t assembly;
+		gene_annotation_t gene_annotation;
+		transcript_annotation_t transcript_annotation;
+		exon_annotation_t exon_annotation;
+		unordered_map<string,gene_t> gene_names;
+		gene_annotation_index_t gene_annotation_index;
+		exon_annotation_index_t exon_annotation_index;
+		blacklist_t blacklist;
+};
+
+// a fusion as returned by sample_session_t::call_fusions()
+struct fusion_call_t {
+	string gene1, gene2;
+	string contig1, contig2;
+	position_t breakpoint1, breakpoint2; // 1-based, as in the output file
+	direction_t direction1, direction2;
+	unsigned int split_reads1, split_reads2, discordant_mates;
+	float evalue;
+	confidence_t confidence;
+	string filter; // empty, if the fusion passed all filters
+	const fusion_t* fusion; // all details; valid as long as the session exists
+};
+
+// state of the analysis of a single sample
+// the parameters -x and -c of <options> are ignored; the alignments are passed via the methods below
+class sample_session_t {
+	private:
+		const reference_context_t& reference;
+		const options_t options;
+		time_budget_t own_time_budget;
+		time_budget_t& time_budget;
+		contigs_t contigs;
+		gene_annotation_t dummy_genes; // genes made up for intergenic breakpoints of this sample, in addition to the genes of the reference
+		gene_annotation_index_t gene_annotation_index; // genes of the reference and dummy genes
+		exon_annotation_index_t exon_annotation_index;
+		chimeric_alignments_t chimeric_alignments;
+		unsigned long int mapped_reads;
+		coverage_t coverage;
+		fragment_statistics_t fragment_statistics; // mate gap distribution and strandedness, estimated while the alignments are read
+		bool separate_chimeric_bam_file; // true, if alignments from Chimeric.out.sam were given
+		chimeric_alignment_extractor_t* chimeric_records_extractor;
+		chimeric_alignment_extractor_t* rna_records_extractor;
+		bam1_t* record_buffer;
+		provisional_fusions_t* provisional_fusions; // NULL, unless provisional fusions are reported (-Y)
+		vector<string> contigs_by_id;
+		fusions_t fusions;
+		gene_pair_index_t* fusions_by_gene_pair; // NULL until call_fusions() has found the fusions
+		void finish_chimeric_records();
+		void finish_records();
+	public:
+		sample_session_t(const reference_context_t& reference, const options_t& options);
+		// the time budget (-t) may be shared with steps outside of the session, e.g., loading the reference
+		sample_session_t(const reference_context_t& reference, const options_t& options, time_budget_t& time_budget);
+		~sample_session_t();
+
+		// alignments from files
+		// Chimeric.out.sam must be given before Aligned.out.bam, if STAR was run with '--chimOutType SeparateSAMold'
+		unsigned int read_chimeric_bam_file(const string& bam_file_path);
+		unsigned int read_rna_bam_file(const string& bam_file_path);
+		// several files are read concurrently as if they were concatenated, e.g., the alignments of the individual lanes of a sample
+		unsigned int read_chimeric_bam_files(const vector<string>& bam_file_paths);
+		unsigned int read_rna_bam_files(const vector<string>& bam_file_paths);
+		// scatter/gather (see partial_state.hpp)
+		// in the scatter step, only the names of the reads of Chimeric.out.sam which the shard of Aligned.out.bam needs are loaded
+		unsigned int read_chimeric_bam_shard(const vector<string>& bam_file_paths, const string& rna_bam_file_path, const unsigned int shard, const unsigned int shards);
+		unsigned int read_rna_bam_shard(const string& bam_file_path, const unsigned int shard, const unsigned int shards, const string& partial_state_file);
+		unsigned int merge_partial_states(const vector<string>& partial_state_files);
+
+		// alignments from memory, e.g., straight from an aligner
+		// the records of a file may be passed in several batches, but they must be in the order of the file and refer to the same header
+		// the records are copied, the caller retains ownership
+		void add_chimeric_records(const bam_hdr_t* bam_header, const bam1_t* const* records, const unsigned int count);
+		void add_rna_records(const bam_hdr_t* bam_header, const bam1_t* const* records, const unsigned int count);
+
+		// runs all filters and returns the fusions (only those which passed all filters, unless <include_discarded> is set)
+		// may only be called once all alignments have been added
+		vector<fusion_call_t> call_fusions(const bool include_discarded = false);
+
+		// write the fusions found by call_fusions() in the same format as the command-line tool
+		void write_fusions(const string& output_file, const bool write_discarded_fusions);
+
+		// write the supporting reads and the coverage around the breakpoints of the fusions which passed all filters (see export_evidence.hpp)
+		void write_evidence(const string& output_prefix);
+};
+
+#endif /* _LIBARRIBA_H */
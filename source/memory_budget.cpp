@@ -0,0 +1,56 @@
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "common.hpp"
+#include "progress.hpp"
+#include "memory_budget.hpp"
+
+using namespace std;
+
+memory_threshold_t::memory_threshold_t(const unsigned int threshold_in_megabytes): threshold(threshold_in_megabytes * 1048576ULL) {
+}
+
+bool memory_threshold_t::is_exceeded() const {
+	return threshold > 0 && get_resident_memory() > threshold;
+}
+
+// swapping with an empty string frees the memory, whereas clear() keeps the capacity
+void release_sequences(mates_t& mates) {
+	for (mates_t::iterator mate = mates.begin(); mate != mates.end(); ++mate)
+		string().swap(mate->sequence);
+}
+
+unsigned long int release_sequences_of_duplicates(chimeric_alignments_t& chimeric_alignments) {
+	unsigned long int released = 0;
+	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
+		if (chimeric_alignment->second.filter == FILTERS.at("duplicates")) {
+			release_sequences(chimeric_alignment->second);
+			released++;
+		}
+	}
+	return released;
+}
+
+void add_used_reads(const vector<chimeric_alignments_t::iterator>& reads, unordered_set<const mates_t*>& used_reads) {
+	for (auto read = reads.begin(); read != reads.end(); ++read)
+		used_reads.insert(&(**read).second);
+}
+
+unsigned long int release_sequences_of_unused_reads(chimeric_alignments_t& chimeric_alignments, const fusions_t& fusions) {
+
+	unordered_set<const mates_t*> used_reads;
+	for (fusions_t::const_iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
+		add_used_reads(fusion->second.split_read1_list, used_reads);
+		add_used_reads(fusion->second.split_read2_list, used_reads);
+		add_used_reads(fusion->second.discordant_mate_list, used_reads);
+	}
+
+	unsigned long int released = 0;
+	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
+		if (used_reads.find(&chimeric_alignment->second) == used_reads.end() && !chimeric_alignment->second[MATE1].sequence.empty()) {
+			release_sequences(chimeric_alignment->second);
+			released++;
+		}
+	}
+	return released;
+}
@@ -0,0 +1,32 @@
+#ifndef _MEMORY_BUDGET_H
+#define _MEMORY_BUDGET_H 1
+
+#include "common.hpp"
+
+using namespace std;
+
+// the chimeric reads make up most of the memory consumption, but they cannot be processed in partitions,
+// because every fusion-level step and the output refer to the reads of all fusions;
+// instead, when the resident memory exceeds a threshold, the sequences of reads which are no longer needed are released
+// (best effort), such that the following steps can reuse the memory; this does not lower the peak memory consumption,
+// which is reached while the alignments are read, and the memory is not necessarily returned to the operating system
+class memory_threshold_t {
+	private:
+		unsigned long long int threshold; // in bytes, 0 means never release anything
+	public:
+		memory_threshold_t(const unsigned int threshold_in_megabytes);
+		bool is_exceeded() const;
+};
+
+// the sequences of duplicates are only needed to export the evidence (-W), since the other steps skip duplicates
+// and the output takes the read length from the CIGAR string (see alignment_t::sequence_length());
+// returns the number of reads whose sequence was released
+unsigned long int release_sequences_of_duplicates(chimeric_alignments_t& chimeric_alignments);
+
+// the sequences of reads which are not listed as supporting reads (or discarded reads) of any fusion,
+// e.g., because they exceed the subsampling threshold (-U), are never needed after finding fusions;
+// the reads themselves are kept, because the filter 'pcr_fusions' counts them
+// returns the number of reads whose sequence was released
+unsigned long int release_sequences_of_unused_reads(chimeric_alignments_t& chimeric_alignments, const fusions_t& fusions);
+
+#endif /* _MEMORY_BUDGET_H */
@@ -0,0 +1,125 @@
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include "sam.h"
+#include "nucleotides.hpp"
+
+using namespace std;
+
+const unsigned char NUCLEOTIDE_COMPLEMENT[256] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+	' ', '!', '"', '#', '$', '%', '&', 39, '(', ')', '*', '+', ',', '-', '.', '/',
+	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', ':', ';', '<', '=', '>', '?',
+	'@', 'T', 'B', 'G', 'D', 'E', 'F', 'C', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+	'P', 'Q', 'R', 'S', 'A', 'U', 'V', 'W', 'X', 'Y', 'Z', ']', 92, '[', '^', '_',
+	'`', 't', 'b', 'g', 'd', 'e', 'f', 'c', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+	'p', 'q', 'r', 's', 'a', 'u', 'v', 'w', 'x', 'y', 'z', '{', '|', '}', '~', 127,
+	128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142, 143,
+	144, 145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156, 157, 158, 159,
+	160, 161, 162, 163, 164, 165, 166, 167, 168, 169, 170, 171, 172, 173, 174, 175,
+	176, 177, 178, 179, 180, 181, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191,
+	192, 193, 194, 195, 196, 197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207,
+	208, 209, 210, 211, 212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222, 223,
+	224, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237, 238, 239,
+	240, 241, 242, 243, 244, 245, 246, 247, 248, 249, 250, 251, 252, 253, 254, 255,
+};
+
+const unsigned char NUCLEOTIDE_TO_2BIT[256] = {
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 2, 3, 3, 3, 1, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+};
+
+kmer_as_int_t kmer_to_int(const string& kmer, const string::size_type position, const char kmer_length) {
+	const char* bases = kmer.c_str() + position;
+	kmer_as_int_t result = 0;
+	for (int i = 0; i < kmer_length; ++i)
+		result = (result << 2) | NUCLEOTIDE_TO_2BIT[(unsigned char) bases[i]];
+	return result;
+}
+
+// every byte of a BAM sequence holds two bases
+struct bam_sequence_decoder_t {
+	char bases[256][2];
+	bam_sequence_decoder_t() {
+		for (unsigned int byte = 0; byte < 256; ++byte) {
+			bases[byte][0] = seq_nt16_str[byte >> 4];
+			bases[byte][1] = seq_nt16_str[byte & 15];
+		}
+	}
+};
+
+void decode_bam_sequence(const uint8_t* bam_sequence, const int length, string& sequence) {
+	static const bam_sequence_decoder_t decoder;
+	sequence.resize(length);
+	for (int i = 0; i + 1 < length; i += 2)
+		memcpy(&sequence[i], decoder.bases[bam_sequence[i/2]], 2);
+	if (length % 2 == 1) // the last byte holds only one base
+		sequence[length-1] = decoder.bases[bam_sequence[length/2]][0];
+}
+
+void reverse_complement(const string& dna, string& reverse_complement) {
+	reverse_complement.resize(dna.length());
+	string::size_type last = dna.length() - 1;
+	for (string::size_type i = 0; i < dna.length(); ++i)
+		reverse_complement[last - i] = NUCLEOTIDE_COMPLEMENT[(unsigned char) dna[i]];
+}
+
+const uint64_t LOW_BITS = 0x7f7f7f7f7f7f7f7fULL;
+const uint64_t N_BASES = 0x4e4e4e4e4e4e4e4eULL; // 'N' in every byte
+
+// set the highest bit of every byte of <word> which is zero and clear all other bits
+inline uint64_t find_zero_bytes(const uint64_t word) {
+	return ~(((word & LOW_BITS) + LOW_BITS) | word | LOW_BITS);
+}
+
+inline uint64_t load_word(const char* bases) {
+	uint64_t word;
+	memcpy(&word, bases, sizeof(word)); // memcpy avoids unaligned access
+	return word;
+}
+
+unsigned int count_matching_bases(const char* x, const char* y, const unsigned int length) {
+	unsigned int matches = 0;
+	unsigned int i = 0;
+	for (/* i = 0 */; i + 8 <= length; i += 8)
+		matches += __builtin_popcountll(find_zero_bytes(load_word(x + i) ^ load_word(y + i)));
+	for (/* remaining bases */; i < length; ++i)
+		if (x[i] == y[i])
+			++matches;
+	return matches;
+}
+
+unsigned int count_mismatching_bases(const char* read, const char* reference, const unsigned int length, unsigned int& compared) {
+	unsigned int mismatches = 0;
+	unsigned int i = 0;
+	for (/* i = 0 */; i + 8 <= length; i += 8) {
+		uint64_t read_word = load_word(read + i);
+		uint64_t n_bases = find_zero_bytes(read_word ^ N_BASES);
+		uint64_t matches = find_zero_bytes(read_word ^ load_word(reference + i));
+		compared += 8 - __builtin_popcountll(n_bases);
+		mismatches += __builtin_popcountll(~(matches | n_bases) & ~LOW_BITS);
+	}
+	for (/* remaining bases */; i < length; ++i) {
+		if (read[i] != 'N') {
+			if (read[i] != reference[i])
+				++mismatches;
+			++compared;
+		}
+	}
+	return mismatches;
+}
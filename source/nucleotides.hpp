@@ -0,0 +1,43 @@
+#ifndef _NUCLEOTIDES_H
+#define _NUCLEOTIDES_H 1
+
+#include <stdint.h>
+#include <string>
+
+using namespace std;
+
+// kernels for the operations on nucleotide sequences which are performed in the hot loops of the filters
+// lookups are table-driven and comparisons process 8 bases per 64-bit word
+
+// complementary base of every character; characters other than A, C, G, T (upper and lower case) and brackets map to themselves
+extern const unsigned char NUCLEOTIDE_COMPLEMENT[256];
+
+// 2-bit code of every base for k-mer encoding: T=0, G=1, C=2, anything else=3
+extern const unsigned char NUCLEOTIDE_TO_2BIT[256];
+
+typedef unsigned int kmer_as_int_t; // represent kmer as integer (up to 16 bases)
+
+inline kmer_as_int_t kmer_mask(const char kmer_length) {
+	return (kmer_length >= 16) ? ~((kmer_as_int_t) 0) : (((kmer_as_int_t) 1) << (2 * kmer_length)) - 1;
+}
+
+// shift the next base into a k-mer, so that the k-mer at the next position need not be encoded from scratch
+inline kmer_as_int_t roll_kmer(const kmer_as_int_t kmer, const char next_base, const kmer_as_int_t mask) {
+	return ((kmer << 2) | NUCLEOTIDE_TO_2BIT[(unsigned char) next_base]) & mask;
+}
+
+kmer_as_int_t kmer_to_int(const string& kmer, const string::size_type position, const char kmer_length);
+
+// convert the 4-bit encoded sequence of a BAM record to a string (two bases per lookup)
+void decode_bam_sequence(const uint8_t* bam_sequence, const int length, string& sequence);
+
+void reverse_complement(const string& dna, string& reverse_complement);
+
+// number of positions at which <x> and <y> are identical
+unsigned int count_matching_bases(const char* x, const char* y, const unsigned int length);
+
+// number of positions at which <read> and <reference> differ, ignoring positions at which the read has an N;
+// the number of positions which were compared is added to <compared>
+unsigned int count_mismatching_bases(const char* read, const char* reference, const unsigned int length, unsigned int& compared);
+
+#endif /* _NUCLEOTIDES_H */
@@ -47,6 +47,15 @@ bool output_directory_exists(const string& output_file) {
 	return result;
 }
 
+vector<string> split_file_list(const string& file_list) {
+	vector<string> files;
+	istringstream iss(file_list);
+	string file;
+	while (getline(iss, file, ','))
+		files.push_back(file);
+	return files;
+}
+
 bool validate_int(const char* optarg, int& value, const int min_value, const int max_value) {
 	value = atoi(optarg);
 	if (string(optarg) != string("0") && value == 0)
@@ -78,6 +87,7 @@ options_t get_default_options() {
 		options.filters[i->first] = true;
 	options.evalue_cutoff = 0.3;
 	options.min_support = 2;
+	options.provisional_min_support = 10;
 	options.max_mismapper_fraction = 0.8;
 	options.max_homolog_identity = 0.3;
 	options.min_anchor_length = 23;
@@ -99,6 +109,13 @@ options_t get_default_options() {
 	options.subsampling_threshold = 300;
 	options.high_expression_quantile = 0.998;
 	options.exonic_fraction = 0.2;
+	options.estimation_sample_size = 0;
+	options.time_budget = 0;
+	options.shard = 0;
+	options.shards = 0;
+	options.read_ahead_depth = 0;
+	options.sequence_release_threshold = 0;
+	options.progress_interval = 0;
 
 	return options;
 }
@@ -129,10 +146,13 @@ void print_usage() {
 	                  "generated by STAR (Chimeric.out.sam). This parameter is only required, "
 	                  "if STAR was run with the parameter '--chimOutType SeparateSAMold'. "
 	                  "When STAR was run with the parameter '--chimOutType WithinBAM', it "
-	                  "suffices to pass the parameter -x to Arriba and -c can be omitted.")
+	                  "suffices to pass the parameter -x to Arriba and -c can be omitted. "
+	                  "Multiple files can be given as a comma-separated list (see -x).")
 	     << wrap_help("-x FILE", "File in SAM/BAM/CRAM format with main alignments as "
 	                  "generated by STAR (Aligned.out.sam). Arriba extracts candidate reads "
-	                  "from this file.")
+	                  "from this file. When the lanes of a sample were aligned separately, "
+	                  "the files can be given as a comma-separated list. They are read "
+	                  "concurrently and the result is the same as if they were merged.")
 	     << wrap_help("-g FILE", "GTF file with gene annotation. The file may be gzip-compressed.")
 	     << wrap_help("-G GTF_FEATURES", "Comma-/space-separated list of names of GTF features.\n"
 	                  "Default: " + default_options.gtf_features)
@@ -148,6 +168,24 @@ void print_usage() {
 	                  "separated by tabs.")
 	     << wrap_help("-o FILE", "Output file with fusions that have passed all filters.")
 	     << wrap_help("-O FILE", "Output file with fusions that were discarded due to filtering.")
+	     << wrap_help("-W FILE_PREFIX", "Write the alignments supporting the fusions which passed "
+	                  "all filters to FILE_PREFIX.bam (sorted by coordinate and indexed) and "
+	                  "the coverage around their breakpoints to FILE_PREFIX.coverage.bedGraph. "
+	                  "These files can be passed to the visualization script instead of the "
+	                  "complete BAM file.")
+	     << wrap_help("-Y FILE", "Output file with provisional fusions. While the alignments "
+	                  "are being read, the chimeric reads supporting the known fusions (-k) are "
+	                  "counted. As soon as a known fusion is supported by the number of reads given "
+	                  "by -y, a record with a timestamp is appended to this file. The records are "
+	                  "not filtered. The final result is still written to the output file (-o).")
+	     << wrap_help("-y MIN_SUPPORTING_READS", "Minimum number of chimeric reads "
+	                  "for a known fusion to be reported as a provisional fusion (-Y). "
+	                  "Default: " + to_string(static_cast<long long unsigned int>(default_options.provisional_min_support)))
+	     << wrap_help("-C FILE", "Coverage track in bedGraph format (e.g., from mosdepth or "
+	                  "bedtools genomecov). If given, the coverage is not computed from the normal "
+	                  "reads, but loaded from this file around the breakpoints of the candidate fusions. "
+	                  "If the file is compressed with bgzip and indexed with tabix, only these regions "
+	                  "are read. Default: compute the coverage from the alignments")
 	     << wrap_help("-d FILE", "Tab-separated file with coordinates of structural variants "
 	                  "found using whole-genome sequencing data. These coordinates serve to "
 	                  "increase sensitivity towards weakly expressed fusions and to eliminate "
@@ -234,6 +272,51 @@ void print_usage() {
 	                  "identifiers of the reads which support the fusion. The identifiers "
 	                  "are separated by commas. Specify the flag twice to also print the read "
 	                  "identifiers to the file containing discarded fusions (-O). Default: " + string((default_options.print_supporting_reads) ? "on" : "off"))
+	     << wrap_help("-t SECONDS", "Time budget for the entire run. When a step is projected to "
+	                  "take longer than its share of the remaining time, it switches to a cheaper mode: "
+	                  "finding fusions subsamples supporting reads more aggressively, the 'homologs' filter "
+	                  "is only applied to the fusions with the most supporting reads, and the 'mismappers' "
+	                  "filter re-aligns only a sample of the reads of each fusion. Such degradations are "
+	                  "reported in the log and in the file <output file>.degradations.txt. Default: unlimited")
+	     << wrap_help("-N MEGABYTES", "Release the sequences of reads which are not needed anymore "
+	                  "(best effort), when the memory consumption exceeds the given number of megabytes "
+	                  "after the read-level filters or after finding fusions. This is not a memory limit: "
+	                  "the peak is reached while the alignments are read. The results are not affected, "
+	                  "but the duplicates exported by -W lack their sequence, which is reported like the "
+	                  "degradations of -t. Default: off")
+	     << wrap_help("-n SAMPLE_SIZE", "Dry run: instead of searching for fusions, draw a sample of "
+	                  "the given number of alignments from the input files, predict the number of reads, "
+	                  "the number of chimeric reads, the peak memory consumption, and the runtime of the "
+	                  "main steps, and print the estimates in JSON format. If the BAM file is indexed, "
+	                  "the alignments are sampled from positions across the entire genome, otherwise the "
+	                  "first alignments of the file are sampled. Only the parameter -x is mandatory "
+	                  "in this mode. A sample size of 1000000 is recommended.")
+	     << wrap_help("-j SHARD/SHARDS", "Scatter step: read only the given shard of the alignments "
+	                  "(-x), e.g., 2/8 for the second of eight shards, and write the partial state to the "
+	                  "file given by -Z instead of searching for fusions. If the BAM file is indexed, every "
+	                  "shard reads only a range of the genome, otherwise the reads are distributed among "
+	                  "the shards by read name. The chimeric alignments (-c) are parsed by the gather step "
+	                  "only; every shard scans the file for the names of its reads, which means reading the "
+	                  "whole file in every shard. All other parameters must be the same for all shards and "
+	                  "the gather step (-J).")
+	     << wrap_help("-Z PARTIAL_STATE", "Scatter step: output file to which the partial state of "
+	                  "the shard (-j) is written. The output file (-o) is not needed in this mode.")
+	     << wrap_help("-J PARTIAL_STATES", "Gather step: merge the comma-separated list of partial "
+	                  "states written by the scatter step (-j) and search for fusions. The result is "
+	                  "the same as if a single process had read the alignments. The parameter -x "
+	                  "is not needed in this mode.")
+	     << wrap_help("-B MEGABYTES", "Read the input files ahead of the parser in a background "
+	                  "thread, up to the given number of megabytes. This hides the latency of network "
+	                  "file systems. A value of 0 disables read-ahead. "
+	                  "Default: " + ((default_options.read_ahead_depth > 0) ? to_string(static_cast<long long unsigned int>(default_options.read_ahead_depth)) : string("off")))
+	     << wrap_help("-p SECONDS", "Report the progress of long-running steps at the given "
+	                  "interval: how much of the alignments has been read, the number of reads per "
+	                  "second, the fraction of chimeric reads, and the memory usage while reading the "
+	                  "alignments, as well as the number of fusions processed by the filters 'mismappers' "
+	                  "and 'homologs' and by the output. The reports are written to stderr or to the "
+	                  "status file given by -l. Default: no progress reports")
+	     << wrap_help("-l FILE", "Status file for the progress reports (-p). The file is overwritten "
+	                  "with the latest report, such that it always reflects the current state of the run.")
 	     << wrap_help("-h", "Print help and exit.")
 	     << "For more information or help, visit: " << HELP_CONTACT << endl
 	     << "The user manual is available at: " << MANUAL_URL << endl;
@@ -253,26 +336,34 @@ options_t parse_arguments(int argc, char **argv) {
 	opterr = 0;
 	int c;
 	string junction_suffix(".junction");
-	while ((c = getopt(argc, argv, "c:x:d:g:G:o:O:a:b:k:s:i:f:E:S:m:L:H:D:R:A:M:K:V:F:U:Q:e:TPIh")) != -1) {
+	while ((c = getopt(argc, argv, "c:x:d:g:G:o:O:W:Y:y:a:b:k:s:i:f:E:S:m:L:H:D:R:A:M:K:V:F:U:Q:e:n:t:N:j:Z:J:B:p:l:C:TPIh")) != -1) {
 
 		switch (c) {
 			case 'c':
 				options.chimeric_bam_file = optarg;
-				if (access(options.chimeric_bam_file.c_str(), R_OK) != 0) {
-					cerr << "ERROR: File '" << options.chimeric_bam_file << "' not found." << endl;
-					exit(1);
-				}
-				if (options.chimeric_bam_file.size() >= junction_suffix.size() &&
-				    options.chimeric_bam_file.substr(options.chimeric_bam_file.size() - junction_suffix.size()) == junction_suffix) {
-					cerr << "WARNING: It seems you passed the chimeric junction file ('Chimeric.out.junction') to the parameter -c. However, this parameter takes the chimeric alignments file ('Chimeric.out.sam') as input." << endl;
-					exit(1);
+				{
+					vector<string> chimeric_bam_files = split_file_list(options.chimeric_bam_file);
+					for (auto chimeric_bam_file = chimeric_bam_files.begin(); chimeric_bam_file != chimeric_bam_files.end(); ++chimeric_bam_file) {
+						if (access(chimeric_bam_file->c_str(), R_OK) != 0) {
+							cerr << "ERROR: File '" << *chimeric_bam_file << "' not found." << endl;
+							exit(1);
+						}
+						if (chimeric_bam_file->size() >= junction_suffix.size() &&
+						    chimeric_bam_file->substr(chimeric_bam_file->size() - junction_suffix.size()) == junction_suffix) {
+							cerr << "WARNING: It seems you passed the chimeric junction file ('Chimeric.out.junction') to the parameter -c. However, this parameter takes the chimeric alignments file ('Chimeric.out.sam') as input." << endl;
+							exit(1);
+						}
+					}
 				}
 				break;
 			case 'x': {
 				options.rna_bam_file = optarg;
-				if (access(options.rna_bam_file.c_str(), R_OK) != 0) {
-					cerr << "ERROR: File '" << options.rna_bam_file << "' not found." << endl;
-					exit(1);
+				vector<string> rna_bam_files = split_file_list(options.rna_bam_file);
+				for (auto rna_bam_file = rna_bam_files.begin(); rna_bam_file != rna_bam_files.end(); ++rna_bam_file) {
+					if (access(rna_bam_file->c_str(), R_OK) != 0) {
+						cerr << "ERROR: File '" << *rna_bam_file << "' not found." << endl;
+						exit(1);
+					}
 				}
 				break;
 			}
@@ -314,6 +405,26 @@ options_t parse_arguments(int argc, char **argv) {
 					exit(1);
 				}
 				break;
+			case 'W':
+				options.evidence_output_prefix = optarg;
+				if (!output_directory_exists(options.evidence_output_prefix)) {
+					cerr << "ERROR: Parent directory of output file '" << options.evidence_output_prefix << "' does not exist." << endl;
+					exit(1);
+				}
+				break;
+			case 'Y':
+				options.provisional_output_file = optarg;
+				if (!output_directory_exists(options.provisional_output_file)) {
+					cerr << "ERROR: Parent directory of output file '" << options.provisional_output_file << "' does not exist." << endl;
+					exit(1);
+				}
+				break;
+			case 'y':
+				if (!validate_int(optarg, options.provisional_min_support, 1)) {
+					cerr << "ERROR: " << "Invalid argument to -" << ((char) c) << "." << endl;
+					exit(1);
+				}
+				break;
 			case 'a':
 				options.assembly_file = optarg;
 				if (access(options.assembly_file.c_str(), R_OK) != 0) {
@@ -321,11 +432,15 @@ options_t parse_arguments(int argc, char **argv) {
 					exit(1);
 				}
 				// when CRAM files are used, the FastA file must be indexed
-				if (options.rna_bam_file.size() >= 5 && options.rna_bam_file.substr(options.rna_bam_file.size()-5) == ".cram")
-					if (access((options.assembly_file + ".fai").c_str(), R_OK) != 0) {
-						cerr << "ERROR: Index for '" << options.assembly_file << "' not found." << endl;
-						exit(1);
-					}
+				{
+					vector<string> rna_bam_files = split_file_list(options.rna_bam_file);
+					for (auto rna_bam_file = rna_bam_files.begin(); rna_bam_file != rna_bam_files.end(); ++rna_bam_file)
+						if (rna_bam_file->size() >= 5 && rna_bam_file->substr(rna_bam_file->size()-5) == ".cram")
+							if (access((options.assembly_file + ".fai").c_str(), R_OK) != 0) {
+								cerr << "ERROR: Index for '" << options.assembly_file << "' not found." << endl;
+								exit(1);
+							}
+				}
 				break;
 			case 'b':
 				options.blacklist_file = optarg;
@@ -467,6 +582,82 @@ options_t parse_arguments(int argc, char **argv) {
 					exit(1);
 				}
 				break;
+			case 'n':
+				if (!validate_int(optarg, options.estimation_sample_size, 1)) {
+					cerr << "ERROR: " << "Argument to -" << ((char) c) << " must be an integer greater than 0." << endl;
+					exit(1);
+				}
+				break;
+			case 't':
+				if (!validate_int(optarg, options.time_budget, 1)) {
+					cerr << "ERROR: " << "Argument to -" << ((char) c) << " must be an integer greater than 0." << endl;
+					exit(1);
+				}
+				break;
+			case 'N':
+				if (!validate_int(optarg, options.sequence_release_threshold, 1)) {
+					cerr << "ERROR: " << "Argument to -" << ((char) c) << " must be an integer greater than 0." << endl;
+					exit(1);
+				}
+				break;
+			case 'B':
+				if (!validate_int(optarg, options.read_ahead_depth, 0, 1024*1024)) {
+					cerr << "ERROR: " << "Argument to -" << ((char) c) << " must be an integer between 0 and " << 1024*1024 << "." << endl;
+					exit(1);
+				}
+				break;
+			case 'p':
+				if (!validate_int(optarg, options.progress_interval, 1)) {
+					cerr << "ERROR: " << "Argument to -" << ((char) c) << " must be an integer greater than 0." << endl;
+					exit(1);
+				}
+				break;
+			case 'l':
+				options.progress_file = optarg;
+				if (!output_directory_exists(options.progress_file)) {
+					cerr << "ERROR: Parent directory of output file '" << options.progress_file << "' does not exist." << endl;
+					exit(1);
+				}
+				break;
+			case 'C':
+				options.coverage_track_file = optarg;
+				if (access(options.coverage_track_file.c_str(), R_OK) != 0) {
+					cerr << "ERROR: File '" << options.coverage_track_file << "' not found." << endl;
+					exit(1);
+				}
+				break;
+			case 'j':
+				{
+					istringstream iss(optarg);
+					char slash = 0;
+					int shard = 0, shards = 0;
+					if (!(iss >> shard >> slash >> shards) || !iss.eof() || slash != '/' || shards < 1 || shard < 1 || shard > shards) {
+						cerr << "ERROR: " << "Argument to -" << ((char) c) << " must be of the form SHARD/SHARDS, where 1 <= SHARD <= SHARDS." << endl;
+						exit(1);
+					}
+					options.shard = shard - 1;
+					options.shards = shards;
+				}
+				break;
+			case 'Z':
+				options.partial_state_output_file = optarg;
+				if (!output_directory_exists(options.partial_state_output_file)) {
+					cerr << "ERROR: Parent directory of output file '" << options.partial_state_output_file << "' does not exist." << endl;
+					exit(1);
+				}
+				break;
+			case 'J':
+				options.partial_state_files = optarg;
+				{
+					vector<string> partial_state_files = split_file_list(options.partial_state_files);
+					for (auto partial_state_file = partial_state_files.begin(); partial_state_file != partial_state_files.end(); ++partial_state_file) {
+						if (access(partial_state_file->c_str(), R_OK) != 0) {
+							cerr << "ERROR: File '" << *partial_state_file << "' not found." << endl;
+							exit(1);
+						}
+					}
+				}
+				break;
 			case 'T':
 				if (!options.print_fusion_sequence)
 					options.print_fusion_sequence = true;
@@ -491,7 +682,7 @@ options_t parse_arguments(int argc, char **argv) {
 				break;
 			default:
 				switch (optopt) {
-					case 'c': case 'x': case 'd': case 'g': case 'G': case 'o': case 'O': case 'a': case 'k': case 'b': case 'i': case 'f': case 'E': case 's': case 'm': case 'H': case 'D': case 'R': case 'A': case 'M': case 'K': case 'V': case 'F': case 'S': case 'U': case 'Q':
+					case 'c': case 'x': case 'd': case 'g': case 'G': case 'o': case 'O': case 'a': case 'k': case 'b': case 'i': case 'f': case 'E': case 's': case 'm': case 'H': case 'D': case 'R': case 'A': case 'M': case 'K': case 'V': case 'F': case 'S': case 'U': case 'Q': case 'n': case 't': case 'N': case 'j': case 'Z': case 'J': case 'W': case 'Y': case 'y': case 'B': case 'p': case 'l': case 'C':
 						cerr << "ERROR: " << "Option -" << ((char) optopt) << " requires an argument." << endl;
 						exit(1);
 						break;
@@ -515,15 +706,54 @@ options_t parse_arguments(int argc, char **argv) {
 		print_usage();
 		exit(1);
 	}
-	if (options.rna_bam_file.empty()) {
+	if (options.shards > 0 && !options.partial_state_files.empty()) {
+		cerr << "ERROR: Options -j and -J are mutually exclusive." << endl;
+		exit(1);
+	}
+	if (options.shards > 0 && options.partial_state_output_file.empty()) {
+		cerr << "ERROR: Option -j requires an output file for the partial state (-Z)." << endl;
+		exit(1);
+	}
+	if (options.shards == 0 && !options.partial_state_output_file.empty()) {
+		cerr << "ERROR: Option -Z can only be used in the scatter step (-j)." << endl;
+		exit(1);
+	}
+	if ((options.shards > 0 || options.estimation_sample_size > 0) && split_file_list(options.rna_bam_file).size() > 1) {
+		cerr << "ERROR: Options -j and -n accept only a single file for -x." << endl;
+		exit(1);
+	}
+	if (options.estimation_sample_size > 0 && split_file_list(options.chimeric_bam_file).size() > 1) {
+		cerr << "ERROR: Option -n accepts only a single file for -c." << endl;
+		exit(1);
+	}
+	if (options.shards > 0 && !options.evidence_output_prefix.empty()) {
+		cerr << "ERROR: Options -j and -W are mutually exclusive, evidence can only be written by the gather step (-J)." << endl;
+		exit(1);
+	}
+	if ((options.shards > 0 || !options.partial_state_files.empty()) && !options.provisional_output_file.empty()) {
+		cerr << "ERROR: Option -Y cannot be combined with -j or -J, provisional fusions are only reported while the alignments are read in a single process." << endl;
+		exit(1);
+	}
+	if (!options.progress_file.empty() && options.progress_interval == 0) {
+		cerr << "ERROR: Option -l requires progress reports to be enabled (-p)." << endl;
+		exit(1);
+	}
+
+	if (!options.provisional_output_file.empty() && options.known_fusions_file.empty()) {
+		cerr << "ERROR: Option -Y requires a list of known fusions (-k)." << endl;
+		exit(1);
+	}
+	if (options.rna_bam_file.empty() && (options.partial_state_files.empty() || options.estimation_sample_size > 0)) {
 		cerr << "ERROR: Missing mandatory option: -x" << endl;
 		exit(1);
 	}
+	if (options.estimation_sample_size > 0)
+		return options; // a dry run needs only the alignments
 	if (options.gene_annotation_file.empty()) {
 		cerr << "ERROR: Missing mandatory option: -g" << endl;
 		exit(1);
 	}
-	if (options.output_file.empty()) {
+	if (options.output_file.empty() && options.shards == 0) { // the scatter step writes only the partial state
 		cerr << "ERROR: Missing mandatory option: -o" << endl;
 		exit(1);
 	}
@@ -5,6 +5,7 @@
 #include <climits>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 using namespace std;
 
@@ -16,6 +17,9 @@ string wrap_help(const string& option, const string& text, const unsigned short
 
 bool output_directory_exists(const string& output_file);
 
+// parameters which take several files expect them to be separated by commas
+vector<string> split_file_list(const string& file_list);
+
 bool validate_int(const char* optarg, int& value, const int min_value = INT_MIN, const int max_value = INT_MAX);
 bool validate_int(const char* optarg, unsigned int& value, const unsigned int min_value = 0, const unsigned int max_value = INT_MAX);
 bool validate_float(const char* optarg, float& value, const float min_value = FLT_MIN, const float max_value = FLT_MAX);
@@ -30,6 +34,9 @@ struct options_t {
 	string known_fusions_file;
 	string output_file;
 	string discarded_output_file;
+	string evidence_output_prefix;
+	string provisional_output_file;
+	unsigned int provisional_min_support;
 	string assembly_file;
 	string blacklist_file;
 	string interesting_contigs;
@@ -56,8 +63,21 @@ struct options_t {
 	unsigned int subsampling_threshold;
 	float high_expression_quantile;
 	float exonic_fraction;
+	unsigned int estimation_sample_size; // 0 = no dry run
+	unsigned int time_budget; // in seconds, 0 = unlimited
+	unsigned int shard; // 0-based
+	unsigned int shards; // 0 = the alignments are not split into shards
+	string partial_state_output_file; // written by the scatter step
+	string partial_state_files;
+	unsigned int read_ahead_depth; // in megabytes, 0 = no read-ahead
+	unsigned int progress_interval; // in seconds, 0 = no progress reports
+	string progress_file; // empty = stderr
+	string coverage_track_file; // empty = compute the coverage from the alignments
+	unsigned int sequence_release_threshold; // in megabytes, 0 = never release sequences
 };
 
+options_t get_default_options();
+
 options_t parse_arguments(int argc, char **argv);
 
 #endif /* _OPTIONS_H */
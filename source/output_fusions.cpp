@@ -12,8 +12,11 @@
 #include "common.hpp"
 #include "annotation.hpp"
 #include "assembly.hpp"
+#include "gene_pair_index.hpp"
 #include "output_fusions.hpp"
+#include "progress.hpp"
 #include "read_stats.hpp"
+#include "tracepoints.hpp"
 
 using namespace std;
 
@@ -234,8 +237,8 @@ void get_fusion_transcript_sequence(fusion_t& fusion, const assembly_t& assembly
 			// there are non-template bases, if the sum of the clipped bases of split read and supplementary alignment are greater than the read length
 			unsigned int clipped_split_read = ((**read).second[SPLIT_READ].strand == FORWARD) ? (**read).second[SPLIT_READ].preclipping() : (**read).second[SPLIT_READ].postclipping();
 			unsigned int clipped_supplementary = ((**read).second[SUPPLEMENTARY].strand == FORWARD) ? (**read).second[SUPPLEMENTARY].postclipping() : (**read).second[SUPPLEMENTARY].preclipping();
-			if (clipped_split_read + clipped_supplementary >= (**read).second[SPLIT_READ].sequence.size()) {
-				unsigned int unmapped_bases = clipped_split_read + clipped_supplementary - (**read).second[SPLIT_READ].sequence.size();
+			if (clipped_split_read + clipped_supplementary >= (**read).second[SPLIT_READ].sequence_length()) {
+				unsigned int unmapped_bases = clipped_split_read + clipped_supplementary - (**read).second[SPLIT_READ].sequence_length();
 				if (++non_template_bases_count[unmapped_bases] > non_template_bases_count[non_template_bases])
 					non_template_bases = unmapped_bases;
 			}
@@ -383,19 +386,15 @@ bool sort_fusions_by_support(const fusion_t* x, const fusion_t* y) {
 		return x->gene1->start + x->gene2->start < y->gene1->start + y->gene2->start; // this does not really sort, it only ensures that fusions between the
 		                                                                              // same pair of genes are grouped together, if e-value and supporting reads are equal
 }
-// make helper struct which groups events between the same pair of genes together,
+// make helper function which groups events between the same pair of genes together,
 // such that events with only few supporting reads are listed near the best event (the one with the most supporting reads)
-struct sort_fusions_by_rank_of_best_t {
-	unordered_map< tuple<gene_t/*gene1*/,gene_t/*gene2*/>, fusion_t* >* best;
-	bool operator()(const fusion_t* x, const fusion_t* y) {
-		fusion_t* best_x = best->at(make_tuple(x->gene1, x->gene2));
-		fusion_t* best_y = best->at(make_tuple(y->gene1, y->gene2));
-		if (best_x != best_y)
-			return sort_fusions_by_support(best_x, best_y);
-		else
-			return sort_fusions_by_support(x, y);
-	}
-};
+// the fusions to be sorted are paired with the best fusion of the respective gene pair
+bool sort_fusions_by_rank_of_best(const pair<fusion_t*/*best*/,fusion_t*>& x, const pair<fusion_t*/*best*/,fusion_t*>& y) {
+	if (x.first != y.first)
+		return sort_fusions_by_support(x.first, y.first);
+	else
+		return sort_fusions_by_support(x.second, y.second);
+}
 
 string gene_to_name(const gene_t gene, const contig_t contig, const position_t breakpoint, gene_annotation_index_t& gene_annotation_index) {
 	// if the gene is not a dummy gene (intergenic region), simply return the name of the gene
@@ -620,32 +619,35 @@ string get_fusion_site(const gene_t gene, const bool spliced, const bool exonic,
 	return site;
 }
 
+// amino acids of all codons, indexed by the bases packed into 2 bits each (A=0, C=1, G=2, T=3)
+const char CODON_TABLE[] = "KNKNTTTTRSRSIIMIQHQHPPPPRRRRLLLLEDEDAAAAGGGGVVVV*Y*YSSSS*CWCLFLF";
+// amino acids which are determined by the first two bases alone (e.g., for incomplete codons)
+const char FOURFOLD_DEGENERATE_CODON_TABLE[] = "?T???PRL?AGV?S??";
+
+// returns 4 for anything other than a base
+inline unsigned int base_to_2bit(const char base) {
+	switch (base) {
+		case 'A': case 'a': return 0;
+		case 'C': case 'c': return 1;
+		case 'G': case 'g': return 2;
+		case 'T': case 't': return 3;
+		default: return 4;
+	}
+}
+
 char dna_to_protein(const string& triplet) {
-	string t = triplet;
-	std::transform(t.begin(), t.end(), t.begin(), (int (*)(int))std::toupper);
-	string d = t.substr(0, 2);
-	if (d == "GC") { return 'A'; }
-	else if (t == "TGT" || t == "TGC") { return 'C'; }
-	else if (t == "GAT" || t == "GAC") { return 'D'; }
-	else if (t == "GAA" || t == "GAG") { return 'E'; }
-	else if (t == "TTT" || t == "TTC") { return 'F'; }
-	else if (d == "GG") { return 'G'; }
-	else if (t == "CAT" || t == "CAC") { return 'H'; }
-	else if (t == "ATT" || t == "ATC" || t == "ATA") { return 'I'; }
-	else if (t == "AAA" || t == "AAG") { return 'K'; }
-	else if (d == "CT" || t == "TTA" || t == "TTG") { return 'L'; }
-	else if (t == "ATG") { return 'M'; }
-	else if (t == "AAT" || t == "AAC") { return 'N'; }
-	else if (d == "CC") { return 'P'; }
-	else if (t == "CAA" || t == "CAG") { return 'Q'; }
-	else if (d == "CG" || t == "AGA" || t == "AGG") { return 'R'; }
-	else if (d == "TC" || t == "AGT" || t == "AGC") { return 'S'; }
-	else if (d == "AC") { return 'T'; }
-	else if (d == "GT") { return 'V'; }
-	else if (t == "TGG") { return 'W'; }
-	else if (t == "TAT" || t == "TAC") { return 'Y'; }
-	else if (t == "TAA" || t == "TAG" || t == "TGA") { return '*'; }
-	else { return '?'; }
+	if (triplet.size() < 2)
+		return '?';
+	unsigned int base1 = base_to_2bit(triplet[0]);
+	unsigned int base2 = base_to_2bit(triplet[1]);
+	if (base1 > 3 || base2 > 3)
+		return '?';
+	if (triplet.size() == 3) {
+		unsigned int base3 = base_to_2bit(triplet[2]);
+		if (base3 <= 3)
+			return CODON_TABLE[(base1 << 4) | (base2 << 2) | base3];
+	}
+	return FOURFOLD_DEGENERATE_CODON_TABLE[(base1 << 2) | base2];
 }
 
 // determines reading frame of first base of given transcript based on coding exons overlapping the transcript
@@ -667,42 +669,10 @@ int get_reading_frame(const vector<position_t>& transcribed_bases, const int fro
 			     (**exon).end >= left_boundary && (**exon).end <= right_boundary) ||
 			     left_boundary >= (**exon).start && right_boundary <= (**exon).end) {
 
-				// check if the transcript has a start codon, if not we skip it
-				if (gene->strand == FORWARD) { 
-
-					// find first exon of transcript
-					exon_t first_exon = *exon;
-					while (first_exon->previous_exon != NULL)
-						first_exon = first_exon->previous_exon;
-
-					// find exon containing start codon to determine reading frame
-					exon_with_start_codon = first_exon;
-					while (exon_with_start_codon != NULL && exon_with_start_codon->coding_region_start == -1)
-						exon_with_start_codon = exon_with_start_codon->next_exon;
-
-					// check if there is a start codon at the start of first coding exon (if not, something is bogus)
-					if (exon_with_start_codon == NULL || // no coding exon found => is a non-coding transcript
-					    assembly.at(gene->contig).substr(exon_with_start_codon->coding_region_start, 3) != "ATG")
-						continue; // kick out transcripts without start codon
-
-				} else { // gene->strand == REVERSE
-
-					// find first exon of transcript
-					exon_t first_exon = *exon;
-					while (first_exon->next_exon != NULL)
-						first_exon = first_exon->next_exon;
-
-					// find exon containing start codon to determine reading frame
-					exon_with_start_codon = first_exon;
-					while (exon_with_start_codon != NULL && exon_with_start_codon->coding_region_start == -1)
-						exon_with_start_codon = exon_with_start_codon->previous_exon;
-
-					// check if there is a start codon at the start of first coding exon (if not, something is bogus)
-					if (exon_with_start_codon == NULL || // no coding exon found => is a non-coding transcript
-					    assembly.at(gene->contig).substr(exon_with_start_codon->coding_region_end - 2, 3) != dna_to_reverse_complement("ATG"))
-						continue; // kick out transcripts without start codon
-
-				}
+				// kick out transcripts without start codon (see make_cds_maps())
+				exon_with_start_codon = (**exon).transcript->exon_with_start_codon;
+				if (!(**exon).transcript->has_start_codon)
+					continue;
 
 				exon_with_start_codon_by_transcript[(**exon).transcript] = exon_with_start_codon;
 				if ((**exon).coding_region_start <= transcribed_bases[from] && (**exon).coding_region_end >= transcribed_bases[from])
@@ -760,31 +730,26 @@ int get_reading_frame(const vector<position_t>& transcribed_bases, const int fro
 	if (transcribed_coding_base == -1)
 		return -1;
 
-	int reading_frame = -1;
-
-	// determine reading frame of exon that overlaps transcribed region
+	// determine reading frame of exon that overlaps transcribed region from the offset of the base in the coding sequence
+	// the coding segments are sorted in the direction of transcription, so the last one which begins before the base is searched
+	const position_t coding_base = transcribed_bases[transcribed_coding_base];
+	const vector<coding_segment_t>& coding_segments = best_transcript->coding_segments;
+	vector<coding_segment_t>::const_iterator coding_segment;
+	int cds_offset;
 	if (gene->strand == FORWARD) { 
-
-		exon_t next_exon = exon_with_start_codon;
-		while (next_exon != NULL &&
-		       next_exon->coding_region_start != -1 &&
-		       next_exon->start <= transcribed_bases[transcribed_coding_base]) {
-			reading_frame = (reading_frame + (min(transcribed_bases[transcribed_coding_base], next_exon->coding_region_end) - next_exon->coding_region_start) + 1) % 3;
-			next_exon = next_exon->next_exon;
-		}
-
+		coding_segment = upper_bound(coding_segments.begin(), coding_segments.end(), coding_base, [](const position_t position, const coding_segment_t& segment) { return position < segment.exon->start; });
+		if (coding_segment == coding_segments.begin())
+			return -1; // should not happen
+		--coding_segment;
+		cds_offset = coding_segment->cds_offset + min(coding_base, coding_segment->exon->coding_region_end) - coding_segment->exon->coding_region_start;
 	} else { // gene->strand == REVERSE
-
-		exon_t previous_exon = exon_with_start_codon;
-		while (previous_exon != NULL &&
-		       previous_exon->coding_region_start != -1 &&
-		       previous_exon->end >= transcribed_bases[transcribed_coding_base]) {
-			reading_frame = (reading_frame + (previous_exon->coding_region_end - max(previous_exon->coding_region_start, transcribed_bases[transcribed_coding_base])) + 1) % 3;
-			previous_exon = previous_exon->previous_exon;
-		}
-
+		coding_segment = upper_bound(coding_segments.begin(), coding_segments.end(), coding_base, [](const position_t position, const coding_segment_t& segment) { return position > segment.exon->end; });
+		if (coding_segment == coding_segments.begin())
+			return -1; // should not happen
+		--coding_segment;
+		cds_offset = coding_segment->cds_offset + coding_segment->exon->coding_region_end - max(coding_segment->exon->coding_region_start, coding_base);
 	}
-
+	int reading_frame = cds_offset % 3;
 	if (reading_frame == -1) // should not happen
 		return reading_frame;
 
@@ -998,7 +963,7 @@ string is_in_frame(string& fusion_peptide_sequence) {
 	return "out-of-frame";
 }
 
-void write_fusions_to_file(fusions_t& fusions, const string& output_file, const coverage_t& coverage, const assembly_t& assembly, gene_annotation_index_t& gene_annotation_index, exon_annotation_index_t& exon_annotation_index, vector<string> contigs_by_id, const bool print_supporting_reads, const bool print_fusion_sequence, const bool print_peptide_sequence, const bool write_discarded_fusions) {
+void write_fusions_to_file(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const string& output_file, const coverage_t& coverage, const assembly_t& assembly, gene_annotation_index_t& gene_annotation_index, exon_annotation_index_t& exon_annotation_index, vector<string> contigs_by_id, const bool print_supporting_reads, const bool print_fusion_sequence, const bool print_peptide_sequence, const bool write_discarded_fusions) {
 //TODO add "chr", if necessary
 
 	// make a vector of pointers to all fusions
@@ -1020,17 +985,25 @@ void write_fusions_to_file(fusions_t& fusions, const string& output_file, const
 		// => find out what the best ranking breakpoints are for each pair of genes
 		//    we store these breakpoints in a sorting object (sort_fusions_by_rank_of_best),
 		//    which we use as a parameter to the sort function later
-		unordered_map< tuple<gene_t/*gene1*/,gene_t/*gene2*/>, fusion_t* > best_fusion_by_gene_pair;
-		for (auto fusion = sorted_fusions.begin(); fusion != sorted_fusions.end(); ++fusion) {
-			fusion_t*& current_best = best_fusion_by_gene_pair[make_tuple((**fusion).gene1, (**fusion).gene2)];
-			if (current_best == NULL || sort_fusions_by_support(*fusion, current_best))
-				current_best = *fusion;
+		//    the best fusion of a gene pair is stored at the position of the first fusion of the gene pair in the index
+		vector<fusion_t*> best_fusion_by_gene_pair(gene_pair_index.size());
+		for (gene_pair_index_t::iterator group_start = gene_pair_index.begin(); group_start != gene_pair_index.end();) {
+			gene_pair_index_t::range_t fusions_of_gene_pair = gene_pair_index.group_of(group_start, false);
+			fusion_t*& current_best = best_fusion_by_gene_pair[group_start - gene_pair_index.begin()];
+			for (gene_pair_index_t::iterator fusion = fusions_of_gene_pair.first; fusion != fusions_of_gene_pair.second; ++fusion)
+				if ((**fusion).filter == NULL && (current_best == NULL || sort_fusions_by_support(*fusion, current_best)))
+					current_best = *fusion;
+			group_start = fusions_of_gene_pair.second;
 		}
 
 		// sort all gene pairs by the rank of the best scoring breakpoints of a given gene pair
-		sort_fusions_by_rank_of_best_t sort_fusions_by_rank_of_best;
-		sort_fusions_by_rank_of_best.best = &best_fusion_by_gene_pair;
-		sort(sorted_fusions.begin(), sorted_fusions.end(), sort_fusions_by_rank_of_best);
+		vector< pair<fusion_t*/*best*/,fusion_t*> > fusions_with_best_of_gene_pair;
+		fusions_with_best_of_gene_pair.reserve(sorted_fusions.size());
+		for (auto fusion = sorted_fusions.begin(); fusion != sorted_fusions.end(); ++fusion)
+			fusions_with_best_of_gene_pair.push_back(make_pair(best_fusion_by_gene_pair[gene_pair_index.find((**fusion).gene1, (**fusion).gene2).first - gene_pair_index.begin()], *fusion));
+		sort(fusions_with_best_of_gene_pair.begin(), fusions_with_best_of_gene_pair.end(), sort_fusions_by_rank_of_best);
+		for (size_t i = 0; i < sorted_fusions.size(); ++i)
+			sorted_fusions[i] = fusions_with_best_of_gene_pair[i].second;
 	}
 
 	// write sorted list to file
@@ -1040,8 +1013,12 @@ void write_fusions_to_file(fusions_t& fusions, const string& output_file, const
 		exit(1);
 	}
 	out << "#gene1\tgene2\tstrand1(gene/fusion)\tstrand2(gene/fusion)\tbreakpoint1\tbreakpoint2\tsite1\tsite2\ttype\tdirection1\tdirection2\tsplit_reads1\tsplit_reads2\tdiscordant_mates\tcoverage1\tcoverage2\tconfidence\tclosest_genomic_breakpoint1\tclosest_genomic_breakpoint2\tfilters\tfusion_transcript\treading_frame\tpeptide_sequence\tread_identifiers" << endl;
+	progress_reporter_t progress("writing '" + output_file + "'");
 	for (auto fusion = sorted_fusions.begin(); fusion != sorted_fusions.end(); ++fusion) {
 
+		if (progress.is_due())
+			progress.report(to_string(static_cast<long long unsigned int>(fusion - sorted_fusions.begin())) + "/" + to_string(static_cast<long long unsigned int>(sorted_fusions.size())) + " fusions written");
+
 		// describe site of breakpoint
 		string site1 = get_fusion_site((**fusion).gene1, (**fusion).spliced1, (**fusion).exonic1, (**fusion).contig1, (**fusion).breakpoint1, exon_annotation_index);
 		string site2 = get_fusion_site((**fusion).gene2, (**fusion).spliced2, (**fusion).exonic2, (**fusion).contig2, (**fusion).breakpoint2, exon_annotation_index);
@@ -1165,6 +1142,7 @@ void write_fusions_to_file(fusions_t& fusions, const string& output_file, const
 		}
 
 		out << endl;
+		TRACEPOINT3(output__row, (**fusion).gene1->id, (**fusion).gene2->id, (**fusion).supporting_reads());
 	}
 	out.close();
 	if (out.bad()) {
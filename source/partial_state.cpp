@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "sam.h"
+#include "common.hpp"
+#include "read_chimeric_alignments.hpp"
+#include "read_stats.hpp"
+#include "partial_state.hpp"
+
+using namespace std;
+
+// partial states are only exchanged between processes running the same binary,
+// so values are stored in their native binary representation
+const string PARTIAL_STATE_MAGIC = "ARRIBA_PARTIAL_STATE_2\n";
+
+template <class T> void write_value(ostream& out, const T& value) {
+	out.write((const char*) &value, sizeof(T));
+}
+
+template <class T> bool read_value(istream& in, T& value) {
+	return (bool) in.read((char*) &value, sizeof(T));
+}
+
+void write_string(ostream& out, const string& value) {
+	write_value(out, (unsigned int) value.size());
+	out.write(value.data(), value.size());
+}
+
+bool read_string(istream& in, string& value) {
+	unsigned int size;
+	if (!read_value(in, size))
+		return false;
+	value.resize(size);
+	return size == 0 || (bool) in.read(&value[0], size);
+}
+
+// only windows with coverage or with fragments starting/ending there are stored, since most of them are empty in a shard
+void write_coverage(ostream& out, const coverage_t& coverage) {
+	write_value(out, (unsigned int) coverage.windows.size());
+	for (contig_t contig = 0; (unsigned int) contig < coverage.windows.size(); ++contig) {
+		write_value(out, coverage.windows[contig]);
+		unsigned int non_empty_windows = 0;
+		for (unsigned int window = 0; window < coverage.windows[contig]; ++window) {
+			const coverage_t::coverage_block_t* block = coverage.get_block(contig, window);
+			if (block == NULL)
+				window += COVERAGE_BLOCK_SIZE - 1; // skip block
+			else if (block->get_coverage(window % COVERAGE_BLOCK_SIZE) > 0 || block->fragment_starts[window % COVERAGE_BLOCK_SIZE] || block->fragment_ends[window % COVERAGE_BLOCK_SIZE])
+				non_empty_windows++;
+		}
+		write_value(out, non_empty_windows);
+		for (unsigned int window = 0; window < coverage.windows[contig]; ++window) {
+			const coverage_t::coverage_block_t* block = coverage.get_block(contig, window);
+			if (block == NULL) {
+				window += COVERAGE_BLOCK_SIZE - 1; // skip block
+			} else if (block->get_coverage(window % COVERAGE_BLOCK_SIZE) > 0 || block->fragment_starts[window % COVERAGE_BLOCK_SIZE] || block->fragment_ends[window % COVERAGE_BLOCK_SIZE]) {
+				write_value(out, window);
+				write_value(out, (unsigned short int) block->get_coverage(window % COVERAGE_BLOCK_SIZE));
+				write_value(out, (unsigned char) (block->fragment_starts[window % COVERAGE_BLOCK_SIZE] | block->fragment_ends[window % COVERAGE_BLOCK_SIZE] << 1));
+			}
+		}
+	}
+}
+
+// the coverage counters saturate in the same way as if all fragments had been added to a single coverage_t
+bool merge_coverage(istream& in, coverage_t& coverage) {
+	unsigned int contigs;
+	if (!read_value(in, contigs) || contigs != coverage.windows.size())
+		return false;
+	for (contig_t contig = 0; (unsigned int) contig < contigs; ++contig) {
+		unsigned int windows, non_empty_windows;
+		if (!read_value(in, windows) || windows != coverage.windows[contig] || !read_value(in, non_empty_windows))
+			return false;
+		for (unsigned int i = 0; i < non_empty_windows; ++i) {
+			unsigned int window;
+			unsigned short int window_coverage;
+			unsigned char fragment_boundaries;
+			if (!read_value(in, window) || window >= windows || !read_value(in, window_coverage) || !read_value(in, fragment_boundaries))
+				return false;
+			coverage.add_coverage(contig, window, window_coverage);
+			if (fragment_boundaries & 1)
+				coverage.get_writable_block(contig, window).fragment_starts[window % COVERAGE_BLOCK_SIZE] = true;
+			if (fragment_boundaries & 2)
+				coverage.get_writable_block(contig, window).fragment_ends[window % COVERAGE_BLOCK_SIZE] = true;
+		}
+	}
+	return true;
+}
+
+// the sample of fragments is stored as is, the gather step keeps the fragments with the smallest hashes of all shards
+void write_fragment_statistics(ostream& out, const fragment_statistics_t& fragment_statistics) {
+	write_value(out, (unsigned int) fragment_statistics.sample.size());
+	for (unsigned int i = 0; i < fragment_statistics.sample.size(); ++i) {
+		write_value(out, fragment_statistics.sample[i].hash);
+		write_value(out, fragment_statistics.sample[i].mate_gap);
+		write_value(out, fragment_statistics.sample[i].strand);
+	}
+}
+
+bool merge_fragment_statistics(istream& in, fragment_statistics_t& fragment_statistics) {
+	unsigned int sample_size;
+	if (!read_value(in, sample_size) || sample_size > FRAGMENT_SAMPLE_SIZE)
+		return false;
+	for (unsigned int i = 0; i < sample_size; ++i) {
+		fragment_statistics_t::sampled_fragment_t fragment;
+		if (!read_value(in, fragment.hash) || !read_value(in, fragment.mate_gap) || !read_value(in, fragment.strand))
+			return false;
+		fragment_statistics.add_to_sample(fragment);
+	}
+	return true;
+}
+
+void write_partial_state(const string& output_file, const contigs_t& contigs, const unsigned long int mapped_reads, const coverage_t& coverage, const fragment_statistics_t& fragment_statistics, partial_bam_records_t& partial_bam_records) {
+
+	ofstream out(output_file.c_str(), ios::binary);
+	if (!out.is_open()) {
+		cerr << "ERROR: failed to open output file '" << output_file << "'." << endl;
+		exit(1);
+	}
+	out << PARTIAL_STATE_MAGIC;
+
+	// the contigs are stored so that the gather step can verify that all shards were run on the same input files
+	vector<string> contigs_by_id(contigs.size());
+	for (contigs_t::const_iterator contig = contigs.begin(); contig != contigs.end(); ++contig)
+		contigs_by_id[contig->second] = contig->first;
+	write_value(out, (unsigned int) contigs_by_id.size());
+	for (unsigned int contig = 0; contig < contigs_by_id.size(); ++contig)
+		write_string(out, contigs_by_id[contig]);
+
+	write_value(out, mapped_reads);
+	write_coverage(out, coverage);
+	write_fragment_statistics(out, fragment_statistics);
+
+	write_value(out, (unsigned long int) partial_bam_records.size());
+	for (partial_bam_records_t::iterator partial_bam_record = partial_bam_records.begin(); partial_bam_record != partial_bam_records.end(); ++partial_bam_record) {
+		write_value(out, (unsigned long long int) partial_bam_record->record->id);
+		write_value(out, partial_bam_record->fragment_counted);
+		write_value(out, partial_bam_record->record->core);
+		write_value(out, partial_bam_record->record->l_data);
+		out.write((const char*) partial_bam_record->record->data, partial_bam_record->record->l_data);
+		bam_destroy1(partial_bam_record->record);
+	}
+	partial_bam_records.clear();
+
+	if (!out.good()) {
+		cerr << "ERROR: failed to write to output file '" << output_file << "'." << endl;
+		exit(1);
+	}
+}
+
+bool read_partial_state(const string& input_file, contigs_t& contigs, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, partial_bam_records_t& partial_bam_records) {
+
+	ifstream in(input_file.c_str(), ios::binary);
+	if (!in.is_open()) {
+		cerr << "ERROR: failed to open file '" << input_file << "'." << endl;
+		exit(1);
+	}
+	string magic(PARTIAL_STATE_MAGIC.size(), '\0');
+	if (!in.read(&magic[0], magic.size()) || magic != PARTIAL_STATE_MAGIC) {
+		cerr << "ERROR: file '" << input_file << "' does not contain a partial state or was written by a different version of Arriba." << endl;
+		exit(1);
+	}
+
+	// contigs which only occur in the BAM file are added in the same order as when the BAM file is read
+	unsigned int contig_count;
+	if (!read_value(in, contig_count))
+		return false;
+	for (unsigned int contig = 0; contig < contig_count; ++contig) {
+		string contig_name;
+		if (!read_string(in, contig_name))
+			return false;
+		contigs_t::iterator existing_contig = contigs.find(contig_name);
+		if (existing_contig == contigs.end() && contig == contigs.size())
+			contigs[contig_name] = contig;
+		else if (existing_contig == contigs.end() || existing_contig->second != (contig_t) contig) {
+			cerr << "ERROR: partial state '" << input_file << "' was created from different input files." << endl;
+			exit(1);
+		}
+	}
+
+	unsigned long int shard_mapped_reads;
+	if (!read_value(in, shard_mapped_reads))
+		return false;
+	mapped_reads += shard_mapped_reads;
+
+	if (!merge_coverage(in, coverage)) {
+		cerr << "ERROR: partial state '" << input_file << "' was created from different input files." << endl;
+		exit(1);
+	}
+	if (!merge_fragment_statistics(in, fragment_statistics))
+		return false;
+
+	unsigned long int record_count;
+	if (!read_value(in, record_count))
+		return false;
+	for (unsigned long int i = 0; i < record_count; ++i) {
+		unsigned long long int id;
+		partial_bam_record_t partial_bam_record;
+		partial_bam_record.record = bam_init1();
+		if (partial_bam_record.record == NULL) {
+			cerr << "ERROR: failed to allocate memory." << endl;
+			exit(1);
+		}
+		partial_bam_records.push_back(partial_bam_record); // ensures the record is freed, even if it is incomplete
+		bam1_t* record = partial_bam_records.back().record;
+		if (!read_value(in, id) || !read_value(in, partial_bam_records.back().fragment_counted) || !read_value(in, record->core) || !read_value(in, record->l_data) || record->l_data < 0)
+			return false;
+		record->id = id;
+		record->m_data = record->l_data;
+		record->data = (uint8_t*) malloc(record->m_data);
+		if (record->data == NULL && record->m_data > 0) {
+			cerr << "ERROR: failed to allocate memory." << endl;
+			exit(1);
+		}
+		if (!in.read((char*) record->data, record->l_data))
+			return false;
+	}
+
+	return true;
+}
+
+void read_partial_states(const vector<string>& input_files, contigs_t& contigs, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, partial_bam_records_t& partial_bam_records) {
+	for (vector<string>::const_iterator input_file = input_files.begin(); input_file != input_files.end(); ++input_file) {
+		if (!read_partial_state(*input_file, contigs, mapped_reads, coverage, fragment_statistics, partial_bam_records)) {
+			cerr << "ERROR: partial state '" << *input_file << "' is truncated." << endl;
+			exit(1);
+		}
+	}
+}
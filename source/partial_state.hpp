@@ -0,0 +1,21 @@
+#ifndef _PARTIAL_STATE_H
+#define _PARTIAL_STATE_H 1
+
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "read_chimeric_alignments.hpp"
+#include "read_stats.hpp"
+
+using namespace std;
+
+// the alignments can be read by several processes, each of which reads only a shard of the input (scatter step)
+// every process saves what it has extracted from its shard (the partial state) to a file:
+// the number of mapped reads, the coverage, the fragment statistics, and the records which need to be processed by the gather step
+// the gather step merges the partial states and runs all remaining steps as if a single process had read the entire input
+
+void write_partial_state(const string& output_file, const contigs_t& contigs, const unsigned long int mapped_reads, const coverage_t& coverage, const fragment_statistics_t& fragment_statistics, partial_bam_records_t& partial_bam_records);
+
+void read_partial_states(const vector<string>& input_files, contigs_t& contigs, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, partial_bam_records_t& partial_bam_records);
+
+#endif /* _PARTIAL_STATE_H */
@@ -0,0 +1,116 @@
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "pipeline.hpp"
+#include "tracepoints.hpp"
+
+using namespace std;
+
+string get_time_string() {
+	time_t now = time(0);
+	char buffer[100];
+	strftime(buffer, sizeof(buffer), "[%Y-%m-%dT%X]", localtime(&now));
+	return buffer;
+}
+
+void pipeline_t::add_stage(const string& name, const string& description, const bool enabled, const string& run_after, const function<string()>& run) {
+	pipeline_stage_t stage;
+	stage.name = name;
+	stage.description = description;
+	stage.enabled = enabled;
+	istringstream iss(run_after);
+	string dependency;
+	while (iss >> dependency)
+		stage.run_after.push_back(dependency);
+	stage.run = run;
+	stage.elapsed_time = 0;
+	stages.push_back(stage);
+}
+
+vector<unsigned int> pipeline_t::get_execution_order() const {
+
+	// map names to stages
+	unordered_map<string,unsigned int> stage_by_name;
+	for (unsigned int stage = 0; stage < stages.size(); ++stage)
+		stage_by_name[stages[stage].name] = stage;
+
+	// count unmet dependencies of each stage
+	vector<unsigned int> unmet_dependencies(stages.size());
+	vector< vector<unsigned int> > dependent_stages(stages.size());
+	for (unsigned int stage = 0; stage < stages.size(); ++stage) {
+		for (auto dependency = stages[stage].run_after.begin(); dependency != stages[stage].run_after.end(); ++dependency) {
+			auto dependency_stage = stage_by_name.find(*dependency);
+			if (dependency_stage == stage_by_name.end()) {
+				cerr << "ERROR: stage '" << stages[stage].name << "' depends on unknown stage '" << *dependency << "'." << endl;
+				exit(1);
+			}
+			unmet_dependencies[stage]++;
+			dependent_stages[dependency_stage->second].push_back(stage);
+		}
+	}
+
+	// topological sort which prefers the stage registered first, when there are several candidates
+	// this way, the order of registration is retained unless it violates a dependency
+	vector<unsigned int> execution_order;
+	vector<bool> scheduled(stages.size());
+	while (execution_order.size() < stages.size()) {
+		unsigned int next_stage = 0;
+		while (next_stage < stages.size() && (scheduled[next_stage] || unmet_dependencies[next_stage] > 0))
+			++next_stage;
+		if (next_stage == stages.size()) {
+			cerr << "ERROR: cyclic dependency between stages." << endl;
+			exit(1);
+		}
+		scheduled[next_stage] = true;
+		execution_order.push_back(next_stage);
+		for (auto dependent_stage = dependent_stages[next_stage].begin(); dependent_stage != dependent_stages[next_stage].end(); ++dependent_stage)
+			unmet_dependencies[*dependent_stage]--;
+	}
+
+	return execution_order;
+}
+
+void pipeline_t::run() {
+
+	vector<unsigned int> execution_order = get_execution_order();
+	for (auto stage_index = execution_order.begin(); stage_index != execution_order.end(); ++stage_index) {
+		pipeline_stage_t& stage = stages[*stage_index];
+
+		if (!stage.enabled)
+			continue; // disabled stages count as done, such that dependent stages are run nonetheless
+
+		if (!stage.description.empty())
+			cout << get_time_string() << " " << stage.description << flush;
+
+		TRACEPOINT1(stage__start, stage.name.c_str());
+		chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+		string summary = stage.run();
+		stage.elapsed_time = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+		TRACEPOINT2(stage__end, stage.name.c_str(), (unsigned long long int) (stage.elapsed_time * 1000000));
+
+		if (!stage.description.empty()) {
+			if (!summary.empty())
+				cout << " (" << summary << ")";
+			cout << endl;
+		}
+	}
+
+	// summarize the time taken by each stage in a single line, such that the lines of the stages keep their format
+	string elapsed_times;
+	for (auto stage_index = execution_order.begin(); stage_index != execution_order.end(); ++stage_index) {
+		const pipeline_stage_t& stage = stages[*stage_index];
+		if (stage.enabled) {
+			ostringstream elapsed_time;
+			elapsed_time << fixed << setprecision(2) << stage.elapsed_time;
+			elapsed_times += string((elapsed_times.empty()) ? "" : ", ") + stage.name + "=" + elapsed_time.str() + "s";
+		}
+	}
+	if (!elapsed_times.empty())
+		cout << get_time_string() << " Time taken by each step: " << elapsed_times << endl;
+}
@@ -0,0 +1,36 @@
+#ifndef _PIPELINE_H
+#define _PIPELINE_H 1
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+string get_time_string();
+
+// a step of the workflow, typically a filter
+// stages declare which other stages they depend on rather than relying on the order of invocation
+struct pipeline_stage_t {
+	string name;
+	string description; // printed to the log before the stage is run
+	bool enabled;
+	vector<string> run_after; // stages which must run before this one (disabled stages are ignored)
+	function<string()> run; // runs the stage and returns a summary for the log (e.g., "remaining=1234") or an empty string
+	double elapsed_time; // wall-clock time in seconds taken by the stage, logged once all stages have run
+};
+
+class pipeline_t {
+	private:
+		vector<pipeline_stage_t> stages;
+		vector<unsigned int> get_execution_order() const;
+	public:
+		// register a stage; <run_after> is a space-separated list of stage names
+		void add_stage(const string& name, const string& description, const bool enabled, const string& run_after, const function<string()>& run);
+		// run all enabled stages, such that no stage runs before its dependencies
+		// among stages whose dependencies are met, the one registered first is run first
+		void run();
+		const vector<pipeline_stage_t>& get_stages() const { return stages; };
+};
+
+#endif /* _PIPELINE_H */
@@ -0,0 +1,68 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pipeline.hpp"
+#include "progress.hpp"
+
+using namespace std;
+
+unsigned int progress_interval = 0;
+string progress_status_file;
+mutex progress_output_lock; // files may be read by several threads, each with its own reporter
+
+void set_progress_reporting(const unsigned int interval, const string& status_file) {
+	progress_interval = interval;
+	progress_status_file = status_file;
+}
+
+progress_reporter_t::progress_reporter_t(const string& step):
+	step(step), start_time(chrono::steady_clock::now()), next_report(start_time + chrono::seconds(progress_interval)) {
+}
+
+bool progress_reporter_t::is_due() const {
+	return progress_interval > 0 && chrono::steady_clock::now() >= next_report;
+}
+
+double progress_reporter_t::get_elapsed_time() const {
+	return chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+void progress_reporter_t::report(const string& progress) {
+
+	next_report = chrono::steady_clock::now() + chrono::seconds(progress_interval);
+
+	ostringstream line;
+	line << get_time_string() << " Progress of " << step << ": " << progress
+	     << fixed << setprecision(0) << " (time=" << get_elapsed_time() << "s, memory=" << (get_resident_memory() / 1048576.0) << "MB)";
+
+	lock_guard<mutex> lock(progress_output_lock);
+	if (progress_status_file.empty()) {
+		cerr << line.str() << endl;
+	} else {
+		ofstream status_file(progress_status_file.c_str(), ios::trunc);
+		status_file << line.str() << endl;
+		if (status_file.fail())
+			cerr << "WARNING: failed to write progress to status file '" << progress_status_file << "'" << endl;
+	}
+}
+
+unsigned long long int get_resident_memory() {
+	ifstream statm("/proc/self/statm"); // second field = number of resident pages
+	unsigned long long int size = 0, resident_pages = 0;
+	if (!(statm >> size >> resident_pages))
+		return 0;
+	return resident_pages * sysconf(_SC_PAGESIZE);
+}
+
+unsigned long long int get_file_size(const string& file_path) {
+	struct stat file_status;
+	if (stat(file_path.c_str(), &file_status) != 0 || !S_ISREG(file_status.st_mode))
+		return 0;
+	return file_status.st_size;
+}
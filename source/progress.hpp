@@ -0,0 +1,32 @@
+#ifndef _PROGRESS_H
+#define _PROGRESS_H 1
+
+#include <chrono>
+#include <string>
+
+using namespace std;
+
+// long-running steps report their progress periodically, such that stuck or pathological samples can be spotted early
+// reports are written to stderr or, if a status file is given, the status file is overwritten with the latest report
+void set_progress_reporting(const unsigned int interval, const string& status_file); // interval in seconds, 0 = disabled
+
+// tracks when the next report of a step is due; a reporter must not be shared between threads
+class progress_reporter_t {
+	private:
+		string step;
+		chrono::steady_clock::time_point start_time;
+		chrono::steady_clock::time_point next_report;
+	public:
+		progress_reporter_t(const string& step);
+		bool is_due() const; // cheap enough to be called for every work item
+		double get_elapsed_time() const; // in seconds
+		void report(const string& progress);
+};
+
+// resident set size of the process in bytes, 0 if unknown
+unsigned long long int get_resident_memory();
+
+// size of the given file in bytes, 0 if it is not a regular file (e.g., a pipe)
+unsigned long long int get_file_size(const string& file_path);
+
+#endif /* _PROGRESS_H */
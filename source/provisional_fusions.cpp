@@ -0,0 +1,88 @@
+#include <ctime>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "common.hpp"
+#include "annotation.hpp"
+#include "recover_known_fusions.hpp"
+#include "provisional_fusions.hpp"
+
+using namespace std;
+
+provisional_fusions_t::provisional_fusions_t(const string& output_file_path, const string& known_fusions_file_path, const unordered_map<string,gene_t>& genes, const gene_annotation_index_t& gene_annotation_index, const unsigned int min_supporting_reads):
+	gene_annotation_index(gene_annotation_index), min_supporting_reads(min_supporting_reads), chimeric_reads(0) {
+
+	// unknown genes are reported by the 'known_fusions' filter later on
+	known_fusions_t known_fusions;
+	read_known_fusions(known_fusions_file_path, genes, known_fusions, false);
+	for (known_fusions_t::iterator known_fusion = known_fusions.begin(); known_fusion != known_fusions.end(); ++known_fusion)
+		if (get<0>(*known_fusion) < get<1>(*known_fusion))
+			supporting_reads[*known_fusion] = 0;
+	if (supporting_reads.empty())
+		cerr << "WARNING: no known fusions between annotated genes found in '" << known_fusions_file_path << "', there will be no provisional fusions" << endl;
+
+	output_file.open(output_file_path.c_str());
+	if (!output_file.is_open()) {
+		cerr << "ERROR: failed to open output file '" << output_file_path << "'." << endl;
+		exit(1);
+	}
+	output_file << "#time\tgene1\tgene2\tsupporting_reads\tchimeric_reads_processed" << endl;
+}
+
+// collects the known fusions between the genes of the alignments <first1>..<last1> and <first2>..<last2>
+void find_known_fusions(const vector<gene_set_t>& genes, const unsigned int first1, const unsigned int last1, const unsigned int first2, const unsigned int last2, const map< tuple<gene_t,gene_t>, unsigned int >& supporting_reads, set< tuple<gene_t,gene_t> >& known_fusions) {
+	for (unsigned int i = first1; i < last1; ++i)
+		for (unsigned int j = max(i + 1, first2); j < last2; ++j)
+			for (gene_set_t::const_iterator gene1 = genes[i].begin(); gene1 != genes[i].end(); ++gene1)
+				for (gene_set_t::const_iterator gene2 = genes[j].begin(); gene2 != genes[j].end(); ++gene2)
+					if (*gene1 != *gene2) {
+						tuple<gene_t,gene_t> gene_pair = (*gene1 < *gene2) ? make_tuple(*gene1, *gene2) : make_tuple(*gene2, *gene1);
+						if (supporting_reads.find(gene_pair) != supporting_reads.end())
+							known_fusions.insert(gene_pair);
+					}
+}
+
+void provisional_fusions_t::add_alignments(const mates_t& mates, const unsigned int new_alignments) {
+
+	unsigned int old_alignments = (new_alignments < mates.size()) ? mates.size() - new_alignments : 0;
+	if (supporting_reads.empty() || mates.size() < 2) {
+		if (old_alignments == 0) {
+			lock_guard<mutex> lock_output(lock);
+			chimeric_reads++;
+		}
+		return;
+	}
+
+	// annotate the alignments
+	vector<gene_set_t> genes(mates.size());
+	for (unsigned int i = 0; i < mates.size(); ++i)
+		get_annotation_by_coordinate(mates[i].contig, mates[i].start, mates[i].end, genes[i], gene_annotation_index);
+
+	// find the known fusions which are supported by the new alignments, but which were not supported by the old ones already
+	set< tuple<gene_t,gene_t> > newly_supported_fusions;
+	find_known_fusions(genes, 0, mates.size(), old_alignments, mates.size(), supporting_reads, newly_supported_fusions);
+	if (!newly_supported_fusions.empty()) {
+		set< tuple<gene_t,gene_t> > previously_supported_fusions;
+		find_known_fusions(genes, 0, old_alignments, 0, old_alignments, supporting_reads, previously_supported_fusions);
+		for (set< tuple<gene_t,gene_t> >::iterator fusion = previously_supported_fusions.begin(); fusion != previously_supported_fusions.end(); ++fusion)
+			newly_supported_fusions.erase(*fusion);
+	}
+
+	lock_guard<mutex> lock_output(lock);
+	if (old_alignments == 0)
+		chimeric_reads++;
+	for (set< tuple<gene_t,gene_t> >::iterator fusion = newly_supported_fusions.begin(); fusion != newly_supported_fusions.end(); ++fusion) {
+		// all known fusions were inserted by the constructor, so the structure of the map never changes
+		// and find_known_fusions() may look up keys without holding the lock, while the counts are updated here
+		if (++supporting_reads.find(*fusion)->second == min_supporting_reads) {
+			time_t now = time(0);
+			char time_string[100];
+			strftime(time_string, sizeof(time_string), "%Y-%m-%dT%X", localtime(&now));
+			output_file << time_string << "\t" << get<0>(*fusion)->name << "\t" << get<1>(*fusion)->name << "\t" << min_supporting_reads << "\t" << chimeric_reads << endl; // flush, so the record can be seen right away
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef _PROVISIONAL_FUSIONS_H
+#define _PROVISIONAL_FUSIONS_H 1
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include "common.hpp"
+#include "recover_known_fusions.hpp"
+
+using namespace std;
+
+// counts the chimeric reads supporting known fusions while the alignments are still being read and
+// writes a provisional record to a side file as soon as a known fusion reaches the given number of reads,
+// such that clinically relevant fusions can be flagged long before the full analysis has completed
+// provisional records have not been filtered, the final result is the output file of the full analysis
+class provisional_fusions_t {
+	private:
+		const gene_annotation_index_t& gene_annotation_index;
+		const unsigned int min_supporting_reads;
+		ofstream output_file;
+		map< tuple<gene_t,gene_t>, unsigned int > supporting_reads; // known fusions with genes ordered by address
+		unsigned long int chimeric_reads; // number of chimeric reads seen so far
+		mutex lock; // several files may be read concurrently
+	public:
+		provisional_fusions_t(const string& output_file_path, const string& known_fusions_file_path, const unordered_map<string,gene_t>& genes, const gene_annotation_index_t& gene_annotation_index, const unsigned int min_supporting_reads);
+		// to be called whenever alignments have been added to a chimeric read; the last <new_alignments> of <mates> are new,
+		// such that a read is counted at most once for a fusion, no matter in what order its alignments arrive
+		void add_alignments(const mates_t& mates, const unsigned int new_alignments);
+};
+
+#endif /* _PROVISIONAL_FUSIONS_H */
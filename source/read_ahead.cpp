@@ -0,0 +1,114 @@
+#include <chrono>
+#include <climits>
+#include <fcntl.h>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "bgzf.h"
+#include "cram.h"
+#include "hfile.h"
+#include "sam.h"
+#include "read_ahead.hpp"
+
+using namespace std;
+
+const size_t READ_AHEAD_CHUNK_SIZE = 4*1024*1024; // large reads amortize the latency of network file systems
+
+unsigned long long int read_ahead_depth = 0; // disabled, unless enabled with -B
+
+// statistics of all read_ahead_t instances
+atomic<unsigned long long int> bytes_read_ahead(0);
+atomic<unsigned long long int> microseconds_reading_ahead(0);
+
+void set_read_ahead_depth(const unsigned long long int depth) {
+	read_ahead_depth = depth;
+}
+
+unsigned long long int get_read_ahead_depth() {
+	return read_ahead_depth;
+}
+
+read_ahead_t::read_ahead_t(const string& file_path, const bool entire_file):
+	file_descriptor(-1), depth(read_ahead_depth), consumer_position((entire_file) ? LLONG_MAX : 0), stop(false) {
+	if (depth == 0)
+		return;
+	file_descriptor = open(file_path.c_str(), O_RDONLY);
+	if (file_descriptor < 0)
+		return; // not a regular file (e.g., a pipe or a URL), the consumer will report any errors
+	io_thread = thread(&read_ahead_t::run, this);
+}
+
+read_ahead_t::read_ahead_t(const string& file_path, const unsigned long long int depth):
+	file_descriptor(-1), depth(depth), consumer_position(0), stop(false) {
+	if (depth == 0)
+		return;
+	file_descriptor = open(file_path.c_str(), O_RDONLY);
+	if (file_descriptor < 0)
+		return; // not a regular file (e.g., a pipe or a URL), the consumer will report any errors
+	io_thread = thread(&read_ahead_t::run, this);
+}
+
+read_ahead_t::~read_ahead_t() {
+	{
+		lock_guard<mutex> guard(lock);
+		stop = true;
+	}
+	stopped.notify_all();
+	if (io_thread.joinable())
+		io_thread.join();
+	if (file_descriptor >= 0)
+		close(file_descriptor);
+}
+
+void read_ahead_t::run() {
+
+	// the kernel doubles its own read-ahead window for sequentially accessed files
+	posix_fadvise(file_descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	vector<char> buffer(READ_AHEAD_CHUNK_SIZE);
+	long long int position = 0;
+	unique_lock<mutex> guard(lock);
+	while (!stop) {
+
+		// wait, if we are far enough ahead of the consumer
+		long long int consumer = consumer_position.load(memory_order_relaxed);
+		if (consumer <= LLONG_MAX - (long long int) depth && position >= consumer + (long long int) depth) {
+			stopped.wait_for(guard, chrono::milliseconds(10));
+			continue;
+		}
+
+		// the data is discarded, we only want it to end up in the page cache
+		guard.unlock();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		ssize_t bytes = pread(file_descriptor, &buffer[0], buffer.size(), position);
+		unsigned long long int microseconds = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+		guard.lock();
+		if (bytes <= 0)
+			break; // end of file or error
+		position += bytes;
+		bytes_read_ahead += bytes;
+		microseconds_reading_ahead += microseconds;
+	}
+}
+
+long long int get_file_position(samFile* file) {
+	return (file->is_cram) ? htell(cram_fd_get_fp(file->fp.cram)) : (bgzf_tell(file->fp.bgzf) >> 16);
+}
+
+void read_ahead_t::consumed(samFile* file) {
+	consumed(get_file_position(file));
+}
+
+void read_ahead_t::consumed(BGZF* file) {
+	consumed(bgzf_tell(file) >> 16);
+}
+
+string get_read_ahead_statistics() {
+	ostringstream statistics;
+	statistics << fixed << setprecision(1) << (bytes_read_ahead / 1048576.0) << " MB read ahead";
+	if (microseconds_reading_ahead > 0)
+		statistics << " at " << (bytes_read_ahead / 1.048576 / microseconds_reading_ahead) << " MB/s";
+	return statistics.str();
+}
@@ -0,0 +1,53 @@
+#ifndef _READ_AHEAD_H
+#define _READ_AHEAD_H 1
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include "sam.h"
+
+using namespace std;
+
+// on network file systems (e.g., NFS, Lustre), the small synchronous reads issued by htslib stall on latency
+// a read_ahead_t reads a file in large chunks in a dedicated I/O thread and stays up to a configurable number of bytes
+// ahead of the consumer, such that the data is already in the page cache by the time htslib asks for it
+// the consumer reports its progress via consumed(); the read-ahead is a mere hint, errors are left to the consumer
+class read_ahead_t {
+	private:
+		int file_descriptor;
+		unsigned long long int depth; // number of bytes to stay ahead of the consumer
+		atomic<long long int> consumer_position; // position in the file up to which the consumer has read
+		bool stop;
+		mutex lock;
+		condition_variable stopped;
+		thread io_thread;
+		void run();
+	public:
+		read_ahead_t(const string& file_path, const bool entire_file = false); // with <entire_file>, the depth is not limited
+		read_ahead_t(const string& file_path, const unsigned long long int depth); // with a depth other than the one set via set_read_ahead_depth()
+		~read_ahead_t();
+		void consumed(const long long int position) { consumer_position.store(position, memory_order_relaxed); };
+		void consumed(samFile* file); // derives the position from the underlying compressed file
+		void consumed(BGZF* file);
+};
+
+// how often (in BAM records) readers report their progress to the read-ahead thread
+const unsigned int READ_AHEAD_PROGRESS_INTERVAL = 4096;
+
+// the number of bytes of the alignments which are read into the page cache while the reference is loaded, unless -B asks for more
+const unsigned long long int PREFETCH_DEPTH_WHILE_LOADING_REFERENCE = 256ULL*1024*1024;
+
+// the number of bytes to read ahead of the consumer; 0 disables read-ahead
+void set_read_ahead_depth(const unsigned long long int depth);
+unsigned long long int get_read_ahead_depth();
+
+// position in the compressed file up to which htslib has read
+long long int get_file_position(samFile* file);
+
+// amount of data read ahead and throughput, for the log
+string get_read_ahead_statistics();
+
+#endif /* _READ_AHEAD_H */
@@ -1,18 +1,23 @@
 #include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include "cram.h"
 #include "sam.h"
 #include "annotation.hpp"
 #include "common.hpp"
+#include "nucleotides.hpp"
+#include "progress.hpp"
+#include "read_ahead.hpp"
+#include "tracepoints.hpp"
 #include "read_chimeric_alignments.hpp"
 #include "read_stats.hpp"
 
 using namespace std;
 
-typedef map<string,bam1_t*> buffered_bam_records_t;
-typedef vector<contig_t> tid_to_contig_t;
-
 bool find_spanning_intron(const bam1_t* bam_record, const position_t gene1_end, const position_t gene2_start, unsigned int& cigar_op, position_t& read_pos) {
 
 	if (bam_record->core.n_cigar < 3)
@@ -49,11 +54,8 @@ void add_chimeric_alignment(chimeric_alignments_t& chimeric_alignments, const ba
 	alignment.first_in_pair = bam_record->core.flag & BAM_FREAD1;
 	alignment.contig = bam_record->core.tid;
 	alignment.supplementary = is_supplementary;
-	if (!is_supplementary) { // only keep sequence in memory, if this is not the supplementary alignment (because then it's already stored in the split-read)
-		alignment.sequence.resize(bam_record->core.l_qseq);
-		for (int i = 0; i < bam_record->core.l_qseq; ++i)
-			alignment.sequence[i] = seq_nt16_str[bam_seqi(bam_get_seq(bam_record), i)];
-	}
+	if (!is_supplementary) // only keep sequence in memory, if this is not the supplementary alignment (because then it's already stored in the split-read)
+		decode_bam_sequence(bam_get_seq(bam_record), bam_record->core.l_qseq, alignment.sequence);
 
 	// read-through alignments need to be split into a split-read and a supplementary alignment
 	if (clip_start) {
@@ -77,6 +79,7 @@ void add_chimeric_alignment(chimeric_alignments_t& chimeric_alignments, const ba
 		for (unsigned int i = 0; i < alignment.cigar.size(); ++i)
 			alignment.cigar[i] = bam_get_cigar(bam_record)[i];
 	}
+	alignment.update_cigar_features();
 }
 
 bool extract_read_through_alignment(chimeric_alignments_t& chimeric_alignments, bam1_t* forward_mate, bam1_t* reverse_mate, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file) {
@@ -185,18 +188,124 @@ bool extract_read_through_alignment(chimeric_alignments_t& chimeric_alignments,
 	return false;
 }
 
-unsigned int read_chimeric_alignments(const string& bam_file_path, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, coverage_t& coverage, contigs_t& contigs, const contigs_t& interesting_contigs, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file) {
+// what happened to a BAM record after it was processed
+enum bam_record_outcome_t { RECORD_IGNORED, RECORD_SUPPLEMENTARY, FIRST_MATE_BUFFERED, FRAGMENT_COMPLETE, FRAGMENT_CHIMERIC };
 
-	// open BAM file
-	samFile* bam_file = sam_open(bam_file_path.c_str(), "rb");
-	if (bam_file->is_cram)
-		cram_set_option(bam_file->fp.cram, CRAM_OPT_REFERENCE, assembly_file_path.c_str());
-	bam_hdr_t* bam_header = sam_hdr_read(bam_file);
+// extract chimeric alignments from a BAM record
+// for paired-end data, the first mate is buffered until the second one is processed; in this case, the buffer takes ownership of the record
+// when the record completes a fragment, the buffered mate is returned via <previously_seen_mate> and the caller must free it
+// the coverage and the fragment statistics are only updated, if <coverage> and <fragment_statistics> are not NULL
+bam_record_outcome_t process_bam_record(bam1_t* bam_record, bam1_t*& previously_seen_mate, buffered_bam_records_t& buffered_bam_records, chimeric_alignments_t& chimeric_alignments, coverage_t* coverage, fragment_statistics_t* fragment_statistics, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, bool& no_chimeric_reads) {
+
+	previously_seen_mate = NULL;
+
+	if (separate_chimeric_bam_file && !is_rna_bam_file && (bam_record->core.flag & BAM_FSECONDARY)) { // extract supplementary reads from Chimeric.out.sam
+		add_chimeric_alignment(chimeric_alignments, bam_record, 0, 0, false, false, true);
+		no_chimeric_reads = false;
+		return RECORD_SUPPLEMENTARY; // supplementary alignments are added directly; all other reads need to be buffered until we have found the mate (see below)
+	}
+
+	if (is_rna_bam_file && (bam_record->core.flag & BAM_FSUPPLEMENTARY)) { // extract supplementary reads from Aligned.out.bam
+		if (!separate_chimeric_bam_file) { // don't load supplementary reads twice (from Chimeric.out.sam and from Aligned.out.bam)
+			add_chimeric_alignment(chimeric_alignments, bam_record, 0, 0, false, false, true);
+			no_chimeric_reads = false;
+			return RECORD_SUPPLEMENTARY;
+		}
+		return RECORD_IGNORED;
+	}
+
+	// for paired-end data we need to wait until we have read both mates
+	if (bam_record->core.flag & BAM_FPAIRED) {
+
+		// try to insert the mate into the buffered BAM records
+		// if there was already a record with the same read name, insertion will fail (->second set to false) and
+		// previously_seen_mate->first will point to the mate which was already in the buffered BAM records
+		pair<buffered_bam_records_t::iterator,bool> find_previously_seen_mate = buffered_bam_records.insert(pair<string,bam1_t*>((char*) bam_get_qname(bam_record), bam_record));
+		if (find_previously_seen_mate.second) // this is the first mate with the given read name, which we encounter
+			return FIRST_MATE_BUFFERED;
+		previously_seen_mate = find_previously_seen_mate.first->second;
+		buffered_bam_records.erase(find_previously_seen_mate.first); // remove from lookup buffer, we don't need it anymore
+
+	}
+
+	// single-end data or we have already read the first mate previously
+	bool is_chimeric = false;
+	if (separate_chimeric_bam_file && !is_rna_bam_file) { // this is Chimeric.out.sam => load everything
+
+		add_chimeric_alignment(chimeric_alignments, bam_record);
+		if (previously_seen_mate != NULL)
+			add_chimeric_alignment(chimeric_alignments, previously_seen_mate);
+		no_chimeric_reads = false;
+		is_chimeric = true;
+
+	} else { // this is Aligned.out.bam => load only discordant mates and split reads, and only when there is no Chimeric.out.sam
+
+		bool is_read_through_alignment = false;
+
+		bool is_discordant_or_split_read = (bam_record->core.flag & BAM_FPAIRED) && !(bam_record->core.flag & BAM_FPROPER_PAIR) || // discordant mates
+		                                   bam_aux_get(bam_record, "SA") != NULL || previously_seen_mate != NULL && bam_aux_get(previously_seen_mate, "SA") != NULL; // split-read
+		if (is_discordant_or_split_read) {
+			if (!separate_chimeric_bam_file) {
+				add_chimeric_alignment(chimeric_alignments, bam_record);
+				if (previously_seen_mate != NULL)
+					add_chimeric_alignment(chimeric_alignments, previously_seen_mate);
+				no_chimeric_reads = false;
+				is_chimeric = true;
+			}
+		} else { // only add read-through alignment, if it is not already a chimeric alignment
+			is_read_through_alignment = extract_read_through_alignment(chimeric_alignments, bam_record, previously_seen_mate, gene_annotation_index, separate_chimeric_bam_file);
+			is_chimeric = is_read_through_alignment;
+		}
+
+		if (coverage != NULL && !coverage->is_precomputed())
+			coverage->add_fragment(bam_record, previously_seen_mate, is_read_through_alignment);
+		if (fragment_statistics != NULL && !is_discordant_or_split_read && !is_read_through_alignment)
+			fragment_statistics->add_fragment(bam_record, previously_seen_mate);
+	}
+
+	return (is_chimeric) ? FRAGMENT_CHIMERIC : FRAGMENT_COMPLETE;
+}
+
+// a range of a contig, which belongs to a shard
+struct bam_region_t {
+	int tid;
+	position_t start;
+	position_t end;
+};
+
+// fetch the next record of the shard
+// if no index is given, the file is read sequentially
+bool read_next_bam_record(samFile* bam_file, bam_hdr_t* bam_header, hts_idx_t* bam_index, const vector<bam_region_t>& regions, unsigned int& region, hts_itr_t*& iterator, bam1_t* bam_record) {
+
+	if (bam_index == NULL)
+		return sam_read1(bam_file, bam_header, bam_record) >= 0;
+
+	while (true) {
+		if (iterator != NULL) {
+			while (sam_itr_next(bam_file, iterator, bam_record) >= 0)
+				if (regions[region-1].tid == HTS_IDX_NOCOOR || bam_record->core.pos >= regions[region-1].start) // records which start before the region belong to the previous shard
+					return true;
+			hts_itr_destroy(iterator);
+			iterator = NULL;
+		}
+		if (region >= regions.size())
+			return false;
+		iterator = sam_itr_queryi(bam_index, regions[region].tid, regions[region].start, regions[region].end);
+		if (iterator == NULL) {
+			cerr << "ERROR: failed to query index of BAM file." << endl;
+			exit(1);
+		}
+		++region;
+	}
+}
+
+chimeric_alignment_extractor_t::chimeric_alignment_extractor_t(const bam_hdr_t* bam_header, contigs_t& contigs, const contigs_t& interesting_contigs, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, partial_bam_records_t* partial_bam_records, provisional_fusions_t* provisional_fusions, const bool pass_on_chimeric_fragments):
+	chimeric_alignments(chimeric_alignments), mapped_reads(mapped_reads), coverage(coverage), fragment_statistics(fragment_statistics), gene_annotation_index(gene_annotation_index), separate_chimeric_bam_file(separate_chimeric_bam_file), is_rna_bam_file(is_rna_bam_file), partial_bam_records(partial_bam_records), pass_on_chimeric_fragments(pass_on_chimeric_fragments), provisional_fusions(provisional_fusions), no_chimeric_reads(true) {
 
 	// add contigs which are not yet listed in <contigs>
 	// and make a map tid -> contig, because the contig IDs in the BAM file need not necessarily match the contig IDs in the GTF file
-	tid_to_contig_t tid_to_contig(bam_header->n_targets);
-	vector<bool> interesting_tids(bam_header->n_targets);
+	tid_to_contig.resize(bam_header->n_targets);
+	interesting_tids.resize(bam_header->n_targets);
 	for (int target = 0; target < bam_header->n_targets; ++target) {
 		string contig_name = removeChr(bam_header->target_name[target]);
 		contigs.insert(pair<string,contig_t>(contig_name, contigs.size())); // this fails (i.e., nothing is inserted), if the contig already exists
@@ -204,115 +313,411 @@ unsigned int read_chimeric_alignments(const string& bam_file_path, const string&
 		if (is_rna_bam_file) // only count reads of Aligned.out.bam, not of Chimeric.out.sam
 			interesting_tids[target] = (interesting_contigs.find(contig_name) != interesting_contigs.end()) || interesting_contigs.empty();
 	}
+}
 
-	// read BAM records
-	bam1_t* bam_record = bam_init1();
-	if (bam_record == NULL) {
-		cerr << "ERROR: failed to allocate memory." << endl;
-		exit(1);
-	}
-	buffered_bam_records_t buffered_bam_records; // holds the first mate until we have found the second
-	bool no_chimeric_reads = true;
-	while (sam_read1(bam_file, bam_header, bam_record) >= 0) {
+chimeric_alignment_extractor_t::~chimeric_alignment_extractor_t() {
+	for (buffered_bam_records_t::iterator buffered_bam_record = buffered_bam_records.begin(); buffered_bam_record != buffered_bam_records.end(); ++buffered_bam_record)
+		bam_destroy1(buffered_bam_record->second);
+}
 
-		if (is_rna_bam_file)
-			if ((bam_record->core.flag & (BAM_FSECONDARY | BAM_FUNMAP)) || (bam_record->core.flag & BAM_FPAIRED) && (bam_record->core.flag & BAM_FMUNMAP)) // ignore multi-mapping and unmapped reads
-				continue;
+void chimeric_alignment_extractor_t::add_record(bam1_t*& bam_record) {
 
-		// fix contig number to match ours
-		bam_record->core.tid = tid_to_contig[bam_record->core.tid];
+	if (is_rna_bam_file)
+		if ((bam_record->core.flag & (BAM_FSECONDARY | BAM_FUNMAP)) || (bam_record->core.flag & BAM_FPAIRED) && (bam_record->core.flag & BAM_FMUNMAP)) // ignore multi-mapping and unmapped reads
+			return;
 
-		if (separate_chimeric_bam_file && !is_rna_bam_file && (bam_record->core.flag & BAM_FSECONDARY)) { // extract supplementary reads from Chimeric.out.sam
-			add_chimeric_alignment(chimeric_alignments, bam_record, 0, 0, false, false, true);
-			no_chimeric_reads = false;
-			continue; // supplementary alignments are added directly; all other reads need to be buffered until we have found the mate (see below)
-		}
+	// fix contig number to match ours
+	bam_record->core.tid = tid_to_contig[bam_record->core.tid];
 
-		if (is_rna_bam_file && (bam_record->core.flag & BAM_FSUPPLEMENTARY)) { // extract supplementary reads from Aligned.out.bam
-			if (!separate_chimeric_bam_file) { // don't load supplementary reads twice (from Chimeric.out.sam and from Aligned.out.bam)
-				add_chimeric_alignment(chimeric_alignments, bam_record, 0, 0, false, false, true);
-				no_chimeric_reads = false;
-			}
-			continue;
-		}
+	// remember how many alignments of the read have been seen, so that the provisional fusions only count new ones
+	unsigned int previous_alignments = 0;
+	if (provisional_fusions != NULL) {
+		chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.find((char*) bam_get_qname(bam_record));
+		if (chimeric_alignment != chimeric_alignments.end())
+			previous_alignments = chimeric_alignment->second.size();
+	}
 
-		// count mapped reads on interesting contigs
-		if (interesting_tids[bam_record->core.tid])
-			mapped_reads++;
-
-		// for paired-end data we need to wait until we have read both mates
-		bam1_t* previously_seen_mate = NULL;
-		if (bam_record->core.flag & BAM_FPAIRED) {
-
-			// try to insert the mate into the buffered BAM records
-			// if there was already a record with the same read name, insertion will fail (->second set to false) and
-			// previously_seen_mate->first will point to the mate which was already in the buffered BAM records
-			pair<buffered_bam_records_t::iterator,bool> find_previously_seen_mate = buffered_bam_records.insert(pair<string,bam1_t*>((char*) bam_get_qname(bam_record), bam_record));
-			if (!find_previously_seen_mate.second) { // this is the second mate we have seen
-				previously_seen_mate = find_previously_seen_mate.first->second;
-				buffered_bam_records.erase(find_previously_seen_mate.first); // remove from lookup buffer, we don't need it anymore
+	bam1_t* previously_seen_mate;
+	bam_record_outcome_t outcome = process_bam_record(bam_record, previously_seen_mate, buffered_bam_records, chimeric_alignments, &coverage, &fragment_statistics, gene_annotation_index, separate_chimeric_bam_file, is_rna_bam_file, no_chimeric_reads);
+
+	if (provisional_fusions != NULL && (outcome == RECORD_SUPPLEMENTARY || outcome == FRAGMENT_CHIMERIC)) {
+		chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.find((char*) bam_get_qname(bam_record));
+		if (chimeric_alignment != chimeric_alignments.end() && chimeric_alignment->second.size() > previous_alignments)
+			provisional_fusions->add_alignments(chimeric_alignment->second, chimeric_alignment->second.size() - previous_alignments);
+	}
+
+	// count mapped reads on interesting contigs
+	if (outcome != RECORD_IGNORED && outcome != RECORD_SUPPLEMENTARY && interesting_tids[bam_record->core.tid])
+		mapped_reads++;
+
+	// pass on supplementary alignments and chimeric fragments to the gather step
+	if (partial_bam_records != NULL && pass_on_chimeric_fragments) {
+		if (outcome == RECORD_SUPPLEMENTARY || outcome == FRAGMENT_CHIMERIC) {
+			if (previously_seen_mate != NULL) {
+				partial_bam_record_t partial_bam_record = { previously_seen_mate, true };
+				partial_bam_records->push_back(partial_bam_record);
+				previously_seen_mate = NULL; // ownership was passed on
 			}
+			partial_bam_record_t partial_bam_record = { bam_dup1(bam_record), true };
+			partial_bam_records->push_back(partial_bam_record);
+		}
+	}
 
+	if (outcome == FIRST_MATE_BUFFERED) {
+		bam_record = bam_init1(); // allocate memory for the next record
+		if (bam_record == NULL) {
+			cerr << "ERROR: failed to allocate memory." << endl;
+			exit(1);
 		}
+	}
 
-		if ((bam_record->core.flag & BAM_FPAIRED) && previously_seen_mate == NULL) { // this is the first mate with the given read name, which we encounter
-			
-			bam_record = bam_init1(); // allocate memory for the next record
-			if (bam_record == NULL) {
-				cerr << "ERROR: failed to allocate memory." << endl;
-				exit(1);
-			}
+	if (previously_seen_mate != NULL)
+		bam_destroy1(previously_seen_mate);
+}
 
+void chimeric_alignment_extractor_t::finish() {
 
-		} else { // single-end data or we have already read the first mate previously
+	// mates which are still in the buffer have their partner in a different shard
+	if (partial_bam_records != NULL) {
+		for (buffered_bam_records_t::iterator buffered_bam_record = buffered_bam_records.begin(); buffered_bam_record != buffered_bam_records.end(); ++buffered_bam_record) {
+			partial_bam_record_t partial_bam_record = { buffered_bam_record->second, false };
+			partial_bam_records->push_back(partial_bam_record);
+		}
+		buffered_bam_records.clear();
+		return; // a single shard may well be empty, so the gather step checks the merged shards
+	}
 
-			if (separate_chimeric_bam_file && !is_rna_bam_file) { // this is Chimeric.out.sam => load everything
+	// sanity check: input files should not be empty
+	if (is_rna_bam_file && mapped_reads == 0) {
+		cerr << "ERROR: no normal reads found" << endl;
+		exit(1);
+	}
+	if (separate_chimeric_bam_file && !is_rna_bam_file || // this is Chimeric.out.sam
+	    !separate_chimeric_bam_file) { // this is Aligned.out.bam and STAR was run with --chimOutType WithinBAM
+		if (no_chimeric_reads) {
+			cerr << "ERROR: no split reads or discordant mates found (STAR must either be run with '--chimOutType WithinBAM' or the file 'Chimeric.out.sam' must be passed to Arriba via the argument -c)" << endl;
+			exit(1);
+		}
+	}
+}
 
-				add_chimeric_alignment(chimeric_alignments, bam_record);
-				if (previously_seen_mate != NULL)
-					add_chimeric_alignment(chimeric_alignments, previously_seen_mate);
-				no_chimeric_reads = false;
+// reports how much of the file has been read, how fast, and which fraction of the reads is chimeric
+// <file_size> is 0, if the file is a stream or if only parts of it are read
+void report_ingestion_progress(progress_reporter_t& progress, samFile* bam_file, const unsigned long long int file_size, const unsigned long long int records, const unsigned long int mapped_reads, const unsigned int chimeric_reads) {
+	ostringstream details;
+	details << fixed << setprecision(1);
+	if (file_size > 0) {
+		long long int position = get_file_position(bam_file);
+		details << (position / 1048576.0) << "/" << (file_size / 1048576.0) << "MB (" << (100.0 * position / file_size) << "%), ";
+	}
+	details << records << " records (" << setprecision(0) << (records / max(progress.get_elapsed_time(), 0.001)) << "/s), "
+	        << "chimeric=" << chimeric_reads << " (" << setprecision(2) << (100.0 * chimeric_reads / max(mapped_reads, 1UL)) << "% of mapped reads)";
+	progress.report(details.str());
+}
 
-			} else { // this is Aligned.out.bam => load only discordant mates and split reads, and only when there is no Chimeric.out.sam
+unsigned int read_chimeric_alignments(const string& bam_file_path, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, contigs_t& contigs, const contigs_t& interesting_contigs, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, const unsigned int shard, const unsigned int shards, partial_bam_records_t* partial_bam_records, provisional_fusions_t* provisional_fusions) {
 
-				bool is_read_through_alignment = false;
+	// open BAM file
+	samFile* bam_file = sam_open(bam_file_path.c_str(), "rb");
+	if (bam_file == NULL) {
+		cerr << "ERROR: failed to open '" << bam_file_path << "'." << endl;
+		exit(1);
+	}
+	if (bam_file->is_cram)
+		cram_set_option(bam_file->fp.cram, CRAM_OPT_REFERENCE, assembly_file_path.c_str());
+	bam_hdr_t* bam_header = sam_hdr_read(bam_file);
 
-				if ((bam_record->core.flag & BAM_FPAIRED) && !(bam_record->core.flag & BAM_FPROPER_PAIR) || // discordant mates
-				    bam_aux_get(bam_record, "SA") != NULL || previously_seen_mate != NULL && bam_aux_get(previously_seen_mate, "SA") != NULL) { // split-read
-					if (!separate_chimeric_bam_file) {
-						add_chimeric_alignment(chimeric_alignments, bam_record);
-						if (previously_seen_mate != NULL)
-							add_chimeric_alignment(chimeric_alignments, previously_seen_mate);
-						no_chimeric_reads = false;
-					}
-				} else { // only add read-through alignment, if it is not already a chimeric alignment
-					is_read_through_alignment = extract_read_through_alignment(chimeric_alignments, bam_record, previously_seen_mate, gene_annotation_index, separate_chimeric_bam_file);
+	chimeric_alignment_extractor_t extractor(bam_header, contigs, interesting_contigs, chimeric_alignments, mapped_reads, coverage, fragment_statistics, gene_annotation_index, separate_chimeric_bam_file, is_rna_bam_file, partial_bam_records, provisional_fusions);
+
+	// when the file is split into shards, an indexed file is split into contiguous ranges of the genome of equal size,
+	// such that every shard reads only its part of the file
+	// otherwise, every shard reads the entire file and keeps only the reads whose name hashes to the shard
+	hts_idx_t* bam_index = NULL;
+	vector<bam_region_t> regions;
+	if (shards > 1) {
+		bam_index = sam_index_load(bam_file, bam_file_path.c_str());
+		if (bam_index != NULL) {
+			unsigned long long int genome_size = 0;
+			for (int target = 0; target < bam_header->n_targets; ++target)
+				genome_size += bam_header->target_len[target];
+			unsigned long long int shard_start = genome_size * shard / shards;
+			unsigned long long int shard_end = genome_size * (shard + 1) / shards;
+			unsigned long long int target_start = 0;
+			for (int target = 0; target < bam_header->n_targets; ++target) {
+				unsigned long long int target_end = target_start + bam_header->target_len[target];
+				if (target_start < shard_end && target_end > shard_start) {
+					bam_region_t region = { target, (position_t) (max(shard_start, target_start) - target_start), (position_t) (min(shard_end, target_end) - target_start) };
+					regions.push_back(region);
 				}
-
-				coverage.add_fragment(bam_record, previously_seen_mate, is_read_through_alignment);
+				target_start = target_end;
+			}
+			if (shard == shards - 1) { // unmapped reads without coordinates are at the end of the file
+				bam_region_t region = { HTS_IDX_NOCOOR, 0, 0 };
+				regions.push_back(region);
 			}
+		}
+	}
+	unsigned int region = 0;
+	hts_itr_t* iterator = NULL;
+
+	// prefetch the file, unless only parts of it are read
+	read_ahead_t* read_ahead = (bam_index == NULL) ? new read_ahead_t(bam_file_path) : NULL;
 
-			if (previously_seen_mate != NULL)
-				bam_destroy1(previously_seen_mate);
+	// records are numbered by their position in the file, so that the gather step can restore the original order;
+	// ranges of the genome are read in the order of the file, so the shard number can be used as the most significant part
+	unsigned long long int record_number = (bam_index != NULL) ? (unsigned long long int) shard << 40 : 0;
+
+	// read BAM records
+	bam1_t* bam_record = bam_init1();
+	if (bam_record == NULL) {
+		cerr << "ERROR: failed to allocate memory." << endl;
+		exit(1);
+	}
+	progress_reporter_t progress("reading '" + bam_file_path + "'");
+	const unsigned long long int file_size = (bam_index == NULL) ? get_file_size(bam_file_path) : 0;
+	const unsigned long long int first_record_number = record_number;
+	unsigned long long int batch_start = record_number;
+	TRACEPOINT1(bam__batch__start, batch_start);
+	while (read_next_bam_record(bam_file, bam_header, bam_index, regions, region, iterator, bam_record)) {
+		if (record_number % READ_AHEAD_PROGRESS_INTERVAL == 0 && record_number != batch_start) {
+			if (read_ahead != NULL)
+				read_ahead->consumed(bam_file);
+			if (progress.is_due())
+				report_ingestion_progress(progress, bam_file, file_size, record_number - first_record_number, mapped_reads, chimeric_alignments.size());
+			TRACEPOINT2(bam__batch__end, batch_start, record_number - batch_start);
+			batch_start = record_number;
+			TRACEPOINT1(bam__batch__start, batch_start);
 		}
+		bam_record->id = record_number++;
+		if (shards > 1 && bam_index == NULL && hash_read_name(bam_get_qname(bam_record)) % shards != shard)
+			continue; // read belongs to a different shard
+		extractor.add_record(bam_record);
 	}
+	TRACEPOINT2(bam__batch__end, batch_start, record_number - batch_start);
 
 	// close BAM file
 	bam_destroy1(bam_record);
+	delete read_ahead;
+	if (bam_index != NULL)
+		hts_idx_destroy(bam_index);
 	bam_hdr_destroy(bam_header);
 	sam_close(bam_file);
 
+	extractor.finish();
+
+	return chimeric_alignments.size();
+}
+
+unsigned int read_chimeric_read_names(const vector<string>& bam_file_paths, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, const unsigned int shard, const unsigned int shards) {
+
+	const unsigned int previous_reads = chimeric_alignments.size();
+	for (auto bam_file_path = bam_file_paths.begin(); bam_file_path != bam_file_paths.end(); ++bam_file_path) {
+
+		// open BAM file
+		samFile* bam_file = sam_open(bam_file_path->c_str(), "rb");
+		if (bam_file == NULL) {
+			cerr << "ERROR: failed to open '" << *bam_file_path << "'." << endl;
+			exit(1);
+		}
+		if (bam_file->is_cram)
+			cram_set_option(bam_file->fp.cram, CRAM_OPT_REFERENCE, assembly_file_path.c_str());
+		bam_hdr_t* bam_header = sam_hdr_read(bam_file);
+
+		// add an empty entry for every read of the shard, the alignments are loaded by the gather step
+		bam1_t* bam_record = bam_init1();
+		if (bam_record == NULL) {
+			cerr << "ERROR: failed to allocate memory." << endl;
+			exit(1);
+		}
+		read_ahead_t read_ahead(*bam_file_path);
+		unsigned long long int record_number = 0;
+		while (sam_read1(bam_file, bam_header, bam_record) >= 0) {
+			if (++record_number % READ_AHEAD_PROGRESS_INTERVAL == 0)
+				read_ahead.consumed(bam_file);
+			if (shards > 1 && hash_read_name(bam_get_qname(bam_record)) % shards != shard)
+				continue; // read belongs to a different shard
+			chimeric_alignments[(char*) bam_get_qname(bam_record)];
+		}
+
+		// close BAM file
+		bam_destroy1(bam_record);
+		bam_hdr_destroy(bam_header);
+		sam_close(bam_file);
+	}
+
+	return chimeric_alignments.size() - previous_reads;
+}
+
+bool has_bam_index(const string& bam_file_path) {
+	samFile* bam_file = sam_open(bam_file_path.c_str(), "rb");
+	if (bam_file == NULL)
+		return false; // the error is reported, when the file is read
+	hts_idx_t* bam_index = sam_index_load(bam_file, bam_file_path.c_str());
+	bool has_index = bam_index != NULL;
+	if (has_index)
+		hts_idx_destroy(bam_index);
+	sam_close(bam_file);
+	return has_index;
+}
+
+bool sort_partial_bam_records_by_position_in_file(const partial_bam_record_t& x, const partial_bam_record_t& y) {
+	return x.record->id < y.record->id;
+}
+
+unsigned int read_chimeric_alignments(const vector<string>& bam_file_paths, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, contigs_t& contigs, const contigs_t& interesting_contigs, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, provisional_fusions_t* provisional_fusions) {
+
+	if (bam_file_paths.size() == 1)
+		return read_chimeric_alignments(bam_file_paths[0], assembly_file_path, chimeric_alignments, mapped_reads, coverage, fragment_statistics, contigs, interesting_contigs, gene_annotation_index, separate_chimeric_bam_file, is_rna_bam_file, 0, 1, NULL, provisional_fusions);
+
+	// every file is read by a separate thread, which extracts the chimeric alignments into a map of its own;
+	// the maps are merged in the order of the files, such that the alignments of a read are in the same order as if the files were concatenated;
+	// only mates whose partner is in a different file are passed on and replayed once all threads are done
+	// the threads must not share data structures which they modify, so each thread gets its own counters, coverage, and statistics
+	vector<samFile*> bam_files(bam_file_paths.size());
+	vector<bam_hdr_t*> bam_headers(bam_file_paths.size());
+	vector<chimeric_alignments_t> file_chimeric_alignments(bam_file_paths.size());
+	vector<unsigned long int> file_mapped_reads(bam_file_paths.size(), 0);
+	vector<coverage_t*> file_coverage(bam_file_paths.size(), NULL);
+	vector<fragment_statistics_t*> file_fragment_statistics(bam_file_paths.size(), NULL);
+	vector<partial_bam_records_t> file_partial_bam_records(bam_file_paths.size());
+	vector<chimeric_alignment_extractor_t*> extractors(bam_file_paths.size(), NULL);
+	for (unsigned int file = 0; file < bam_file_paths.size(); ++file) {
+
+		// open BAM file
+		bam_files[file] = sam_open(bam_file_paths[file].c_str(), "rb");
+		if (bam_files[file] == NULL) {
+			cerr << "ERROR: failed to open '" << bam_file_paths[file] << "'." << endl;
+			exit(1);
+		}
+		if (bam_files[file]->is_cram)
+			cram_set_option(bam_files[file]->fp.cram, CRAM_OPT_REFERENCE, assembly_file_path.c_str());
+		bam_headers[file] = sam_hdr_read(bam_files[file]);
+
+		// the read-through alignments of Aligned.out.bam are only extracted, if they are not in Chimeric.out.sam
+		// => let each thread know the names of the chimeric reads
+		if (separate_chimeric_bam_file && is_rna_bam_file)
+			for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment)
+				file_chimeric_alignments[file][chimeric_alignment->first];
+
+		// the coverage and the fragment statistics are only computed from Aligned.out.bam
+		if (file == 0 || !is_rna_bam_file) {
+			file_coverage[file] = &coverage;
+			file_fragment_statistics[file] = &fragment_statistics;
+		} else {
+			file_coverage[file] = new coverage_t(coverage);
+			file_coverage[file]->clear();
+			file_fragment_statistics[file] = new fragment_statistics_t(fragment_statistics);
+			file_fragment_statistics[file]->clear();
+		}
+
+		// the extractors are created in the order of the files, so that contigs which are missing from the annotation are numbered
+		// as if the files were read one after another
+		extractors[file] = new chimeric_alignment_extractor_t(bam_headers[file], contigs, interesting_contigs, file_chimeric_alignments[file], file_mapped_reads[file], *file_coverage[file], *file_fragment_statistics[file], gene_annotation_index, separate_chimeric_bam_file, is_rna_bam_file, &file_partial_bam_records[file], provisional_fusions, false);
+	}
+
+	// read BAM records
+	vector<thread> threads;
+	for (unsigned int file = 0; file < bam_file_paths.size(); ++file) {
+		threads.push_back(thread([&, file]() {
+			bam1_t* bam_record = bam_init1();
+			if (bam_record == NULL) {
+				cerr << "ERROR: failed to allocate memory." << endl;
+				exit(1);
+			}
+			// records are numbered by file and by their position in the file, so that they can be replayed in the order of the concatenated files
+			unsigned long long int record_number = (unsigned long long int) file << 40;
+			read_ahead_t read_ahead(bam_file_paths[file]);
+			progress_reporter_t progress("reading '" + bam_file_paths[file] + "'");
+			const unsigned long long int file_size = get_file_size(bam_file_paths[file]);
+			const unsigned long long int first_record_number = record_number;
+			unsigned long long int batch_start = record_number;
+			TRACEPOINT1(bam__batch__start, batch_start);
+			while (sam_read1(bam_files[file], bam_headers[file], bam_record) >= 0) {
+				if (record_number % READ_AHEAD_PROGRESS_INTERVAL == 0 && record_number != batch_start) {
+					read_ahead.consumed(bam_files[file]);
+					if (progress.is_due())
+						report_ingestion_progress(progress, bam_files[file], file_size, record_number - first_record_number, file_mapped_reads[file], file_chimeric_alignments[file].size());
+					TRACEPOINT2(bam__batch__end, batch_start, record_number - batch_start);
+					batch_start = record_number;
+					TRACEPOINT1(bam__batch__start, batch_start);
+				}
+				bam_record->id = record_number++;
+				extractors[file]->add_record(bam_record);
+			}
+			TRACEPOINT2(bam__batch__end, batch_start, record_number - batch_start);
+			bam_destroy1(bam_record);
+			extractors[file]->finish();
+		}));
+	}
+	for (unsigned int file = 0; file < bam_file_paths.size(); ++file)
+		threads[file].join();
+
+	// merge what the threads have extracted
+	partial_bam_records_t partial_bam_records;
+	bool found_chimeric_reads = false;
+	for (unsigned int file = 0; file < bam_file_paths.size(); ++file) {
+		found_chimeric_reads = found_chimeric_reads || extractors[file]->found_chimeric_reads();
+		delete extractors[file];
+		bam_hdr_destroy(bam_headers[file]);
+		sam_close(bam_files[file]);
+		mapped_reads += file_mapped_reads[file];
+		if (file_coverage[file] != &coverage) {
+			coverage.merge(*file_coverage[file]);
+			delete file_coverage[file];
+		}
+		if (file_fragment_statistics[file] != &fragment_statistics) {
+			fragment_statistics.merge(*file_fragment_statistics[file]);
+			delete file_fragment_statistics[file];
+		}
+		partial_bam_records.insert(partial_bam_records.end(), file_partial_bam_records[file].begin(), file_partial_bam_records[file].end());
+		file_partial_bam_records[file].clear();
+		for (chimeric_alignments_t::iterator chimeric_alignment = file_chimeric_alignments[file].begin(); chimeric_alignment != file_chimeric_alignments[file].end(); ++chimeric_alignment) {
+			if (chimeric_alignment->second.empty())
+				continue; // name of a chimeric read which was only passed to the thread (see above)
+			pair<chimeric_alignments_t::iterator,bool> merged_alignment = chimeric_alignments.insert(pair<string,mates_t>(chimeric_alignment->first, mates_t()));
+			if (merged_alignment.second) {
+				merged_alignment.first->second.swap(chimeric_alignment->second);
+				merged_alignment.first->second.single_end = chimeric_alignment->second.single_end;
+			} else { // a supplementary alignment of the read is in a different file
+				merged_alignment.first->second.insert(merged_alignment.first->second.end(), chimeric_alignment->second.begin(), chimeric_alignment->second.end());
+				merged_alignment.first->second.single_end = chimeric_alignment->second.single_end;
+			}
+		}
+		file_chimeric_alignments[file].clear();
+	}
+
+	return replay_partial_bam_records(partial_bam_records, chimeric_alignments, mapped_reads, coverage, fragment_statistics, gene_annotation_index, separate_chimeric_bam_file, is_rna_bam_file, found_chimeric_reads);
+}
+
+unsigned int replay_partial_bam_records(partial_bam_records_t& partial_bam_records, chimeric_alignments_t& chimeric_alignments, const unsigned long int mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, const bool found_chimeric_reads) {
+
+	// process the records in the order of the input file, so that the result is the same as when a single process reads the entire file
+	sort(partial_bam_records.begin(), partial_bam_records.end(), sort_partial_bam_records_by_position_in_file);
+
+	buffered_bam_records_t buffered_bam_records; // mates whose partner was read by a different shard
+	bool no_chimeric_reads = !found_chimeric_reads;
+	for (partial_bam_records_t::iterator partial_bam_record = partial_bam_records.begin(); partial_bam_record != partial_bam_records.end(); ++partial_bam_record) {
+		// the records were already filtered, their contigs translated, and they were counted by the scatter processes
+		bam1_t* previously_seen_mate;
+		bam_record_outcome_t outcome = process_bam_record(partial_bam_record->record, previously_seen_mate, buffered_bam_records, chimeric_alignments, (partial_bam_record->fragment_counted) ? NULL : &coverage, (partial_bam_record->fragment_counted) ? NULL : &fragment_statistics, gene_annotation_index, separate_chimeric_bam_file, is_rna_bam_file, no_chimeric_reads);
+		if (outcome != FIRST_MATE_BUFFERED)
+			bam_destroy1(partial_bam_record->record);
+		if (previously_seen_mate != NULL)
+			bam_destroy1(previously_seen_mate);
+	}
+	for (buffered_bam_records_t::iterator buffered_bam_record = buffered_bam_records.begin(); buffered_bam_record != buffered_bam_records.end(); ++buffered_bam_record)
+		bam_destroy1(buffered_bam_record->second);
+	partial_bam_records.clear();
+
 	// sanity check: input files should not be empty
 	if (is_rna_bam_file && mapped_reads == 0) {
 		cerr << "ERROR: no normal reads found" << endl;
 		exit(1);
 	}
-	if (separate_chimeric_bam_file && !is_rna_bam_file || // this is Chimeric.out.sam
-	    !separate_chimeric_bam_file) { // this is Aligned.out.bam and STAR was run with --chimOutType WithinBAM
-		if (no_chimeric_reads) {
-			cerr << "ERROR: no split reads or discordant mates found (STAR must either be run with '--chimOutType WithinBAM' or the file 'Chimeric.out.sam' must be passed to Arriba via the argument -c)" << endl;
-			exit(1);
-		}
+	if ((separate_chimeric_bam_file && !is_rna_bam_file || // this is Chimeric.out.sam
+	     !separate_chimeric_bam_file) && no_chimeric_reads) { // this is Aligned.out.bam and STAR was run with --chimOutType WithinBAM
+		cerr << "ERROR: no split reads or discordant mates found (STAR must either be run with '--chimOutType WithinBAM' or the file 'Chimeric.out.sam' must be passed to Arriba via the argument -c)" << endl;
+		exit(1);
 	}
 
 	return chimeric_alignments.size();
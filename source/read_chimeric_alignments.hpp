@@ -1,13 +1,80 @@
 #ifndef _READ_CHIMERIC_ALIGNMENTS_H
 #define _READ_CHIMERIC_ALIGNMENTS_H 1
 
+#include <map>
 #include <string>
+#include <vector>
+#include "sam.h"
 #include "common.hpp"
 #include "read_stats.hpp"
+#include "provisional_fusions.hpp"
 
 using namespace std;
 
-unsigned int read_chimeric_alignments(const string& bam_file_path, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, coverage_t& coverage, contigs_t& contigs, const contigs_t& interesting_contigs, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file);
+// a BAM record which a process that reads only a shard of the alignments (scatter)
+// passes on to the process which merges the shards (gather), because
+// - it is a supplementary alignment or belongs to a chimeric fragment, or
+// - its mate is in a different shard
+// the field bam1_t::id holds the position of the record in the input file, such that
+// the records can be processed in the same order as if the entire file was read by a single process
+struct partial_bam_record_t {
+	bam1_t* record;
+	bool fragment_counted; // true, if the fragment has already been added to the coverage and the fragment statistics by the scatter process
+};
+typedef vector<partial_bam_record_t> partial_bam_records_t;
+
+typedef map<string,bam1_t*> buffered_bam_records_t;
+typedef vector<contig_t> tid_to_contig_t;
+
+// extracts chimeric alignments, read-through alignments, mapped reads, coverage, and fragment statistics from a stream of BAM records
+// the records of a file may be passed in several batches, but in the order of the file
+class chimeric_alignment_extractor_t {
+	private:
+		chimeric_alignments_t& chimeric_alignments;
+		unsigned long int& mapped_reads;
+		coverage_t& coverage;
+		fragment_statistics_t& fragment_statistics;
+		const gene_annotation_index_t& gene_annotation_index;
+		const bool separate_chimeric_bam_file;
+		const bool is_rna_bam_file;
+		partial_bam_records_t* partial_bam_records;
+		const bool pass_on_chimeric_fragments;
+		provisional_fusions_t* provisional_fusions;
+		tid_to_contig_t tid_to_contig;
+		vector<bool> interesting_tids;
+		buffered_bam_records_t buffered_bam_records; // holds the first mate until we have found the second
+		bool no_chimeric_reads;
+	public:
+		// contigs from the header which are not yet listed in <contigs> are added
+		// if <pass_on_chimeric_fragments> is false, only mates whose partner is not found are added to <partial_bam_records>
+		chimeric_alignment_extractor_t(const bam_hdr_t* bam_header, contigs_t& contigs, const contigs_t& interesting_contigs, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, partial_bam_records_t* partial_bam_records = NULL, provisional_fusions_t* provisional_fusions = NULL, const bool pass_on_chimeric_fragments = true);
+		~chimeric_alignment_extractor_t();
+		// the record may be modified; if the extractor needs to keep it, <bam_record> is replaced with a newly allocated record
+		void add_record(bam1_t*& bam_record);
+		// must be called after the last record, checks that the input was not empty
+		void finish();
+		bool found_chimeric_reads() const { return !no_chimeric_reads; };
+};
+
+// when <shards> is greater than 1, only the alignments of the given shard are read and the records
+// which need to be seen by the gather step are added to <partial_bam_records> (see above)
+unsigned int read_chimeric_alignments(const string& bam_file_path, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, contigs_t& contigs, const contigs_t& interesting_contigs, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, const unsigned int shard = 0, const unsigned int shards = 1, partial_bam_records_t* partial_bam_records = NULL, provisional_fusions_t* provisional_fusions = NULL);
+
+// the scatter step only needs to know which reads are in Chimeric.out.sam, such that they are not mistaken for read-through alignments;
+// therefore, only the names of the reads are loaded without parsing the alignments, and when <shards> is greater than 1,
+// only the names which hash to <shard>, i.e., the reads which the shard keeps when the alignments are split by read name
+unsigned int read_chimeric_read_names(const vector<string>& bam_file_paths, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, const unsigned int shard, const unsigned int shards);
+
+// true, if the file has an index, in which case read_chimeric_alignments() splits it into ranges of the genome rather than by read name
+bool has_bam_index(const string& bam_file_path);
+
+// reads several files concurrently (one thread per file) with the same result as if they were concatenated,
+// e.g., the alignments of the individual lanes of a sample; mates may be spread over different files
+unsigned int read_chimeric_alignments(const vector<string>& bam_file_paths, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, contigs_t& contigs, const contigs_t& interesting_contigs, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, provisional_fusions_t* provisional_fusions = NULL);
+
+// process the records passed on by the scatter processes (or the threads reading several files) as if they were read from a single file
+// <found_chimeric_reads> tells if chimeric reads were found among the records which were not passed on
+unsigned int replay_partial_bam_records(partial_bam_records_t& partial_bam_records, chimeric_alignments_t& chimeric_alignments, const unsigned long int mapped_reads, coverage_t& coverage, fragment_statistics_t& fragment_statistics, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, const bool found_chimeric_reads = false);
 
 void assign_strands_from_strandedness(chimeric_alignments_t& chimeric_alignments, const strandedness_t strandedness);
 
@@ -1,69 +1,128 @@
 #include <fstream>
+#include <future>
+#include <mutex>
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include "bgzf.h"
 #include "sam.h"
+#include "read_ahead.hpp"
 #include "read_compressed_file.hpp"
 
 using namespace std;
 
-void autodecompress_file(const string& file_path, stringstream& file_content) {
+// returns an error message or an empty string, if the file was loaded successfully
+// errors are not reported here, because the function may run in a background thread (see preload_file())
+string decompress_file(const string& file_path, stringstream& file_content) {
 
 	if (file_path.length() >= 3 && file_path.substr(file_path.length() - 3) == ".gz") {
 
 		// allocate some memory for buffered reading
 		const unsigned int buffer_size = 64*1024;
 		char* buffer = (char*) malloc(buffer_size+1);
-		if (buffer == NULL) {
-			cerr << "ERROR: failed to allocate memory for decompression." << endl;
-			exit(1);
-		}
+		if (buffer == NULL)
+			return "failed to allocate memory for decompression.";
 
 		// open compressed file
 		BGZF* compressed_file;
 		compressed_file = bgzf_open(file_path.c_str(), "rb");
 		if (compressed_file == NULL) {
-			cerr << "ERROR: failed to open/decompress file '" << file_path << "'." << endl;
-			exit(1);
+			free(buffer);
+			return "failed to open/decompress file '" + file_path + "'.";
 		}
 
 		// read data from file and put it into stringstream object
-		int bytes_read;
-		do {
-			bytes_read = bgzf_read(compressed_file, buffer, buffer_size);
-			if (bytes_read < 0) {
-				cerr << "ERROR: failed to decompress file '" << file_path << "'." << endl;
-				exit(1);
-			}
-			buffer[bytes_read] = '\0';
-			file_content << buffer;
-			if (file_content.fail()) {
-				cerr << "ERROR: failed to load file '" << file_path << "' into memory." << endl;
-				exit(1);
-			}
-		} while (bytes_read == (unsigned int) buffer_size);
+		string error;
+		{
+			read_ahead_t read_ahead(file_path);
+			int bytes_read;
+			do {
+				bytes_read = bgzf_read(compressed_file, buffer, buffer_size);
+				read_ahead.consumed(compressed_file);
+				if (bytes_read < 0) {
+					error = "failed to decompress file '" + file_path + "'.";
+					break;
+				}
+				buffer[bytes_read] = '\0';
+				file_content << buffer;
+				if (file_content.fail()) {
+					error = "failed to load file '" + file_path + "' into memory.";
+					break;
+				}
+			} while (bytes_read == (unsigned int) buffer_size);
+		}
 
 		// free resources
 		bgzf_close(compressed_file);
 		free(buffer);
+		return error;
 
 	} else { // file is not compressed
 		
 		// copy file content to stringstream object
+		read_ahead_t read_ahead(file_path, true); // the content is copied in one go, so the consumer cannot report progress
 		ifstream uncompressed_file(file_path);
-		if (uncompressed_file.fail()) {
-			cerr << "ERROR: failed to open file '" << file_path << "'." << endl;
-			exit(1);
-		}
+		if (uncompressed_file.fail())
+			return "failed to open file '" + file_path + "'.";
 		if (uncompressed_file.rdbuf()->in_avail() > 0) { // don't attempt to read anything, when the input file is empty, or else it will cause an error
 			file_content << uncompressed_file.rdbuf();
-			if (file_content.fail()) {
-				cerr << "ERROR: failed to load file '" << file_path << "' into memory." << endl;
-				exit(1);
-			}
+			if (file_content.fail())
+				return "failed to load file '" + file_path + "' into memory.";
 		}
 		uncompressed_file.close();
+		return "";
 	}
 }
 
+
+// content of a file which was loaded in the background, or the reason why loading failed
+struct preloaded_file_t {
+	stringstream content;
+	string error;
+};
+
+// files which are being loaded in the background (see preload_file())
+unordered_map< string, future<preloaded_file_t> > preloaded_files;
+mutex preloaded_files_mutex;
+
+preloaded_file_t load_file_content(const string file_path) {
+	preloaded_file_t preloaded_file;
+	preloaded_file.error = decompress_file(file_path, preloaded_file.content);
+	return preloaded_file;
+}
+
+void preload_file(const string& file_path) {
+	lock_guard<mutex> lock(preloaded_files_mutex);
+	if (preloaded_files.find(file_path) == preloaded_files.end())
+		preloaded_files[file_path] = async(launch::async, load_file_content, file_path);
+}
+
+void autodecompress_file(const string& file_path, stringstream& file_content) {
+
+	// check if the file has been loaded in the background already
+	future<preloaded_file_t> preloaded_file;
+	{
+		lock_guard<mutex> lock(preloaded_files_mutex);
+		auto preloaded_file_by_path = preloaded_files.find(file_path);
+		if (preloaded_file_by_path != preloaded_files.end()) {
+			preloaded_file = move(preloaded_file_by_path->second);
+			preloaded_files.erase(preloaded_file_by_path); // a file is only consumed once, so we can free the memory afterwards
+		}
+	}
+
+	string error;
+	if (preloaded_file.valid()) {
+		preloaded_file_t loaded_file = preloaded_file.get(); // wait for the background thread to finish
+		file_content.swap(loaded_file.content); // hand over the buffer rather than copying the content
+		error = loaded_file.error;
+	} else {
+		error = decompress_file(file_path, file_content);
+	}
+
+	// errors of background threads are reported here, such that the program terminates in the main thread
+	if (!error.empty()) {
+		cerr << "ERROR: " << error << endl;
+		exit(1);
+	}
+}
@@ -8,4 +8,8 @@ using namespace std;
 
 void autodecompress_file(const string& file_path, stringstream& file_content);
 
+// start loading a file in the background
+// a subsequent call to autodecompress_file() with the same path waits for the background thread and returns its result
+void preload_file(const string& file_path);
+
 #endif /* _H_READ_COMPRESSED_FILE_H */
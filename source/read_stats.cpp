@@ -1,120 +1,152 @@
+#include <algorithm>
 #include <climits>
-#include <cmath>
 #include <iostream>
-#include <list>
+#include <stdint.h>
 #include <vector>
 #include "sam.h"
 #include "common.hpp"
 #include "annotation.hpp"
 #include "read_stats.hpp"
 
-bool estimate_mate_gap_distribution(const chimeric_alignments_t& chimeric_alignments, float& mate_gap_mean, float& mate_gap_stddev, const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index) {
+fragment_statistics_t::fragment_statistics_t(const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index):
+	gene_annotation_index(&gene_annotation_index), exon_annotation_index(&exon_annotation_index) {
+}
 
-	// use MATE1 and MATE2 from split reads to calculate insert size distribution
-	list<int> mate_gaps;
-	unsigned int count = 0;
-	for (chimeric_alignments_t::const_iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
-		if (chimeric_alignment->second.filter != NULL || chimeric_alignment->second.single_end)
-			continue;
-		if (chimeric_alignment->second.size() == 3) { // split read
+// 64-bit FNV-1a hash of the read name followed by a finalizer which spreads the bits evenly
+// the hash must not depend on the platform or the standard library, because the sample of a scatter process may be merged by another host
+uint64_t hash_read_name(const char* read_name) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (; *read_name != '\0'; ++read_name)
+		hash = (hash ^ (unsigned char) *read_name) * 1099511628211ULL;
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// checks if all introns of a mate coincide with annotated splice sites of the given gene and if there is at least one
+bool is_mate_spliced(const bam1_t* mate, const gene_t gene, const exon_annotation_index_t& exon_annotation_index) {
+	bool spliced = false;
+	position_t position = mate->core.pos;
+	const uint32_t* cigar = bam_get_cigar(mate);
+	for (unsigned int i = 0; i < mate->core.n_cigar; ++i) {
+		if (bam_cigar_op(cigar[i]) == BAM_CREF_SKIP) {
+			if (!is_breakpoint_spliced(gene, DOWNSTREAM, position - 1, exon_annotation_index) ||
+			    !is_breakpoint_spliced(gene, UPSTREAM, position + bam_cigar_oplen(cigar[i]), exon_annotation_index))
+				return false;
+			spliced = true;
+		}
+		if (bam_cigar_type(bam_cigar_op(cigar[i])) & 2/*consume reference*/)
+			position += bam_cigar_oplen(cigar[i]);
+	}
+	return spliced;
+}
+
+// keep the fragment, if it is among the <FRAGMENT_SAMPLE_SIZE> fragments with the smallest hashes seen so far
+void fragment_statistics_t::add_to_sample(const sampled_fragment_t& fragment) {
+	if (sample.size() < FRAGMENT_SAMPLE_SIZE) {
+		sample.push_back(fragment);
+		push_heap(sample.begin(), sample.end());
+	} else if (fragment < sample.front()) {
+		pop_heap(sample.begin(), sample.end());
+		sample.back() = fragment;
+		push_heap(sample.begin(), sample.end());
+	}
+}
+
+void fragment_statistics_t::add_fragment(const bam1_t* mate1, const bam1_t* mate2) {
+
+	// only concordant mates are used
+	if (mate2 != NULL && (!(mate1->core.flag & BAM_FPROPER_PAIR) || mate1->core.tid != mate2->core.tid))
+		return;
+
+	// don't bother looking up the annotation, if the fragment would not make it into the sample anyway
+	sampled_fragment_t fragment;
+	fragment.hash = hash_read_name(bam_get_qname(mate1));
+	if (sample.size() >= FRAGMENT_SAMPLE_SIZE && !(fragment < sample.front()))
+		return;
+
+	// use only fragments which unambiguously map to a single gene
+	position_t start = mate1->core.pos;
+	position_t end = bam_endpos(mate1) - 1;
+	if (mate2 != NULL) {
+		start = min(start, (position_t) mate2->core.pos);
+		end = max(end, (position_t) bam_endpos(mate2) - 1);
+	}
+	gene_set_t genes;
+	get_annotation_by_coordinate(mate1->core.tid, start, end, genes, *gene_annotation_index);
+	if (genes.size() != 1)
+		return;
+	gene_t gene = *genes.begin();
+
+	// measure the gap between the end of the forward mate and the start of the reverse mate along the transcript
+	fragment.mate_gap = INT_MIN;
+	if (mate2 != NULL && (mate1->core.flag & BAM_FREVERSE) != (mate2->core.flag & BAM_FREVERSE)) {
+		const bam1_t* forward_mate = (mate1->core.flag & BAM_FREVERSE) ? mate2 : mate1;
+		const bam1_t* reverse_mate = (mate1->core.flag & BAM_FREVERSE) ? mate1 : mate2;
+		fragment.mate_gap = get_spliced_distance(forward_mate->core.tid, bam_endpos(forward_mate) - 1, reverse_mate->core.pos, DOWNSTREAM, UPSTREAM, gene, *exon_annotation_index);
+	}
+
+	// use only fragments which are spliced to determine strandedness, because this is a sure indication that they originate from the gene
+	fragment.strand = '?';
+	if (is_mate_spliced(mate1, gene, *exon_annotation_index) || mate2 != NULL && is_mate_spliced(mate2, gene, *exon_annotation_index)) {
+		const bam1_t* read1 = (mate2 == NULL || (mate1->core.flag & BAM_FREAD1)) ? mate1 : mate2;
+		strand_t read1_strand = (read1->core.flag & BAM_FREVERSE) ? REVERSE : FORWARD;
+		fragment.strand = (read1_strand == gene->strand) ? '+' : '-';
+	}
 
-			alignment_t const* forward_mate = &(chimeric_alignment->second[MATE1]);
-			alignment_t const* reverse_mate = &(chimeric_alignment->second[SPLIT_READ]);
-			if (forward_mate->strand == REVERSE)
-				swap(forward_mate, reverse_mate);
+	if (fragment.mate_gap != INT_MIN || fragment.strand != '?')
+		add_to_sample(fragment);
+}
 
-			mate_gaps.push_back(get_spliced_distance(forward_mate->contig, forward_mate->end, reverse_mate->start, DOWNSTREAM, UPSTREAM, *forward_mate->genes.begin(), exon_annotation_index));
+// the mate gap distribution is not distributed normally due to alternative splicing and there are many outliers,
+// so the mean and the standard deviation are estimated robustly from the median and the median absolute deviation (MAD)
+bool fragment_statistics_t::estimate_mate_gap_distribution(float& mate_gap_mean, float& mate_gap_stddev) const {
 
+	vector<unsigned int> histogram(MAX_MATE_GAP - MIN_MATE_GAP + 1, 0);
+	unsigned int count = 0;
+	for (vector<sampled_fragment_t>::const_iterator fragment = sample.begin(); fragment != sample.end(); ++fragment) {
+		if (fragment->mate_gap != INT_MIN) {
+			histogram[min(max(fragment->mate_gap, MIN_MATE_GAP), MAX_MATE_GAP) - MIN_MATE_GAP]++;
 			count++;
-			if (count > 100000)
-				break; // the sample size should be big enough
 		}
 	}
 
 	if (count < 10000) {
-		cerr << "WARNING: not enough chimeric reads to estimate mate gap distribution, using default values" << endl;
+		cerr << "WARNING: not enough concordant mates to estimate mate gap distribution, using default values" << endl;
 		return false;
 	}
 
-	bool no_more_outliers = false;
-	while (true) {
-		// calculate mean
-		mate_gap_mean = 0;
-		for (list<int>::iterator i = mate_gaps.begin(); i != mate_gaps.end(); i++)
-			mate_gap_mean += *i;
-		mate_gap_mean /= count;
-
-		// calculate standard deviation
-		mate_gap_stddev = 0;
-		for (list<int>::iterator i = mate_gaps.begin(); i != mate_gaps.end(); i++)
-			mate_gap_stddev += (*i - mate_gap_mean) * (*i - mate_gap_mean);
-		mate_gap_stddev = sqrt(1.0/(count-1) * mate_gap_stddev);
-
-		// due to alterantive splicing the mate gap distribution is not distributed normally
-		// there are usually many outliers which inflate the standard deviation
-		// => remove outliers until the distribution resembles a normal distribution
-		//    (i.e., 68.24% are inside the range: mean +/- 1*stddev)
-		unsigned int within_range = 0;
-		for (list<int>::iterator i = mate_gaps.begin(); i != mate_gaps.end(); ++i)
-			if (*i > mate_gap_mean - mate_gap_stddev || *i < mate_gap_mean + mate_gap_stddev)
-				within_range++;
-		if (1.0*within_range/count < 0.683 || no_more_outliers)
-			break; // all outliers have been removed
-
-		// remove outliers, if the mate gap distribution is not yet normally distributed
-		no_more_outliers = true;
-		for (list<int>::iterator i = mate_gaps.begin(); i != mate_gaps.end();) {
-			if (*i < mate_gap_mean - 3*mate_gap_stddev || *i > mate_gap_mean + 3*mate_gap_stddev) {
-				i = mate_gaps.erase(i); // remove outlier
-				count--;
-				no_more_outliers = false;
-			} else {
-				++i;
-			}
-		}
-	}
+	// find median
+	unsigned int median = 0;
+	for (unsigned int cumulative_count = 0; (cumulative_count += histogram[median]) <= count/2; ++median);
+
+	// find median of absolute deviations from the median
+	vector<unsigned int> deviations(histogram.size(), 0);
+	for (unsigned int bin = 0; bin < histogram.size(); ++bin)
+		deviations[(bin > median) ? bin - median : median - bin] += histogram[bin];
+	unsigned int median_absolute_deviation = 0;
+	for (unsigned int cumulative_count = 0; (cumulative_count += deviations[median_absolute_deviation]) <= count/2; ++median_absolute_deviation);
 
+	mate_gap_mean = (int) median + MIN_MATE_GAP;
+	mate_gap_stddev = 1.4826 * median_absolute_deviation; // scale factor for normally distributed data
 	return true;
 }
 
-strandedness_t detect_strandedness(const chimeric_alignments_t& chimeric_alignments, const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index) {
+strandedness_t fragment_statistics_t::detect_strandedness() const {
 
 	const unsigned int sample_size = 100; // examine at least this many reads to determine strandedness
 	const float threshold = 0.75; // fraction of reads which must support strandedness to be convinced
 
 	unsigned int count = 0;
 	unsigned int matching_strand = 0;
-	for (chimeric_alignments_t::const_iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
-		if (chimeric_alignment->second.size() == 3) { // split-read
-
-			// use only read-through alignments and duplications to determine strandedness,
-			// because with inversions and translocations it is not clear what the originating strand is
-			if (chimeric_alignment->second[SPLIT_READ].contig == chimeric_alignment->second[SUPPLEMENTARY].contig &&
-			    chimeric_alignment->second[SPLIT_READ].strand == chimeric_alignment->second[SUPPLEMENTARY].strand &&
-			    abs(chimeric_alignment->second[SPLIT_READ].start - chimeric_alignment->second[SUPPLEMENTARY].start) < 400000) {
-
-				// use only reads with unambigously map to a single gene
-				gene_set_t genes;
-				get_annotation_by_coordinate(chimeric_alignment->second[SPLIT_READ].contig, chimeric_alignment->second[SPLIT_READ].start, chimeric_alignment->second[SPLIT_READ].end, genes, gene_annotation_index);
-				if (genes.size() == 1) {
-
-					// use only reads which are spliced, because this is a sure indication that the read originates from the gene
-					direction_t direction = (chimeric_alignment->second[SPLIT_READ].strand == FORWARD) ? UPSTREAM : DOWNSTREAM;
-					position_t position = (chimeric_alignment->second[SPLIT_READ].strand == FORWARD) ? chimeric_alignment->second[SPLIT_READ].start : chimeric_alignment->second[SPLIT_READ].end;
-					if (is_breakpoint_spliced(*genes.begin(), direction, position, exon_annotation_index)) {
-
-						// check if alignment matches strand of annotated gene
-						if (chimeric_alignment->second[SPLIT_READ].first_in_pair && chimeric_alignment->second[SPLIT_READ].strand == (**genes.begin()).strand ||
-						    chimeric_alignment->second[MATE1].first_in_pair && chimeric_alignment->second[MATE1].strand == (**genes.begin()).strand)
-							matching_strand++;
-
-						count++;
-						if (count >= sample_size)
-							break; // we have sufficient statistical power
-
-					}
-				}
-			}
+	for (vector<sampled_fragment_t>::const_iterator fragment = sample.begin(); fragment != sample.end(); ++fragment) {
+		if (fragment->strand != '?') {
+			if (fragment->strand == '+')
+				matching_strand++;
+			count++;
 		}
 	}
 
@@ -128,21 +160,58 @@ strandedness_t detect_strandedness(const chimeric_alignments_t& chimeric_alignme
 		return STRANDEDNESS_NO; // not enough signal => assume no
 }
 
+void fragment_statistics_t::clear() {
+	sample.clear();
+}
+
+// the merged sample is the same as if all fragments had been added to a single fragment_statistics_t
+void fragment_statistics_t::merge(const fragment_statistics_t& other) {
+	for (vector<sampled_fragment_t>::const_iterator fragment = other.sample.begin(); fragment != other.sample.end(); ++fragment)
+		add_to_sample(*fragment);
+}
+
 // initialize data structure to compute coverage for windows of size <COVERAGE_RESOLUTION>
-coverage_t::coverage_t(const contigs_t& contigs, const assembly_t& assembly) {
-	fragment_starts.resize(contigs.size());
-	fragment_ends.resize(contigs.size());
-	coverage.resize(contigs.size());
+// blocks of windows are allocated on demand
+coverage_t::coverage_t(const contigs_t& contigs, const assembly_t& assembly): precomputed(false) {
+	windows.resize(contigs.size());
+	block_index.resize(contigs.size());
 	for (assembly_t::const_iterator contig = assembly.begin(); contig != assembly.end(); ++contig) {
 		if (!contig->second.empty()) {
-			unsigned int windows = contig->second.size() / COVERAGE_RESOLUTION + 2; //+2 to avoid array-out-of-bounds errors
-			fragment_starts[contig->first].resize(windows);
-			fragment_ends[contig->first].resize(windows);
-			coverage[contig->first].resize(windows);
+			windows[contig->first] = contig->second.size() / COVERAGE_RESOLUTION + 2; //+2 to avoid array-out-of-bounds errors
+			block_index[contig->first].resize((windows[contig->first] + COVERAGE_BLOCK_SIZE - 1) / COVERAGE_BLOCK_SIZE);
 		}
 	}
 }
 
+const coverage_t::coverage_block_t* coverage_t::get_block(const contig_t contig, const unsigned int window) const {
+	unsigned int block = block_index[contig][window / COVERAGE_BLOCK_SIZE];
+	return (block == 0) ? NULL : &blocks[block - 1];
+}
+
+coverage_t::coverage_block_t& coverage_t::get_writable_block(const contig_t contig, const unsigned int window) {
+	unsigned int& block = block_index[contig][window / COVERAGE_BLOCK_SIZE];
+	if (block == 0) {
+		blocks.resize(blocks.size() + 1);
+		blocks.back().coverage.resize(COVERAGE_BLOCK_SIZE);
+		block = blocks.size();
+	} else if (blocks[block - 1].coverage.empty()) { // the block has been compacted
+		coverage_block_t& compacted_block = blocks[block - 1];
+		compacted_block.coverage.assign(compacted_block.compact_coverage.begin(), compacted_block.compact_coverage.end());
+		vector<unsigned char>().swap(compacted_block.compact_coverage);
+	}
+	return blocks[block - 1];
+}
+
+void coverage_t::add_coverage(const contig_t contig, const unsigned int window, const unsigned int coverage) {
+	unsigned short int& window_coverage = get_writable_block(contig, window).coverage[window % COVERAGE_BLOCK_SIZE];
+	window_coverage = min((unsigned int) USHRT_MAX, window_coverage + coverage);
+}
+
+unsigned int coverage_t::get_window_coverage(const contig_t contig, const unsigned int window) const {
+	const coverage_block_t* block = get_block(contig, window);
+	return (block == NULL) ? 0 : block->get_coverage(window % COVERAGE_BLOCK_SIZE);
+}
+
 // add alignment to coverage
 void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, const bool is_read_through_alignment) {
 
@@ -150,8 +219,8 @@ void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, const bool is_read_t
 	if (mate2 == NULL)
 		mate2 = mate1;
 
-	if ((unsigned int) mate1->core.tid >= fragment_starts.size() || fragment_starts[mate1->core.tid].empty() ||
-	    (unsigned int) mate2->core.tid >= fragment_starts.size() || fragment_starts[mate2->core.tid].empty())
+	if ((unsigned int) mate1->core.tid >= windows.size() || windows[mate1->core.tid] == 0 ||
+	    (unsigned int) mate2->core.tid >= windows.size() || windows[mate2->core.tid] == 0)
 		return; // ignore reads on uninteresting contigs
 
 	bool is_chimeric = is_read_through_alignment;
@@ -171,9 +240,9 @@ void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, const bool is_read_t
 	// store start of fragment
 	if (!is_chimeric) { // the 'no_coverage' filter should only consider non-chimeric reads
 		if (!(mate1->core.flag & BAM_FREVERSE) || !(mate1->core.flag & BAM_FPAIRED))
-			fragment_starts[mate1->core.tid][mate1->core.pos/COVERAGE_RESOLUTION] = true;
+			get_writable_block(mate1->core.tid, mate1->core.pos/COVERAGE_RESOLUTION).fragment_starts[mate1->core.pos/COVERAGE_RESOLUTION % COVERAGE_BLOCK_SIZE] = true;
 		else
-			fragment_starts[mate2->core.tid][mate2->core.pos/COVERAGE_RESOLUTION] = true;
+			get_writable_block(mate2->core.tid, mate2->core.pos/COVERAGE_RESOLUTION).fragment_starts[mate2->core.pos/COVERAGE_RESOLUTION % COVERAGE_BLOCK_SIZE] = true;
 	}
 
 	// compute coverage from CIGAR string
@@ -232,9 +301,8 @@ void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, const bool is_read_t
 		// increase coverage counter of windows that CIGAR element overlaps with
 		if (bam_cigar_type(bam_cigar_op(cigar_op)) & 1/*consume query*/) {
 			while (window <= position/COVERAGE_RESOLUTION) {
-				if (coverage[contig][window] < USHRT_MAX)
-					if (position - window * COVERAGE_RESOLUTION >= COVERAGE_RESOLUTION/2) // read must overlap at least half of the window
-						coverage[contig][window]++;
+				if (position - window * COVERAGE_RESOLUTION >= COVERAGE_RESOLUTION/2) // read must overlap at least half of the window
+					add_coverage(contig, window, 1);
 				++window;
 			}
 		} else {
@@ -246,20 +314,21 @@ void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, const bool is_read_t
 	// store end of fragment
 	if (!is_chimeric) { // the 'no_coverage' filter should only consider non-chimeric reads
 		if ((mate1->core.flag & BAM_FREVERSE) || !(mate1->core.flag & BAM_FPAIRED))
-			fragment_ends[mate1->core.tid][(position1-1)/COVERAGE_RESOLUTION] = true;
+			get_writable_block(mate1->core.tid, (position1-1)/COVERAGE_RESOLUTION).fragment_ends[(position1-1)/COVERAGE_RESOLUTION % COVERAGE_BLOCK_SIZE] = true;
 		else
-			fragment_ends[mate2->core.tid][(position2-1)/COVERAGE_RESOLUTION] = true;
+			get_writable_block(mate2->core.tid, (position2-1)/COVERAGE_RESOLUTION).fragment_ends[(position2-1)/COVERAGE_RESOLUTION % COVERAGE_BLOCK_SIZE] = true;
 	}
 }
 
 // returns true, if a fragment begins at the given position
 bool coverage_t::fragment_starts_here(const contig_t contig, const position_t start, const position_t end) const {
-	if ((unsigned int) contig >= fragment_starts.size())
+	if ((unsigned int) contig >= windows.size())
 		return false;
 	for (int window = start/COVERAGE_RESOLUTION + 1; window <= end/COVERAGE_RESOLUTION; ++window) {
-		if ((unsigned int) window >= fragment_starts[contig].size())
+		if ((unsigned int) window >= windows[contig])
 			return false;
-		if (fragment_starts[contig][window])
+		const coverage_block_t* block = get_block(contig, window);
+		if (block != NULL && block->fragment_starts[window % COVERAGE_BLOCK_SIZE])
 			return true;
 	}
 	return false;
@@ -267,12 +336,13 @@ bool coverage_t::fragment_starts_here(const contig_t contig, const position_t st
 
 // returns true, if a fragment ends at the given position
 bool coverage_t::fragment_ends_here(const contig_t contig, const position_t start, const position_t end) const {
-	if ((unsigned int) contig >= fragment_ends.size())
+	if ((unsigned int) contig >= windows.size())
 		return false;
 	for (int window = start/COVERAGE_RESOLUTION; window < end/COVERAGE_RESOLUTION; ++window) {
-		if ((unsigned int) window >= fragment_ends[contig].size())
+		if ((unsigned int) window >= windows[contig])
 			return false;
-		if (fragment_ends[contig][window])
+		const coverage_block_t* block = get_block(contig, window);
+		if (block != NULL && block->fragment_ends[window % COVERAGE_BLOCK_SIZE])
 			return true;
 	}
 	return false;
@@ -280,15 +350,74 @@ bool coverage_t::fragment_ends_here(const contig_t contig, const position_t star
 
 // get coverage within a window of <COVERAGE_RESOLUTION> upstream or downstream of given position
 int coverage_t::get_coverage(const contig_t contig, const position_t position, const direction_t direction) const {
-	if ((unsigned int) contig >= coverage.size() || coverage[contig].empty())
+	if ((unsigned int) contig >= windows.size() || windows[contig] == 0)
 		return -1;
 	if (direction == UPSTREAM) {
 		if (position < COVERAGE_RESOLUTION)
 			return 0;
 		else
-			return coverage[contig][position/COVERAGE_RESOLUTION-1];
+			return get_window_coverage(contig, position/COVERAGE_RESOLUTION-1);
 	} else { // direction == DOWNSTREAM
-		return coverage[contig][position/COVERAGE_RESOLUTION+1];
+		return get_window_coverage(contig, position/COVERAGE_RESOLUTION+1);
 	}
 }
 
+int coverage_t::get_coverage(const contig_t contig, const position_t position) const {
+	if ((unsigned int) contig >= windows.size() || windows[contig] == 0 || position < 0 || (unsigned int) position/COVERAGE_RESOLUTION >= windows[contig])
+		return -1;
+	return get_window_coverage(contig, position/COVERAGE_RESOLUTION);
+}
+
+void coverage_t::clear() {
+	blocks.clear();
+	for (contig_t contig = 0; (unsigned int) contig < block_index.size(); ++contig)
+		fill(block_index[contig].begin(), block_index[contig].end(), 0);
+}
+
+void coverage_t::merge(const coverage_t& other) {
+	for (contig_t contig = 0; (unsigned int) contig < other.block_index.size(); ++contig) {
+		for (unsigned int block = 0; block < other.block_index[contig].size(); ++block) {
+			if (other.block_index[contig][block] == 0)
+				continue; // nothing to merge
+			const coverage_block_t& other_block = other.blocks[other.block_index[contig][block] - 1];
+			coverage_block_t& merged_block = get_writable_block(contig, block * COVERAGE_BLOCK_SIZE);
+			for (unsigned int window = 0; window < COVERAGE_BLOCK_SIZE; ++window)
+				merged_block.coverage[window] = min((unsigned int) USHRT_MAX, merged_block.coverage[window] + other_block.get_coverage(window));
+			merged_block.fragment_starts |= other_block.fragment_starts;
+			merged_block.fragment_ends |= other_block.fragment_ends;
+		}
+	}
+}
+
+void coverage_t::compact() {
+	for (vector<coverage_block_t>::iterator block = blocks.begin(); block != blocks.end(); ++block) {
+		if (block->coverage.empty() || *max_element(block->coverage.begin(), block->coverage.end()) >= UCHAR_MAX)
+			continue; // block is compacted already or needs two bytes per window
+		block->compact_coverage.assign(block->coverage.begin(), block->coverage.end());
+		vector<unsigned short int>().swap(block->coverage);
+	}
+}
+
+void coverage_t::add_window_coverage(const contig_t contig, const position_t position, const unsigned int coverage) {
+	if ((unsigned int) contig < windows.size() && position >= 0 && (unsigned int) position/COVERAGE_RESOLUTION < windows[contig])
+		add_coverage(contig, position/COVERAGE_RESOLUTION, coverage);
+}
+
+void coverage_t::mark_fragment_start(const contig_t contig, const position_t position) {
+	if ((unsigned int) contig < windows.size() && position >= 0 && (unsigned int) position/COVERAGE_RESOLUTION < windows[contig])
+		get_writable_block(contig, position/COVERAGE_RESOLUTION).fragment_starts[position/COVERAGE_RESOLUTION % COVERAGE_BLOCK_SIZE] = true;
+}
+
+void coverage_t::mark_fragment_end(const contig_t contig, const position_t position) {
+	if ((unsigned int) contig < windows.size() && position >= 0 && (unsigned int) position/COVERAGE_RESOLUTION < windows[contig])
+		get_writable_block(contig, position/COVERAGE_RESOLUTION).fragment_ends[position/COVERAGE_RESOLUTION % COVERAGE_BLOCK_SIZE] = true;
+}
+
+unsigned long long int coverage_t::get_allocated_memory() const {
+	unsigned long long int memory = blocks.capacity() * sizeof(coverage_block_t);
+	for (vector<coverage_block_t>::const_iterator block = blocks.begin(); block != blocks.end(); ++block)
+		memory += block->coverage.capacity() * sizeof(unsigned short int) + block->compact_coverage.capacity();
+	for (contig_t contig = 0; (unsigned int) contig < block_index.size(); ++contig)
+		memory += block_index[contig].capacity() * sizeof(unsigned int);
+	return memory;
+}
@@ -1,30 +1,97 @@
 #ifndef _READ_STATS_H
 #define _READ_STATS_H 1
 
+#include <bitset>
+#include <istream>
+#include <ostream>
+#include <stdint.h>
 #include <vector>
 #include "common.hpp"
 #include "annotation.hpp"
 
 using namespace std;
 
-bool estimate_mate_gap_distribution(const chimeric_alignments_t& chimeric_alignments, float& mate_gap_mean, float& mate_gap_stddev, const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index);
+const unsigned int FRAGMENT_SAMPLE_SIZE = 100000; // number of fragments to estimate the mate gap distribution and strandedness from
+const int MIN_MATE_GAP = -1000; // the mate gap histogram covers this range, larger/smaller gaps are counted in the outermost bins
+const int MAX_MATE_GAP = 5000;
 
-strandedness_t detect_strandedness(const chimeric_alignments_t& chimeric_alignments, const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index);
+// hash of a read name which is the same on every platform
+uint64_t hash_read_name(const char* read_name);
+
+// estimates the mate gap distribution and strandedness from the concordant fragments while the alignments are read
+// the fragments whose read names have the smallest hash values are sampled, such that the sample does not depend on
+// the order of the reads or on how the input is split into files or shards
+class fragment_statistics_t {
+	private:
+		struct sampled_fragment_t {
+			uint64_t hash;
+			int mate_gap; // INT_MIN, if the mate gap is unknown (e.g., single-end data)
+			char strand; // '+' if read 1 matches the strand of the gene, '-' if it does not, and '?' if there is no spliced mate
+			bool operator<(const sampled_fragment_t& other) const { return hash < other.hash; };
+		};
+		const gene_annotation_index_t* gene_annotation_index;
+		const exon_annotation_index_t* exon_annotation_index;
+		vector<sampled_fragment_t> sample; // max-heap by hash, such that the fragment with the highest hash can be replaced
+		void add_to_sample(const sampled_fragment_t& fragment);
+	public:
+		fragment_statistics_t(const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index);
+		void add_fragment(const bam1_t* mate1, const bam1_t* mate2); // <mate2> is NULL for single-end data
+		bool estimate_mate_gap_distribution(float& mate_gap_mean, float& mate_gap_stddev) const;
+		strandedness_t detect_strandedness() const;
+		// used to combine the statistics of several input files which are read concurrently
+		void clear();
+		void merge(const fragment_statistics_t& other);
+		// used to pass the statistics of a shard from the scatter step to the gather step (see partial_state.hpp)
+		friend void write_fragment_statistics(ostream& out, const fragment_statistics_t& fragment_statistics);
+		friend bool merge_fragment_statistics(istream& in, fragment_statistics_t& fragment_statistics);
+};
 
 const int COVERAGE_RESOLUTION = 20; // at what resolution in bp to calculate the coverage
+const unsigned int COVERAGE_BLOCK_SIZE = 4096; // number of windows per block of the coverage
 // for each contig store for every window of <COVERAGE_RESOLUTION> bp whether a read starts/ends here
 // this information is needed by the 'no_coverage' filter
+// the windows are grouped into blocks, which are only allocated when a read overlaps with them,
+// such that the memory scales with the expressed part of the genome rather than with the size of the genome
 class coverage_t {
 	private:
-		vector< vector<bool> > fragment_starts; // for each window, store if a fragment starts here
-		vector< vector<bool> > fragment_ends; // for each window, store if a fragment ends here
-		vector< vector<unsigned short int> > coverage; // for each window, store the coverage
+		struct coverage_block_t {
+			vector<unsigned short int> coverage; // for each window, store the coverage; empty, if the block is compacted
+			vector<unsigned char> compact_coverage; // used instead of <coverage> by compacted blocks
+			bitset<COVERAGE_BLOCK_SIZE> fragment_starts; // for each window, store if a fragment starts here
+			bitset<COVERAGE_BLOCK_SIZE> fragment_ends; // for each window, store if a fragment ends here
+			unsigned int get_coverage(const unsigned int window) const { return (coverage.empty()) ? compact_coverage[window] : coverage[window]; };
+		};
+		vector<unsigned int> windows; // number of windows of each contig, 0 if the contig is not in the assembly
+		vector< vector<unsigned int> > block_index; // for each contig and block, 1 + the index of the block in <blocks> or 0 if it is not allocated
+		vector<coverage_block_t> blocks;
+		bool precomputed; // the coverage is loaded from a coverage track rather than computed from the alignments
+		const coverage_block_t* get_block(const contig_t contig, const unsigned int window) const; // NULL, if the block is not allocated
+		coverage_block_t& get_writable_block(const contig_t contig, const unsigned int window); // allocates or expands the block
+		void add_coverage(const contig_t contig, const unsigned int window, const unsigned int coverage); // saturates at USHRT_MAX
+		unsigned int get_window_coverage(const contig_t contig, const unsigned int window) const;
 	public:
 		coverage_t(const contigs_t& contigs, const assembly_t& assembly);
 		void add_fragment(bam1_t* mate1, bam1_t* mate2, const bool is_read_through_alignment);
 		bool fragment_starts_here(const contig_t contig, const position_t start, const position_t end) const;
 		bool fragment_ends_here(const contig_t contig, const position_t start, const position_t end) const;
 		int get_coverage(const contig_t contig, const position_t position, const direction_t direction) const;
+		int get_coverage(const contig_t contig, const position_t position) const; // coverage of the window which <position> falls into
+		// used to combine the coverage of several input files which are read concurrently
+		void clear(); // resets all windows, but keeps the dimensions
+		void merge(const coverage_t& other); // <other> must have the same dimensions
+		// to be called once all fragments have been added: blocks in which no window has a coverage of UCHAR_MAX or more
+		// are stored with one byte per window; the coverage can still be queried in constant time
+		void compact();
+		unsigned long long int get_allocated_memory() const; // in bytes
+		// used to load a precomputed coverage track instead of adding fragments (see coverage_track.hpp)
+		void set_precomputed() { precomputed = true; };
+		bool is_precomputed() const { return precomputed; };
+		void add_window_coverage(const contig_t contig, const position_t position, const unsigned int coverage);
+		void mark_fragment_start(const contig_t contig, const position_t position);
+		void mark_fragment_end(const contig_t contig, const position_t position);
+		// used to pass the coverage of a shard from the scatter step to the gather step (see partial_state.hpp)
+		friend void write_coverage(ostream& out, const coverage_t& coverage);
+		friend bool merge_coverage(istream& in, coverage_t& coverage);
 };
 
 #endif /* _READ_STATS_H */
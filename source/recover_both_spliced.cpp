@@ -1,7 +1,8 @@
 #include <cmath>
 #include <map>
-#include <tuple>
+#include <vector>
 #include "common.hpp"
+#include "gene_pair_index.hpp"
 #include "recover_both_spliced.hpp"
 
 using namespace std;
@@ -10,18 +11,19 @@ direction_t opposite_direction(const direction_t direction) {
 	return ((direction == DOWNSTREAM) ? UPSTREAM : DOWNSTREAM);
 }
 
-unsigned int recover_both_spliced(fusions_t& fusions, const unsigned int max_fusions_to_recover) {
+unsigned int recover_both_spliced(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const unsigned int max_fusions_to_recover) {
 
 	// look for any supporting reads between two genes
-	map< tuple<gene_t,gene_t,direction_t,direction_t>, vector<fusion_t*> > fusions_by_gene_pair;
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion)
-		if (fusion->second.filter == NULL ||
-		    (fusion->second.both_breakpoints_spliced() && fusion->second.filter != FILTERS.at("merge_adjacent")) ||
-		    (fusion->second.both_breakpoints_spliced() && fusion->second.filter == FILTERS.at("pcr_fusions")) || // when there is risk of PCR-mediated fusions, only consider spliced events
-		    fusion->second.filter == FILTERS.at("intronic") ||
-		    fusion->second.filter == FILTERS.at("relative_support") ||
-		    fusion->second.filter == FILTERS.at("min_support")) {
-			fusions_by_gene_pair[make_tuple(fusion->second.gene1, fusion->second.gene2, (direction_t) fusion->second.direction1, (direction_t) fusion->second.direction2)].push_back(&fusion->second);
+	// the candidates are determined before any fusions are recovered, because recovering changes the filter status
+	vector<bool> is_supporting_fusion(gene_pair_index.size());
+	for (gene_pair_index_t::iterator fusion = gene_pair_index.begin(); fusion != gene_pair_index.end(); ++fusion)
+		if ((**fusion).filter == NULL ||
+		    ((**fusion).both_breakpoints_spliced() && (**fusion).filter != FILTERS.at("merge_adjacent")) ||
+		    ((**fusion).both_breakpoints_spliced() && (**fusion).filter == FILTERS.at("pcr_fusions")) || // when there is risk of PCR-mediated fusions, only consider spliced events
+		    (**fusion).filter == FILTERS.at("intronic") ||
+		    (**fusion).filter == FILTERS.at("relative_support") ||
+		    (**fusion).filter == FILTERS.at("min_support")) {
+			is_supporting_fusion[fusion - gene_pair_index.begin()] = true;
 		}
 
 	unsigned int remaining = 0;
@@ -54,20 +56,21 @@ unsigned int recover_both_spliced(fusions_t& fusions, const unsigned int max_fus
 			unsigned int sum_of_supporting_reads = 0;
 
 			// look for other reads with the same orientation
-			auto fusions_of_given_gene_pair = fusions_by_gene_pair.find(make_tuple(fusion->second.gene1, fusion->second.gene2, (direction_t) fusion->second.direction1, (direction_t) fusion->second.direction2));
-			if (fusions_of_given_gene_pair != fusions_by_gene_pair.end())
-				for (auto another_fusion = fusions_of_given_gene_pair->second.begin(); another_fusion != fusions_of_given_gene_pair->second.end(); ++another_fusion)
+			gene_pair_index_t::range_t fusions_of_given_gene_pair = gene_pair_index.find(fusion->second.gene1, fusion->second.gene2, fusion->second.direction1, fusion->second.direction2);
+			for (gene_pair_index_t::iterator another_fusion = fusions_of_given_gene_pair.first; another_fusion != fusions_of_given_gene_pair.second; ++another_fusion)
+				if (is_supporting_fusion[another_fusion - gene_pair_index.begin()]) {
 					if (fusion->second.filter == FILTERS.at("pcr_fusions")) {
 						if ((**another_fusion).both_breakpoints_spliced() && (**another_fusion).discordant_mates <= (**another_fusion).split_reads1 + (**another_fusion).split_reads2)
 							sum_of_supporting_reads++; // if there is risk of PCR-mediated fusions, ignore the number of supporting reads and count the event as 1 read
 					} else { // the event is probably not PCR-mediated => actually count the number of supporting reads
 						sum_of_supporting_reads += max((unsigned int) 1, (**another_fusion).supporting_reads());
 					}
+				}
 
 			// consider reciprocal translocations
-			auto reciprocal_fusions_of_given_gene_pair = fusions_by_gene_pair.find(make_tuple(fusion->second.gene1, fusion->second.gene2, opposite_direction(fusion->second.direction1), opposite_direction(fusion->second.direction2)));
-			if (reciprocal_fusions_of_given_gene_pair != fusions_by_gene_pair.end())
-				for (auto another_fusion = reciprocal_fusions_of_given_gene_pair->second.begin(); another_fusion != reciprocal_fusions_of_given_gene_pair->second.end(); ++another_fusion)
+			gene_pair_index_t::range_t reciprocal_fusions_of_given_gene_pair = gene_pair_index.find(fusion->second.gene1, fusion->second.gene2, opposite_direction(fusion->second.direction1), opposite_direction(fusion->second.direction2));
+			for (gene_pair_index_t::iterator another_fusion = reciprocal_fusions_of_given_gene_pair.first; another_fusion != reciprocal_fusions_of_given_gene_pair.second; ++another_fusion)
+				if (is_supporting_fusion[another_fusion - gene_pair_index.begin()])
 					if (!(**another_fusion).is_read_through())
 						// if the fusion is supported by 2 events of which all breakpoints are spliced, we don't question it
 						// if the other fusion is not spliced, then we check if the reciprocal fusions support a common genomic breakpoint
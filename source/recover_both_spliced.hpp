@@ -2,9 +2,10 @@
 #define _RECOVER_BOTH_SPLICED_H 1
 
 #include "common.hpp"
+#include "gene_pair_index.hpp"
 
 using namespace std;
 
-unsigned int recover_both_spliced(fusions_t& fusions, const unsigned int max_fusions_to_recover);
+unsigned int recover_both_spliced(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const unsigned int max_fusions_to_recover);
 
 #endif /* _RECOVER_BOTH_SPLICED_H */
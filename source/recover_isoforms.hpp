@@ -2,9 +2,10 @@
 #define _RECOVER_ISOFORMS_H 1
 
 #include "common.hpp"
+#include "gene_pair_index.hpp"
 
 using namespace std;
 
-unsigned int recover_isoforms(fusions_t& fusions);
+unsigned int recover_isoforms(const gene_pair_index_t& gene_pair_index);
 
 #endif /* _RECOVER_ISOFORMS_H */
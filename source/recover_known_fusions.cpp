@@ -13,12 +13,9 @@
 
 using namespace std;
 
-unsigned int recover_known_fusions(fusions_t& fusions, const string& known_fusions_file_path, const unordered_map<string,gene_t>& genes, const coverage_t& coverage) {
-
-	// load known fusions from file
+void read_known_fusions(const string& known_fusions_file_path, const unordered_map<string,gene_t>& genes, known_fusions_t& known_fusions, const bool warn_about_unknown_genes) {
 	stringstream known_fusions_file;
 	autodecompress_file(known_fusions_file_path, known_fusions_file);
-	set< tuple<gene_t,gene_t> > known_fusions;
 	string line;
 	while (getline(known_fusions_file, line)) {
 		if (!line.empty() && line[0] != '#') {
@@ -29,14 +26,21 @@ unsigned int recover_known_fusions(fusions_t& fusions, const string& known_fusio
 				if (genes.find(gene2) != genes.end()) {
 					known_fusions.insert(make_tuple(genes.at(gene1), genes.at(gene2)));
 					known_fusions.insert(make_tuple(genes.at(gene2), genes.at(gene1)));
-				} else {
+				} else if (warn_about_unknown_genes) {
 					cerr << "WARNING: unknown gene in known fusions list: " << gene2 << endl;
 				}
-			} else {
+			} else if (warn_about_unknown_genes) {
 				cerr << "WARNING: unknown gene in known fusions list: " << gene1 << endl;
 			}
 		}
 	}
+}
+
+unsigned int recover_known_fusions(fusions_t& fusions, const string& known_fusions_file_path, const unordered_map<string,gene_t>& genes, const coverage_t& coverage) {
+
+	// load known fusions from file
+	known_fusions_t known_fusions;
+	read_known_fusions(known_fusions_file_path, genes, known_fusions, true);
 
 	// look for known fusions with low support which were filtered
 	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
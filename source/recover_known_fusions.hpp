@@ -1,7 +1,9 @@
 #ifndef _RECOVER_KNOWN_FUSIONS_H
 #define _RECOVER_KNOWN_FUSIONS_H 1
 
+#include <set>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include "common.hpp"
 #include "annotation.hpp"
@@ -9,6 +11,10 @@
 
 using namespace std;
 
+typedef set< tuple<gene_t,gene_t> > known_fusions_t; // contains both orders of the genes of each known fusion
+
+void read_known_fusions(const string& known_fusions_file_path, const unordered_map<string,gene_t>& genes, known_fusions_t& known_fusions, const bool warn_about_unknown_genes);
+
 unsigned int recover_known_fusions(fusions_t& fusions, const string& known_fusions_file_path, const unordered_map<string,gene_t>& genes, const coverage_t& coverage);
 
 #endif /* _RECOVER_KNOWN_FUSIONS_H */
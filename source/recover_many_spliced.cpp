@@ -1,27 +1,32 @@
-#include <map>
-#include <tuple>
+#include <vector>
 #include "common.hpp"
+#include "gene_pair_index.hpp"
 #include "recover_many_spliced.hpp"
 
 using namespace std;
 
-unsigned int recover_many_spliced(fusions_t& fusions, const unsigned int min_spliced_events) {
+unsigned int recover_many_spliced(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const unsigned int min_spliced_events) {
 
 	// look for any spliced reads between two genes
-	map< tuple<gene_t,gene_t>, unsigned int > spliced_fusions_by_gene_pair;
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion)
-		if (!fusion->second.is_read_through() &&
-		    (fusion->second.spliced1 || fusion->second.spliced2) &&
-		    fusion->second.gene1 != fusion->second.gene2 &&
-		    !fusion->second.breakpoint_overlaps_both_genes() &&
-		    (fusion->second.filter == NULL ||
-		     fusion->second.filter == FILTERS.at("inconsistently_clipped") ||
-		     fusion->second.filter == FILTERS.at("homopolymer") ||
-		     fusion->second.filter == FILTERS.at("relative_support") ||
-		     fusion->second.filter == FILTERS.at("min_support") ||
-		     fusion->second.filter == FILTERS.at("select_best"))) {
-			spliced_fusions_by_gene_pair[make_tuple(fusion->second.gene1, fusion->second.gene2)]++;
-		}
+	// the count of a gene pair is stored at the position of the first fusion of the gene pair in the index
+	vector<unsigned int> spliced_fusions_by_gene_pair(gene_pair_index.size());
+	for (gene_pair_index_t::iterator group_start = gene_pair_index.begin(); group_start != gene_pair_index.end();) {
+		gene_pair_index_t::range_t fusions_of_gene_pair = gene_pair_index.group_of(group_start, false);
+		for (gene_pair_index_t::iterator fusion = fusions_of_gene_pair.first; fusion != fusions_of_gene_pair.second; ++fusion)
+			if (!(**fusion).is_read_through() &&
+			    ((**fusion).spliced1 || (**fusion).spliced2) &&
+			    (**fusion).gene1 != (**fusion).gene2 &&
+			    !(**fusion).breakpoint_overlaps_both_genes() &&
+			    ((**fusion).filter == NULL ||
+			     (**fusion).filter == FILTERS.at("inconsistently_clipped") ||
+			     (**fusion).filter == FILTERS.at("homopolymer") ||
+			     (**fusion).filter == FILTERS.at("relative_support") ||
+			     (**fusion).filter == FILTERS.at("min_support") ||
+			     (**fusion).filter == FILTERS.at("select_best"))) {
+				spliced_fusions_by_gene_pair[group_start - gene_pair_index.begin()]++;
+			}
+		group_start = fusions_of_gene_pair.second;
+	}
 
 	unsigned int remaining = 0;
 	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
@@ -42,7 +47,7 @@ unsigned int recover_many_spliced(fusions_t& fusions, const unsigned int min_spl
                     fusion->second.filter == FILTERS.at("min_support") ||
                     fusion->second.filter == FILTERS.at("select_best")) {
 			if ((fusion->second.spliced1 || fusion->second.spliced2) &&
-			    spliced_fusions_by_gene_pair[make_tuple(fusion->second.gene1, fusion->second.gene2)] >= min_spliced_events) {
+			    spliced_fusions_by_gene_pair[gene_pair_index.find(fusion->second.gene1, fusion->second.gene2).first - gene_pair_index.begin()] >= min_spliced_events) {
 				fusion->second.filter = NULL;
 				remaining++;
 			}
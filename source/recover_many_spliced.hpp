@@ -2,9 +2,10 @@
 #define _RECOVER_MANY_SPLICED_H 1
 
 #include "common.hpp"
+#include "gene_pair_index.hpp"
 
 using namespace std;
 
-unsigned int recover_many_spliced(fusions_t& fusions, const unsigned int min_spliced_events);
+unsigned int recover_many_spliced(fusions_t& fusions, const gene_pair_index_t& gene_pair_index, const unsigned int min_spliced_events);
 
 #endif /* _RECOVER_MANY_SPLICED_H */
@@ -1,7 +1,6 @@
-#include <unordered_map>
-#include <tuple>
 #include "common.hpp"
 #include "fusions.hpp"
+#include "gene_pair_index.hpp"
 #include "select_best.hpp"
 
 using namespace std;
@@ -18,57 +17,56 @@ unsigned int rank_fusion(fusion_t& fusion) {
 	}
 }
 
-unsigned int select_most_supported_breakpoints(fusions_t& fusions) {
+unsigned int select_most_supported_breakpoints(const gene_pair_index_t& gene_pair_index) {
 
-	typedef tuple<gene_t /*gene1*/, gene_t /*gene2*/, direction_t /*direction1*/, direction_t /*direction2*/> gene_pair_t;
-	unordered_map< gene_pair_t, fusions_t::iterator > best_breakpoints;
+	unsigned int remaining = 0;
+	for (gene_pair_index_t::iterator group_start = gene_pair_index.begin(); group_start != gene_pair_index.end();) {
 
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
+		// the index groups fusions by gene pair and directions
+		gene_pair_index_t::range_t fusions_of_gene_pair = gene_pair_index.group_of(group_start);
+		group_start = fusions_of_gene_pair.second;
 
-		if (fusion->second.filter != NULL)
-			continue; // fusion has already been filtered
+		// look for fusion with most support
+		fusion_t* best_breakpoints = NULL;
+		for (gene_pair_index_t::iterator fusion = fusions_of_gene_pair.first; fusion != fusions_of_gene_pair.second; ++fusion) {
 
-		gene_pair_t gene_pair = make_tuple(fusion->second.gene1, fusion->second.gene2, (direction_t) fusion->second.direction1, (direction_t) fusion->second.direction2);
+			if ((**fusion).filter != NULL)
+				continue; // fusion has already been filtered
 
-		// look for fusion with most support
-		if (best_breakpoints.find(gene_pair) == best_breakpoints.end()) {
-			best_breakpoints[gene_pair] = fusion; // initialize; this is the first fusion of the given gene pair which we encountered
-		} else {
-			fusions_t::iterator current_best = best_breakpoints[gene_pair];
-			if (rank_fusion(fusion->second) > rank_fusion(current_best->second)) { // preferentially look for breakpoints supported by split reads
-				best_breakpoints[gene_pair] = fusion;
-			} else if (rank_fusion(fusion->second) == rank_fusion(current_best->second)) { // then look for the breakpoints with most supporting reads
-				if (fusion->second.supporting_reads() > current_best->second.supporting_reads()) {
-					best_breakpoints[gene_pair] = fusion;
-				} else if (fusion->second.supporting_reads() == current_best->second.supporting_reads()) { // then look for the most upstream / downstream breakpoints
-					if (fusion->second.direction1 == DOWNSTREAM && fusion->second.breakpoint1 > current_best->second.breakpoint1 ||
-					    fusion->second.direction1 == UPSTREAM   && fusion->second.breakpoint1 < current_best->second.breakpoint1) {
-						best_breakpoints[gene_pair] = fusion;
-					} else if (fusion->second.direction1 == DOWNSTREAM && fusion->second.breakpoint1 == current_best->second.breakpoint1 ||
-					           fusion->second.direction1 == UPSTREAM   && fusion->second.breakpoint1 == current_best->second.breakpoint1) {
-						if (fusion->second.direction2 == DOWNSTREAM && fusion->second.breakpoint2 > current_best->second.breakpoint2 ||
-					            fusion->second.direction2 == UPSTREAM   && fusion->second.breakpoint2 < current_best->second.breakpoint2)
-							best_breakpoints[gene_pair] = fusion;
+			if (best_breakpoints == NULL) {
+				best_breakpoints = *fusion; // initialize; this is the first fusion of the given gene pair which we encountered
+			} else {
+				if (rank_fusion(**fusion) > rank_fusion(*best_breakpoints)) { // preferentially look for breakpoints supported by split reads
+					best_breakpoints = *fusion;
+				} else if (rank_fusion(**fusion) == rank_fusion(*best_breakpoints)) { // then look for the breakpoints with most supporting reads
+					if ((**fusion).supporting_reads() > best_breakpoints->supporting_reads()) {
+						best_breakpoints = *fusion;
+					} else if ((**fusion).supporting_reads() == best_breakpoints->supporting_reads()) { // then look for the most upstream / downstream breakpoints
+						if ((**fusion).direction1 == DOWNSTREAM && (**fusion).breakpoint1 > best_breakpoints->breakpoint1 ||
+						    (**fusion).direction1 == UPSTREAM   && (**fusion).breakpoint1 < best_breakpoints->breakpoint1) {
+							best_breakpoints = *fusion;
+						} else if ((**fusion).direction1 == DOWNSTREAM && (**fusion).breakpoint1 == best_breakpoints->breakpoint1 ||
+						           (**fusion).direction1 == UPSTREAM   && (**fusion).breakpoint1 == best_breakpoints->breakpoint1) {
+							if ((**fusion).direction2 == DOWNSTREAM && (**fusion).breakpoint2 > best_breakpoints->breakpoint2 ||
+						            (**fusion).direction2 == UPSTREAM   && (**fusion).breakpoint2 < best_breakpoints->breakpoint2)
+								best_breakpoints = *fusion;
+						}
 					}
 				}
 			}
 		}
 
-	}
+		// delete all fusions but the best ones
+		for (gene_pair_index_t::iterator fusion = fusions_of_gene_pair.first; fusion != fusions_of_gene_pair.second; ++fusion) {
 
-	// delete all fusions but the best ones
-	unsigned int remaining = 0;
-	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
-
-		if (fusion->second.filter != NULL)
-			continue; // the fusion has already been filtered
-
-		if (fusion == best_breakpoints[make_tuple(fusion->second.gene1, fusion->second.gene2, (direction_t) fusion->second.direction1, (direction_t) fusion->second.direction2)])
-			remaining++;
-		else
-			fusion->second.filter = FILTERS.at("select_best");
+			if ((**fusion).filter != NULL)
+				continue; // the fusion has already been filtered
 
+			if (*fusion == best_breakpoints)
+				remaining++;
+			else
+				(**fusion).filter = FILTERS.at("select_best");
+		}
 	}
 	return remaining;
 }
-
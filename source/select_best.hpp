@@ -2,9 +2,10 @@
 #define _SELECT_BEST_H 1
 
 #include "common.hpp"
+#include "gene_pair_index.hpp"
 
 using namespace std;
 
-unsigned int select_most_supported_breakpoints(fusions_t& fusions);
+unsigned int select_most_supported_breakpoints(const gene_pair_index_t& gene_pair_index);
 
 #endif /* _SELECT_BEST_H */
@@ -0,0 +1,68 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "time_budget.hpp"
+
+using namespace std;
+
+time_budget_t::time_budget_t(const double budget): start_time(chrono::steady_clock::now()), budget(budget) {
+}
+
+double time_budget_t::get_remaining_time() const {
+	return budget - chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+void time_budget_t::add_degradation(const string& degradation, const string& reason) {
+	cerr << "WARNING: " << reason << ", " << degradation << endl;
+	degradations.push_back(degradation);
+}
+
+void time_budget_t::amend_degradation(const unsigned int index, const string& details) {
+	degradations.at(index) += " (" + details + ")";
+}
+
+void time_budget_t::write_degradations(const string& output_file) const {
+	ofstream out(output_file);
+	if (!out.is_open()) {
+		cerr << "ERROR: Failed to open output file '" << output_file << "'." << endl;
+		exit(1);
+	}
+	for (auto degradation = degradations.begin(); degradation != degradations.end(); ++degradation)
+		out << *degradation << endl;
+}
+
+stage_watchdog_t::stage_watchdog_t(): time_budget(NULL), allotted_time(0), degraded(false), degradation_index(0) {
+}
+
+stage_watchdog_t::stage_watchdog_t(time_budget_t& time_budget, const string& stage, const double share): time_budget(&time_budget), stage(stage), start_time(chrono::steady_clock::now()), allotted_time(max(0.0, time_budget.get_remaining_time() * share)), degraded(false), degradation_index(0) {
+}
+
+bool stage_watchdog_t::degrade_if_overdue(const unsigned long long int done, const unsigned long long int total, const string& degradation) {
+
+	if (degraded)
+		return true;
+	if (time_budget == NULL || !time_budget->is_limited())
+		return false;
+
+	// extrapolate the runtime of the stage linearly from the work done so far
+	double elapsed_time = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+	if (elapsed_time > allotted_time || done > 0 && elapsed_time / done * total > allotted_time) {
+		degraded = true;
+		degradation_index = time_budget->get_degradations().size();
+		time_budget->add_degradation(stage + ": " + degradation);
+	}
+
+	return degraded;
+}
+
+void stage_watchdog_t::amend_degradation(const string& details) {
+	if (degraded && time_budget != NULL)
+		time_budget->amend_degradation(degradation_index, details);
+}
+
+void stage_watchdog_t::add_degradation(const string& degradation, const string& reason) {
+	if (time_budget != NULL)
+		time_budget->add_degradation(stage + ": " + degradation, reason);
+}
@@ -0,0 +1,53 @@
+#ifndef _TIME_BUDGET_H
+#define _TIME_BUDGET_H 1
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// keeps track of how much time is left of the time budget for the entire run
+// and which steps had to switch to a cheaper mode to stay within the budget
+class time_budget_t {
+	private:
+		chrono::steady_clock::time_point start_time;
+		double budget; // in seconds, 0 means unlimited
+		vector<string> degradations;
+	public:
+		time_budget_t(const double budget);
+		bool is_limited() const { return budget > 0; };
+		double get_remaining_time() const;
+		void add_degradation(const string& degradation, const string& reason = "running out of time");
+		void amend_degradation(const unsigned int index, const string& details);
+		const vector<string>& get_degradations() const { return degradations; };
+		// writes one degradation per line, such that the output of the run can be audited
+		void write_degradations(const string& output_file) const;
+};
+
+// tracks the progress of a stage against its share of the remaining time budget
+class stage_watchdog_t {
+	private:
+		time_budget_t* time_budget; // NULL means the stage never degrades
+		string stage;
+		chrono::steady_clock::time_point start_time;
+		double allotted_time;
+		bool degraded;
+		unsigned int degradation_index; // index of the degradation of this stage in the list of the time budget
+	public:
+		// a watchdog which never degrades
+		stage_watchdog_t();
+		// the stage may take <share> of the time which is left of the budget when the watchdog is created
+		stage_watchdog_t(time_budget_t& time_budget, const string& stage, const double share);
+		// returns true, once the stage is projected to exceed its allotted time, given that <done> of <total> work items have been processed;
+		// the first time this happens, <degradation> is recorded as the cheaper mode which the stage switches to
+		bool degrade_if_overdue(const unsigned long long int done, const unsigned long long int total, const string& degradation);
+		bool is_degraded() const { return degraded; };
+		// adds details to the recorded degradation, which are only known once the stage has completed, e.g., how much work was skipped
+		void amend_degradation(const string& details);
+		// records a degradation of the stage which is not caused by running out of time, e.g., when the work per item is capped,
+		// such that it is reported even if the time budget is unlimited
+		void add_degradation(const string& degradation, const string& reason);
+};
+
+#endif /* _TIME_BUDGET_H */
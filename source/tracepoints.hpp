@@ -0,0 +1,36 @@
+#ifndef _TRACEPOINTS_H
+#define _TRACEPOINTS_H 1
+
+// static tracepoints (USDT) for profiling production runs with perf or bpftrace without rebuilding, e.g.:
+//   bpftrace -e 'usdt:./arriba:arriba:stage__end { printf("%s %d us\n", str(arg0), arg1); }'
+// when not traced, a probe is a single nop instruction; without <sys/sdt.h> (see Makefile), probes compile to nothing
+// arguments must be integers or pointers (strings are passed as const char*)
+//
+// available probes:
+//   stage__start(name), stage__end(name, microseconds): steps of the workflow
+//   bam__batch__start(first_record), bam__batch__end(first_record, records): batches of records decoded from a BAM file
+//   kmer__index__start(genes), kmer__index__end(contigs): construction of the k-mer index of the genes involved in fusions
+//   mismappers__fusion__start(gene1_id, gene2_id, reads), mismappers__fusion__end(gene1_id, gene2_id, realigned_reads)
+//   homologs__fusion__start(gene1_id, gene2_id, reads), homologs__fusion__end(gene1_id, gene2_id, discarded)
+//   output__row(gene1_id, gene2_id, supporting_reads): a fusion written to the output file
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define TRACEPOINT0(name) DTRACE_PROBE(arriba, name)
+#define TRACEPOINT1(name, arg1) DTRACE_PROBE1(arriba, name, arg1)
+#define TRACEPOINT2(name, arg1, arg2) DTRACE_PROBE2(arriba, name, arg1, arg2)
+#define TRACEPOINT3(name, arg1, arg2, arg3) DTRACE_PROBE3(arriba, name, arg1, arg2, arg3)
+
+#else
+
+// sizeof() marks the arguments as used without evaluating them
+#define TRACEPOINT0(name) do {} while (0)
+#define TRACEPOINT1(name, arg1) do { (void) sizeof(arg1); } while (0)
+#define TRACEPOINT2(name, arg1, arg2) do { (void) sizeof(arg1); (void) sizeof(arg2); } while (0)
+#define TRACEPOINT3(name, arg1, arg2, arg3) do { (void) sizeof(arg1); (void) sizeof(arg2); (void) sizeof(arg3); } while (0)
+
+#endif
+
+#endif /* _TRACEPOINTS_H */
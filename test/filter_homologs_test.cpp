@@ -0,0 +1,141 @@
+// checks that skipping dissimilar genes with sketches does not change which fusions the 'homologs' filter removes,
+// in particular for genes whose similarity stems from repeats
+
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "common.hpp"
+#include "filter_mismappers.hpp"
+#include "filter_homologs.hpp"
+#include "time_budget.hpp"
+
+using namespace std;
+
+// deterministic pseudo-random sequence, such that the test gives the same result on every run
+string random_sequence(const unsigned int length, unsigned int& seed) {
+	string sequence(length, 'N');
+	for (unsigned int position = 0; position < length; ++position) {
+		seed = seed * 1103515245 + 12345;
+		sequence[position] = "ACGT"[(seed >> 16) & 3];
+	}
+	return sequence;
+}
+
+string repeat_sequence(const string& unit, const unsigned int length) {
+	string sequence;
+	while (sequence.size() < length)
+		sequence += unit;
+	return sequence.substr(0, length);
+}
+
+// places a gene at the end of the given contig
+gene_annotation_record_t make_gene(const unsigned int id, const contig_t contig, const string& sequence, assembly_t& assembly) {
+	gene_annotation_record_t gene;
+	gene.id = id;
+	gene.name = "gene" + to_string(static_cast<long long int>(id));
+	gene.contig = contig;
+	gene.start = assembly[contig].size();
+	gene.end = gene.start + sequence.size() - 1; // coordinates are inclusive
+	gene.strand = FORWARD;
+	gene.exonic_length = sequence.size();
+	gene.is_dummy = false;
+	gene.is_protein_coding = true;
+	assembly[contig] += sequence;
+	return gene;
+}
+
+void add_fusion(fusions_t& fusions, gene_t gene1, gene_t gene2, const unsigned short int split_reads) {
+	fusion_t& fusion = fusions[make_tuple(gene1->id, gene2->id, gene1->contig, gene2->contig, gene1->end - 100, gene2->start + 100, DOWNSTREAM, UPSTREAM)];
+	fusion.gene1 = gene1;
+	fusion.gene2 = gene2;
+	fusion.contig1 = gene1->contig;
+	fusion.contig2 = gene2->contig;
+	fusion.breakpoint1 = gene1->end - 100;
+	fusion.breakpoint2 = gene2->start + 100;
+	fusion.direction1 = DOWNSTREAM;
+	fusion.direction2 = UPSTREAM;
+	fusion.split_reads1 = split_reads;
+	fusion.evalue = 0;
+}
+
+int main() {
+
+	unsigned int seed = 1;
+	const string repeat_unit1 = random_sequence(64, seed);
+	const string repeat_unit2 = random_sequence(50, seed);
+	const string unique_sequence = random_sequence(5000, seed);
+
+	assembly_t assembly;
+	vector<gene_annotation_record_t> genes;
+	genes.reserve(7);
+	// mostly a tandem repeat, hence few distinct k-mers, but many matching positions
+	genes.push_back(make_gene(0, 0, random_sequence(4000, seed) + repeat_sequence(repeat_unit1, 6000), assembly));
+	// contains a few copies of the repeat of gene 0 within unique sequence
+	genes.push_back(make_gene(1, 1, random_sequence(9000, seed) + repeat_sequence(repeat_unit1, 192) + random_sequence(9000, seed), assembly));
+	// unrelated to all other genes
+	genes.push_back(make_gene(2, 1, random_sequence(8000, seed), assembly));
+	// share unique sequence
+	genes.push_back(make_gene(3, 2, random_sequence(5000, seed) + unique_sequence, assembly));
+	genes.push_back(make_gene(4, 0, unique_sequence + random_sequence(15000, seed), assembly));
+	// repeats which are too short to make the genes homologs
+	genes.push_back(make_gene(5, 2, random_sequence(9000, seed) + repeat_sequence(repeat_unit2, 1000), assembly));
+	genes.push_back(make_gene(6, 1, random_sequence(12000, seed) + repeat_sequence(repeat_unit2, 100), assembly));
+
+	fusions_t fusions;
+	add_fusion(fusions, &genes[0], &genes[1], 10);
+	add_fusion(fusions, &genes[0], &genes[2], 5);
+	add_fusion(fusions, &genes[2], &genes[3], 4);
+	add_fusion(fusions, &genes[3], &genes[4], 3);
+	add_fusion(fusions, &genes[5], &genes[6], 2);
+	add_fusion(fusions, &genes[1], &genes[5], 1);
+
+	const char kmer_length = 8;
+	kmer_indices_t kmer_indices;
+	make_kmer_index(fusions, assembly, kmer_length, kmer_indices);
+
+	// run the filter with and without prefiltering by sketches on identical copies of the fusions
+	fusions_t unfiltered_fusions = fusions;
+	stage_watchdog_t watchdog;
+	homolog_comparisons_t comparisons_with_prefilter, comparisons_without_prefilter;
+	filter_homologs(fusions, kmer_indices, kmer_length, assembly, 0.3, 1000, watchdog, true, &comparisons_with_prefilter);
+	filter_homologs(unfiltered_fusions, kmer_indices, kmer_length, assembly, 0.3, 1000, watchdog, false, &comparisons_without_prefilter);
+
+	int failures = 0;
+	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
+		const bool removed_with_prefilter = fusion->second.filter != NULL;
+		const bool removed_without_prefilter = unfiltered_fusions.at(fusion->first).filter != NULL;
+		if (removed_with_prefilter != removed_without_prefilter) {
+			cerr << "FAIL: fusion " << fusion->second.gene1->name << ":" << fusion->second.gene2->name << " is " << (removed_with_prefilter ? "" : "not ") << "removed with prefilter, but " << (removed_without_prefilter ? "" : "not ") << "removed without" << endl;
+			failures++;
+		}
+	}
+
+	// make sure the test covers homologs due to repeats at all
+	if (unfiltered_fusions.at(make_tuple(0u, 1u, (contig_t) 0, (contig_t) 1, genes[0].end - 100, genes[1].start + 100, DOWNSTREAM, UPSTREAM)).filter == NULL) {
+		cerr << "FAIL: genes sharing a repeat are not detected as homologs" << endl;
+		failures++;
+	}
+
+	// make sure the prefilter actually ruled out some pairs, but not the ones which need the exact test
+	if (comparisons_with_prefilter.skipped_by_prefilter == 0) {
+		cerr << "FAIL: the prefilter did not skip any pair of genes" << endl;
+		failures++;
+	}
+	if (comparisons_with_prefilter.exact == 0) {
+		cerr << "FAIL: the prefilter skipped all pairs of genes" << endl;
+		failures++;
+	}
+	if (comparisons_without_prefilter.skipped_by_prefilter != 0) {
+		cerr << "FAIL: pairs of genes were skipped although the prefilter is disabled" << endl;
+		failures++;
+	}
+	if (comparisons_with_prefilter.exact + comparisons_with_prefilter.skipped_by_prefilter != comparisons_without_prefilter.exact) {
+		cerr << "FAIL: " << comparisons_with_prefilter.exact << " exact and " << comparisons_with_prefilter.skipped_by_prefilter << " skipped comparisons with prefilter, but " << comparisons_without_prefilter.exact << " comparisons without" << endl;
+		failures++;
+	}
+
+	if (failures == 0)
+		cout << "PASS: filter_homologs" << endl;
+	return (failures == 0) ? 0 : 1;
+}
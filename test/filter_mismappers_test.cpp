@@ -0,0 +1,135 @@
+// checks that the re-alignment of a read to a repetitive gene stops when the work budget of the read is used up
+// and that the budget does not change the result of the re-alignment for ordinary reads
+
+#include <climits>
+#include <iostream>
+#include <string>
+#include "common.hpp"
+#include "nucleotides.hpp"
+#include "filter_mismappers.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(const bool condition, const string& description) {
+	if (!condition) {
+		cerr << "FAIL: " << description << endl;
+		failures++;
+	}
+}
+
+// deterministic pseudo-random sequence, such that the test gives the same result on every run
+string random_sequence(const unsigned int length, unsigned int& seed) {
+	string sequence(length, 'N');
+	for (unsigned int position = 0; position < length; ++position) {
+		seed = seed * 1103515245 + 12345;
+		sequence[position] = "ACGT"[(seed >> 16) & 3];
+	}
+	return sequence;
+}
+
+void make_kmer_index(const string& contig_sequence, const char kmer_length, kmer_index_t& kmer_index) {
+	const kmer_as_int_t mask = kmer_mask(kmer_length);
+	kmer_as_int_t kmer = kmer_to_int(contig_sequence, 0, kmer_length);
+	for (position_t pos = 0; pos + kmer_length < (int) contig_sequence.size(); kmer = roll_kmer(kmer, contig_sequence[pos + kmer_length], mask), pos++)
+		kmer_index[kmer].push_back(pos);
+}
+
+int main() {
+
+	// a long tandem repeat without G, such that every k-mer of the repeat is found thousands of times
+	const string repeat_unit = "AACACCCA";
+	string contig_sequence;
+	while (contig_sequence.size() < 200000)
+		contig_sequence += repeat_unit;
+
+	const char kmer_length = 8;
+	kmer_index_t kmer_index;
+	make_kmer_index(contig_sequence, kmer_length, kmer_index);
+
+	// the repeat with a mismatch every 10 bases: every k-mer hit is extended, but none reaches the minimum score
+	string repetitive_read;
+	while (repetitive_read.size() < 100)
+		repetitive_read += repeat_unit;
+	repetitive_read.resize(100);
+	for (string::size_type pos = 9; pos < repetitive_read.size(); pos += 10)
+		repetitive_read[pos] = 'G';
+
+	const splice_sites_t splice_sites;
+	const int min_score = 90;
+	const position_t gene_end = contig_sequence.size() - 1;
+
+	// a small budget is used up and the read is not aligned
+	{
+		realignment_budget_t budget(10000);
+		const bool aligned = align(0, repetitive_read, 0, contig_sequence, 0, 0, gene_end, kmer_index, kmer_length, splice_sites, min_score, 1, budget);
+		check(!aligned, "read is aligned although the budget is used up");
+		check(budget.exhausted(), "small budget is not used up by repetitive read");
+	}
+
+	// the default budget is reached as well, rather than trying all k-mer hits
+	{
+		realignment_budget_t budget;
+		const bool aligned = align(0, repetitive_read, 0, contig_sequence, 0, 0, gene_end, kmer_index, kmer_length, splice_sites, min_score, 1, budget);
+		check(!aligned, "read is aligned although the budget is used up");
+		check(budget.exhausted(), "default budget is not used up by repetitive read");
+	}
+
+	// a read which matches the repeat is aligned well before the budget runs out
+	{
+		realignment_budget_t budget(10000);
+		const bool aligned = align(0, contig_sequence.substr(3, 100), 0, contig_sequence, 0, 0, gene_end, kmer_index, kmer_length, splice_sites, min_score, 1, budget);
+		check(aligned, "matching read is not aligned");
+		check(!budget.exhausted(), "matching read uses up the budget");
+	}
+
+	// an exhausted budget stops the alignment right away
+	{
+		realignment_budget_t budget(0);
+		const bool aligned = align(0, contig_sequence.substr(3, 100), 0, contig_sequence, 0, 0, gene_end, kmer_index, kmer_length, splice_sites, min_score, 1, budget);
+		check(!aligned, "read is aligned with an empty budget");
+	}
+
+	// ordinary reads from a non-repetitive gene are classified the same with and without the budget
+	{
+		unsigned int seed = 1;
+		const string gene_sequence = random_sequence(50000, seed);
+		kmer_index_t gene_kmer_index;
+		make_kmer_index(gene_sequence, kmer_length, gene_kmer_index);
+		const position_t gene_end = gene_sequence.size() - 1;
+
+		unsigned int aligned_reads = 0;
+		for (unsigned int i = 0; i < 300; ++i) {
+			string read;
+			switch (i % 3) {
+				case 0: // read from the gene with a few mismatches
+					read = gene_sequence.substr(i * 150, 100);
+					for (string::size_type pos = i % 7; pos < read.size(); pos += 25)
+						read[pos] = (read[pos] == 'A') ? 'C' : 'A';
+					break;
+				case 1: // read from the gene with a deletion
+					read = gene_sequence.substr(i * 150, 50) + gene_sequence.substr(i * 150 + 53, 50);
+					break;
+				default: // read from elsewhere
+					read = random_sequence(100, seed);
+			}
+			realignment_budget_t default_budget;
+			realignment_budget_t unlimited_budget(ULONG_MAX);
+			const bool aligned_with_budget = align(0, read, 0, gene_sequence, 0, 0, gene_end, gene_kmer_index, kmer_length, splice_sites, min_score, 1, default_budget);
+			const bool aligned_without_budget = align(0, read, 0, gene_sequence, 0, 0, gene_end, gene_kmer_index, kmer_length, splice_sites, min_score, 1, unlimited_budget);
+			check(aligned_with_budget == aligned_without_budget, "budget changes the re-alignment of read " + to_string(static_cast<long long unsigned int>(i)));
+			check(!default_budget.exhausted(), "ordinary read " + to_string(static_cast<long long unsigned int>(i)) + " uses up the budget");
+			if (aligned_without_budget)
+				aligned_reads++;
+		}
+
+		// make sure the test covers both outcomes
+		check(aligned_reads >= 200, "reads from the gene are not aligned");
+		check(aligned_reads < 300, "reads from elsewhere are aligned");
+	}
+
+	if (failures == 0)
+		cout << "PASS: filter_mismappers" << endl;
+	return (failures == 0) ? 0 : 1;
+}